@@ -0,0 +1,467 @@
+#include "libgui/ElementManager.h"
+#include "libgui/Grid.h"
+#include "libgui/IndexedItemsProvider.h"
+#include "libgui/Layer.h"
+#include "libgui/RasterDrawingContext.h"
+#include "libgui/VirtualList.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace libgui;
+using namespace std;
+
+// Track the number of live heap bytes so that the memory cost of each element
+// can be reported.  Each allocation is prefixed with its size.
+static size_t liveHeapBytes = 0;
+
+void* operator new(size_t size)
+{
+  auto block = static_cast<max_align_t*>(malloc(size + sizeof(max_align_t)));
+  if (!block)
+  {
+    throw bad_alloc();
+  }
+  *reinterpret_cast<size_t*>(block) = size;
+  liveHeapBytes += size;
+  return block + 1;
+}
+
+void operator delete(void* pointer) noexcept
+{
+  if (pointer)
+  {
+    auto block = static_cast<max_align_t*>(pointer) - 1;
+    liveHeapBytes -= *reinterpret_cast<size_t*>(block);
+    free(block);
+  }
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+  operator delete(pointer);
+}
+
+namespace
+{
+const int Columns          = 50;
+const int ElementsInColumn = 1000;
+const int Iterations       = 50;
+
+// Runs the action several times and prints the fastest run
+void Measure(const char* name, int elementCount, const function<void()>& action)
+{
+  double best = 0;
+  for (int i = 0; i < Iterations; ++i)
+  {
+    auto start = chrono::steady_clock::now();
+    action();
+    auto elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    if (i == 0 || elapsed < best)
+    {
+      best = elapsed;
+    }
+  }
+
+  printf("%-40s %10.1f us %10.2f ns/element\n", name, best, best * 1000.0 / elementCount);
+}
+
+// Walks the tree the way external code would, through the shared_ptr accessors
+int CountUsingAccessors(const shared_ptr<Element>& element)
+{
+  int count = 1;
+  for (auto e = element->GetFirstChild(); e != nullptr; e = e->GetNextSibling())
+  {
+    count += CountUsingAccessors(e);
+  }
+  return count;
+}
+
+shared_ptr<Layer> CreateTree(const shared_ptr<ElementManager>& em, size_t arenaSize = 0)
+{
+  auto layer = arenaSize > 0 ? em->CreateLayerAbove(nullptr, LayerArena{arenaSize})
+                             : em->CreateLayerAbove(nullptr);
+  layer->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(Columns * 20);
+    e->SetBottom(ElementsInColumn * 20);
+  });
+
+  for (int c = 0; c < Columns; ++c)
+  {
+    auto column = layer->CreateChild<Element>();
+    column->SetArrangeCallback([c](shared_ptr<Element> e) {
+      auto p = e->GetParent();
+      e->SetLeft(p->GetLeft() + c * 20);
+      e->SetWidth(20);
+      e->SetTop(p->GetTop());
+      e->SetBottom(p->GetBottom());
+    });
+
+    for (int r = 0; r < ElementsInColumn; ++r)
+    {
+      auto cell = column->CreateChild<Element>();
+      cell->SetArrangeCallback([r](shared_ptr<Element> e) {
+        auto p = e->GetParent();
+        e->SetLeft(p->GetLeft());
+        e->SetRight(p->GetRight());
+        e->SetTop(p->GetTop() + r * 20);
+        e->SetHeight(20);
+      });
+    }
+  }
+
+  return layer;
+}
+
+class BenchmarkItemsProvider: public ItemsProvider
+{
+public:
+  explicit BenchmarkItemsProvider(int count)
+    : _items(count)
+  {
+    for (auto& item : _items)
+    {
+      item = make_shared<ViewModelBase>();
+    }
+  }
+
+  int GetTotalItems() override
+  {
+    return int(_items.size());
+  }
+
+  shared_ptr<ViewModelBase> GetItem(int index) override
+  {
+    return _items[index];
+  }
+
+  int GetItemIndex(shared_ptr<ViewModelBase> item) override
+  {
+    return int(find(_items.begin(), _items.end(), item) - _items.begin());
+  }
+
+private:
+  vector<shared_ptr<ViewModelBase>> _items;
+};
+}
+
+int main()
+{
+  auto em    = make_shared<ElementManager>();
+
+  auto heapBytesBefore = liveHeapBytes;
+  auto layer = CreateTree(em);
+
+  em->UpdateEverything();
+
+  auto elementCount = CountUsingAccessors(layer);
+  auto heapBytes    = liveHeapBytes - heapBytesBefore;
+  printf("Element tree with %d elements\n", elementCount);
+  printf("sizeof(Element) %zu bytes, heap %zu bytes per element (including callbacks)\n\n",
+         sizeof(Element), heapBytes / elementCount);
+
+  int visited = 0;
+
+  Measure("Traverse via shared_ptr accessors", elementCount, [&] {
+    visited = CountUsingAccessors(layer);
+  });
+
+  Measure("Traverse via VisitThisAndDescendents", elementCount, [&] {
+    visited = 0;
+    layer->VisitThisAndDescendents([&visited](Element*) {
+      ++visited;
+    });
+  });
+
+  Measure("ClearCacheAll", elementCount, [&] {
+    layer->ClearCacheAll(0);
+  });
+
+  Measure("UpdateEverything", elementCount, [&] {
+    em->UpdateEverything();
+  });
+
+  // Arrange the columns concurrently and then draw, as on a window resize
+  auto arrangeThreads = max(2u, thread::hardware_concurrency()) - 1;
+  em->SetArrangeThreadCount(arrangeThreads);
+  layer->SetArrangeChildrenInParallel(true);
+  Measure("UpdateEverything (parallel arrange)", elementCount, [&] {
+    em->UpdateEverything();
+  });
+  layer->SetArrangeChildrenInParallel(false);
+  em->SetArrangeThreadCount(0);
+
+  // Modify every cell of one column, as a data refresh would
+  vector<shared_ptr<Element>> column;
+  for (auto e = layer->GetFirstChild()->GetFirstChild(); e != nullptr; e = e->GetNextSibling())
+  {
+    column.push_back(e);
+  }
+
+  Measure("UpdateAfterModify column", int(column.size()), [&] {
+    for (auto& e : column)
+    {
+      e->UpdateAfterModify();
+    }
+  });
+
+  Measure("UpdateAfterModify column (batched)", int(column.size()), [&] {
+    em->BeginBatch();
+    for (auto& e : column)
+    {
+      e->UpdateAfterModify();
+    }
+    em->Commit();
+  });
+
+  Measure("UpdateAfterContentChange column", int(column.size()), [&] {
+    for (auto& e : column)
+    {
+      e->UpdateAfterContentChange();
+    }
+  });
+
+  Measure("Flush after InvalidateDraw column", int(column.size()), [&] {
+    for (auto& e : column)
+    {
+      e->InvalidateDraw();
+    }
+    em->Flush();
+  });
+
+  // Scroll one column back and forth by a row, first by arranging it at a new
+  // position, which arranges all its cells too, and then by translating it
+  auto scrolledColumn = layer->GetFirstChild();
+  double scroll = 0;
+  scrolledColumn->SetArrangeCallback([&scroll](shared_ptr<Element> e) {
+    auto p = e->GetParent();
+    e->SetLeft(p->GetLeft());
+    e->SetWidth(20);
+    e->SetTop(p->GetTop() - scroll);
+    e->SetBottom(p->GetBottom() - scroll);
+  });
+
+  Measure("Scroll column by arranging", int(column.size()), [&] {
+    scroll = 20 - scroll;
+    scrolledColumn->UpdateAfterModify();
+  });
+
+  scroll = 0;
+  scrolledColumn->UpdateAfterModify();
+  Measure("Scroll column by translation", int(column.size()), [&] {
+    auto translation = scrolledColumn->GetTranslation();
+    scrolledColumn->SetTranslation(Point{0, -20 - translation.Y});
+    scrolledColumn->UpdateAfterModify();
+  });
+  scrolledColumn->SetTranslation(Point{0, 0});
+  scrolledColumn->UpdateAfterModify();
+
+  // Build and tear down a whole layer, as transient UI such as a dialog would
+  size_t layerArenaSize = 0;
+  auto createAndRemoveLayer = [&] {
+    auto transient = CreateTree(em, layerArenaSize);
+    em->RemoveLayer(transient);
+  };
+
+  Measure("Create and remove layer (heap)", elementCount, createAndRemoveLayer);
+
+  layerArenaSize = elementCount * sizeof(Element);
+  Measure("Create and remove layer (arena)", elementCount, createAndRemoveLayer);
+
+  // A list of rows too long to search, one of which is rearranged before each hit
+  // test, as when a single row animates
+  const int listRows = 20000;
+  auto rowsLayer = em->CreateLayerAbove(nullptr);
+  rowsLayer->SetUsesChildIndex(true);
+  rowsLayer->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(1000);
+    e->SetBottom(listRows * 20);
+  });
+  vector<shared_ptr<Element>> listRowElements;
+  double rowIndent = 0;
+  for (int i = 0; i < listRows; ++i)
+  {
+    auto row = rowsLayer->CreateChild<Element>();
+    row->SetConsumesInput(true);
+    row->SetArrangeCallback([i, &rowIndent](shared_ptr<Element> e) {
+      e->SetLeft(rowIndent);
+      e->SetTop(i * 20);
+      e->SetRight(1000);
+      e->SetBottom((i + 1) * 20);
+    });
+    listRowElements.push_back(row);
+  }
+  em->UpdateEverything();
+
+  Measure("Hit test after rearranging one of many rows", listRows, [&] {
+    rowIndent = rowIndent == 0 ? 10 : 0;
+    listRowElements[listRows / 2]->UpdateAfterModify();
+    rowsLayer->GetElementAtPoint(Point{500, listRows * 10 + 10});
+  });
+  em->RemoveLayer(rowsLayer);
+
+  // Draw into a software framebuffer the size of a window so that the cost of
+  // rasterizing is included, without needing a GPU
+  auto rasterEm = make_shared<ElementManager>();
+  auto raster   = make_shared<RasterDrawingContext>(Columns * 20, 1000);
+  rasterEm->SetDrawingContext(raster);
+  rasterEm->SetSize(Size(Columns * 20, 1000));
+
+  auto rasterLayer = CreateTree(rasterEm);
+  rasterLayer->VisitThisAndDescendents([](Element* e) {
+    e->SetRecordedDrawCallback([](Element* e, DrawingContext& dc) {
+      dc.FillRectangle(e->GetBounds(), Color{240, 240, 240, 255});
+      dc.OutlineRectangle(e->GetBounds(), Color{128, 128, 128, 255}, 1);
+    });
+  });
+
+  Measure("UpdateEverything (software raster)", elementCount, [&] {
+    rasterEm->UpdateEverything();
+  });
+
+  vector<shared_ptr<Element>> rasterColumn;
+  for (auto e = rasterLayer->GetFirstChild()->GetFirstChild(); e != nullptr; e = e->GetNextSibling())
+  {
+    rasterColumn.push_back(e);
+  }
+
+  Measure("UpdateAfterModify column (software raster)", int(rasterColumn.size()), [&] {
+    for (auto& e : rasterColumn)
+    {
+      e->UpdateAfterModify();
+    }
+    rasterEm->ClearRedrawnRegion();
+  });
+
+  // Scroll a window sized grid back and forth by a few pixels, redrawing all the
+  // visible cells and then copying the pixels which stay visible
+  auto gridEm     = make_shared<ElementManager>();
+  auto gridRaster = make_shared<RasterDrawingContext>(1000, 1000);
+  gridEm->SetDrawingContext(gridRaster);
+  gridEm->SetSize(Size(1000, 1000));
+
+  auto gridLayer = gridEm->CreateLayerAbove(nullptr);
+  gridLayer->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(1000);
+    e->SetBottom(1000);
+  });
+  auto grid = gridLayer->CreateChild<Grid>();
+  grid->SetColumns(10);
+  grid->SetCellHeight(40);
+  grid->SetItemsProvider(make_shared<BenchmarkItemsProvider>(100000));
+  grid->SetCellCreateCallback([](shared_ptr<Element> cell) {
+    cell->SetRecordedDrawCallback([](Element* e, DrawingContext& dc) {
+      dc.FillRectangle(e->GetBounds(), Color{240, 240, 240, 255});
+      dc.OutlineRectangle(e->GetBounds(), Color{128, 128, 128, 255}, 1);
+    });
+  });
+  gridEm->UpdateEverything();
+
+  auto gridCells   = grid->GetChildrenCount();
+  auto gridContent = 10000 * 40.0;
+  double gridScroll = 0;
+  auto scrollGrid = [&] {
+    gridScroll = 4 - gridScroll;
+    grid->MoveToOffsetPercent(gridScroll / gridContent, false);
+    grid->UpdateAfterModify();
+    gridEm->ClearRedrawnRegion();
+  };
+
+  Measure("Scroll grid (software raster)", gridCells, scrollGrid);
+  grid->SetScrollByCopy(true);
+  Measure("Scroll grid by copy (software raster)", gridCells, scrollGrid);
+
+  // Scrolling on by a row at a time rebinds one row of cells each time
+  Measure("Scroll grid by rows by copy (software raster)", gridCells, [&] {
+    gridScroll += 40;
+    grid->MoveToOffsetPercent(gridScroll / gridContent, false);
+    grid->UpdateAfterModify();
+    gridEm->ClearRedrawnRegion();
+  });
+
+  // A live feed appends a row of items below the view each time.  Following the
+  // provider's change notifications, the cells in view are kept rather than rebound.
+  vector<shared_ptr<ViewModelBase>> feedItems;
+  for (int i = 0; i < 100000; ++i)
+  {
+    feedItems.push_back(make_shared<ViewModelBase>());
+  }
+  auto feed = make_shared<IndexedItemsProvider>();
+  feed->Append(feedItems);
+  grid->SetItemsProvider(feed);
+  gridEm->UpdateEverything();
+
+  Measure("Append row to grid and flush", gridCells, [&] {
+    vector<shared_ptr<ViewModelBase>> row;
+    for (int column = 0; column < 10; ++column)
+    {
+      row.push_back(make_shared<ViewModelBase>());
+    }
+    feed->Append(row);
+    gridEm->Flush();
+    gridEm->ClearRedrawnRegion();
+  });
+
+  Measure("Append row to grid and update", gridCells, [&] {
+    vector<shared_ptr<ViewModelBase>> row;
+    for (int column = 0; column < 10; ++column)
+    {
+      row.push_back(make_shared<ViewModelBase>());
+    }
+    feed->Append(row);
+    grid->UpdateAfterModify();
+    gridEm->ClearRedrawnRegion();
+  });
+
+  // A window sized list of a million rows of different heights, scrolled on by a
+  // few rows at a time, which are measured as they come into view
+  auto listLayer = gridEm->CreateLayerAbove(gridLayer);
+  listLayer->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(1000);
+    e->SetBottom(1000);
+  });
+  auto listItems = make_shared<BenchmarkItemsProvider>(1000000);
+  auto list      = listLayer->CreateChild<VirtualList>();
+  list->SetEstimatedItemHeight(40);
+  list->SetItemsProvider(listItems);
+  list->SetMeasureCallback([](const shared_ptr<ViewModelBase>& item, double) {
+    return 20.0 + (reinterpret_cast<uintptr_t>(item.get()) / 64 % 5) * 10;
+  });
+  list->SetCellCreateCallback([](shared_ptr<Element> cell) {
+    cell->SetRecordedDrawCallback([](Element* e, DrawingContext& dc) {
+      dc.FillRectangle(e->GetBounds(), Color{240, 240, 240, 255});
+    });
+  });
+  gridEm->UpdateEverything();
+
+  Measure("Scroll variable-height list by rows", list->GetChildrenCount(), [&] {
+    list->MoveToOffsetPercent((list->GetScrollTop() + 100) / list->GetContentHeight(), false);
+    list->UpdateAfterModify();
+    gridEm->ClearRedrawnRegion();
+  });
+
+  int jumpTo = 0;
+  Measure("Jump variable-height list", list->GetChildrenCount(), [&] {
+    jumpTo = (jumpTo + 7919) % 1000000;
+    list->ScrollTo(jumpTo);
+    list->UpdateAfterModify();
+    gridEm->ClearRedrawnRegion();
+  });
+
+  return visited == elementCount ? 0 : 1;
+}
@@ -0,0 +1,325 @@
+#include "libgui/ChildIndex.h"
+#include "libgui/Element.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace libgui
+{
+
+// Limit the total number of buckets so that a single very large container
+// doesn't allocate a disproportionate amount of memory
+static const int MaxBuckets = 65536;
+
+namespace
+{
+
+// The extent of a child, which includes both the bounds used for hit testing and
+// the total bounds used for drawing, in the coordinates of the parent's bounds
+Rect4 GetChildExtent(Element* e)
+{
+  auto bounds      = e->GetBounds();
+  auto totalBounds = e->GetTotalBounds();
+
+  Rect4 extent;
+  extent.left   = std::min({bounds.left, bounds.right, totalBounds.left, totalBounds.right});
+  extent.top    = std::min({bounds.top, bounds.bottom, totalBounds.top, totalBounds.bottom});
+  extent.right  = std::max({bounds.left, bounds.right, totalBounds.left, totalBounds.right});
+  extent.bottom = std::max({bounds.top, bounds.bottom, totalBounds.top, totalBounds.bottom});
+
+  auto& translation = e->GetTranslation();
+  return extent.Translated(translation.X, translation.Y);
+}
+
+}
+
+void ChildIndex::MarkDirty()
+{
+  _isDirty = true;
+}
+
+bool ChildIndex::IsDirty() const
+{
+  return _isDirty;
+}
+
+void ChildIndex::MarkChildMoved(Element* child)
+{
+  if (_isDirty)
+  {
+    return;
+  }
+
+  // Once a good share of the children have moved, rebuilding is as quick
+  _movedChildren.push_back(child);
+  if (_movedChildren.size() > _entries.size() / 4)
+  {
+    MarkDirty();
+  }
+}
+
+void ChildIndex::RebuildIfNeeded(Element* parent)
+{
+  if (!_isDirty)
+  {
+    UpdateMovedChildren();
+    if (!_isDirty)
+    {
+      return;
+    }
+  }
+  _isDirty = false;
+  _movedChildren.clear();
+
+  _entries.clear();
+  _entryIndexes.clear();
+  for (auto& bucket : _buckets)
+  {
+    bucket.clear();
+  }
+
+  // Gather the extent of each child
+  for (Element* e = parent->_firstChild.get(); e != nullptr; e = e->_nextsibling.get())
+  {
+    auto extent = GetChildExtent(e);
+
+    if (_entries.empty())
+    {
+      _extent = extent;
+    }
+    else
+    {
+      _extent.left   = std::min(_extent.left, extent.left);
+      _extent.top    = std::min(_extent.top, extent.top);
+      _extent.right  = std::max(_extent.right, extent.right);
+      _extent.bottom = std::max(_extent.bottom, extent.bottom);
+    }
+
+    _entryIndexes[e] = int(_entries.size());
+    _entries.push_back(Entry{e, extent});
+  }
+
+  _visitedStamps.assign(_entries.size(), 0);
+  _stamp = 0;
+
+  if (_entries.empty())
+  {
+    _columns = 0;
+    _rows    = 0;
+    return;
+  }
+
+  // Make each bucket roughly the size of an average child, so that a list of
+  // full width rows gets a single column and a row of items a single row, and
+  // each child lands in only a few buckets.  Children smaller than their share
+  // of the extent don't make the buckets any smaller than that share.
+  auto count       = double(_entries.size());
+  auto totalWidth  = _extent.right - _extent.left;
+  auto totalHeight = _extent.bottom - _extent.top;
+  double averageWidth  = 0;
+  double averageHeight = 0;
+  for (auto& entry : _entries)
+  {
+    averageWidth  += entry.extent.right - entry.extent.left;
+    averageHeight += entry.extent.bottom - entry.extent.top;
+  }
+  averageWidth  = std::max(averageWidth / count, totalWidth / count);
+  averageHeight = std::max(averageHeight / count, totalHeight / count);
+
+  auto columns = averageWidth > 0 ? std::max(1.0, std::floor(totalWidth / averageWidth)) : 1.0;
+  auto rows    = averageHeight > 0 ? std::max(1.0, std::floor(totalHeight / averageHeight)) : 1.0;
+
+  // Aim for no more buckets than children, keeping the shape of the buckets
+  auto maxBuckets = std::min(double(MaxBuckets), count);
+  if (columns * rows > maxBuckets)
+  {
+    auto scale = std::sqrt(maxBuckets / (columns * rows));
+    columns = std::max(1.0, std::floor(columns * scale));
+    rows    = std::max(1.0, std::floor(rows * scale));
+    columns = std::min(columns, std::max(1.0, std::floor(maxBuckets / rows)));
+  }
+
+  _columns = int(columns);
+  _rows    = int(rows);
+
+  _bucketWidth  = (_extent.right - _extent.left) / _columns;
+  _bucketHeight = (_extent.bottom - _extent.top) / _rows;
+
+  _buckets.resize(size_t(_columns * _rows));
+
+  // Entries are added in sibling order so each bucket remains sorted by drawing order
+  for (int i = 0; i < int(_entries.size()); ++i)
+  {
+    auto& extent = _entries[i].extent;
+
+    auto firstColumn = ColumnAt(extent.left);
+    auto lastColumn  = ColumnAt(extent.right);
+    auto firstRow    = RowAt(extent.top);
+    auto lastRow     = RowAt(extent.bottom);
+
+    for (int row = firstRow; row <= lastRow; ++row)
+    {
+      for (int column = firstColumn; column <= lastColumn; ++column)
+      {
+        _buckets[row * _columns + column].push_back(i);
+      }
+    }
+  }
+}
+
+void ChildIndex::UpdateMovedChildren()
+{
+  for (auto child : _movedChildren)
+  {
+    auto found = _entryIndexes.find(child);
+    if (found == _entryIndexes.end())
+    {
+      MarkDirty();
+      return;
+    }
+
+    auto  i      = found->second;
+    auto& entry  = _entries[i];
+    auto  extent = GetChildExtent(child);
+    if (extent == entry.extent)
+    {
+      continue;
+    }
+
+    // The buckets only cover the extent of the children when the index was built
+    if (extent.left < _extent.left || extent.top < _extent.top ||
+        extent.right > _extent.right || extent.bottom > _extent.bottom)
+    {
+      MarkDirty();
+      return;
+    }
+
+    // Move the entry between just the buckets it left and joined, keeping each
+    // bucket sorted by drawing order
+    auto oldFirstColumn = ColumnAt(entry.extent.left);
+    auto oldLastColumn  = ColumnAt(entry.extent.right);
+    auto oldFirstRow    = RowAt(entry.extent.top);
+    auto oldLastRow     = RowAt(entry.extent.bottom);
+    auto firstColumn    = ColumnAt(extent.left);
+    auto lastColumn     = ColumnAt(extent.right);
+    auto firstRow       = RowAt(extent.top);
+    auto lastRow        = RowAt(extent.bottom);
+
+    for (int row = oldFirstRow; row <= oldLastRow; ++row)
+    {
+      for (int column = oldFirstColumn; column <= oldLastColumn; ++column)
+      {
+        if (row < firstRow || row > lastRow || column < firstColumn || column > lastColumn)
+        {
+          auto& bucket = _buckets[row * _columns + column];
+          bucket.erase(std::lower_bound(bucket.begin(), bucket.end(), i));
+        }
+      }
+    }
+    for (int row = firstRow; row <= lastRow; ++row)
+    {
+      for (int column = firstColumn; column <= lastColumn; ++column)
+      {
+        if (row < oldFirstRow || row > oldLastRow || column < oldFirstColumn || column > oldLastColumn)
+        {
+          auto& bucket = _buckets[row * _columns + column];
+          bucket.insert(std::lower_bound(bucket.begin(), bucket.end(), i), i);
+        }
+      }
+    }
+
+    entry.extent = extent;
+  }
+  _movedChildren.clear();
+}
+
+int ChildIndex::ColumnAt(double x) const
+{
+  if (_bucketWidth <= 0)
+  {
+    return 0;
+  }
+  auto column = int(std::floor((x - _extent.left) / _bucketWidth));
+  return std::max(0, std::min(_columns - 1, column));
+}
+
+int ChildIndex::RowAt(double y) const
+{
+  if (_bucketHeight <= 0)
+  {
+    return 0;
+  }
+  auto row = int(std::floor((y - _extent.top) / _bucketHeight));
+  return std::max(0, std::min(_rows - 1, row));
+}
+
+void ChildIndex::QueryPoint(Element* parent, const Point& point, std::vector<Element*>& result)
+{
+  RebuildIfNeeded(parent);
+
+  result.clear();
+
+  if (_entries.empty() ||
+      point.X < _extent.left || point.X > _extent.right ||
+      point.Y < _extent.top || point.Y > _extent.bottom)
+  {
+    return;
+  }
+
+  for (auto i : _buckets[RowAt(point.Y) * _columns + ColumnAt(point.X)])
+  {
+    result.push_back(_entries[i].element);
+  }
+}
+
+void ChildIndex::QueryRegion(Element* parent, const Rect4& region, std::vector<Element*>& result)
+{
+  RebuildIfNeeded(parent);
+
+  result.clear();
+
+  if (_entries.empty() || !_extent.Intersects(region))
+  {
+    return;
+  }
+
+  // A fresh stamp lets us skip entries which span multiple buckets
+  // without having to clear the visited flags between queries
+  if (++_stamp == 0)
+  {
+    std::fill(_visitedStamps.begin(), _visitedStamps.end(), 0);
+    _stamp = 1;
+  }
+
+  _queryIndexes.clear();
+
+  auto firstColumn = ColumnAt(region.left);
+  auto lastColumn  = ColumnAt(region.right);
+  auto firstRow    = RowAt(region.top);
+  auto lastRow     = RowAt(region.bottom);
+
+  for (int row = firstRow; row <= lastRow; ++row)
+  {
+    for (int column = firstColumn; column <= lastColumn; ++column)
+    {
+      for (auto i : _buckets[row * _columns + column])
+      {
+        if (_visitedStamps[i] != _stamp)
+        {
+          _visitedStamps[i] = _stamp;
+          _queryIndexes.push_back(i);
+        }
+      }
+    }
+  }
+
+  // Restore the drawing order of the candidates
+  std::sort(_queryIndexes.begin(), _queryIndexes.end());
+
+  for (auto i : _queryIndexes)
+  {
+    result.push_back(_entries[i].element);
+  }
+}
+
+}
@@ -0,0 +1,152 @@
+#include "libgui/DisplayList.h"
+
+#include <algorithm>
+
+namespace libgui
+{
+
+namespace
+{
+
+bool Overlaps(const Rect4& bounds, const boost::optional<Rect4>& updateArea)
+{
+  return !updateArea || bounds.Intersects(updateArea.get());
+}
+
+Rect4 LineBounds(const Point& from, const Point& to, double lineWidth)
+{
+  auto halfWidth = lineWidth / 2;
+  return Rect4(std::min(from.X, to.X) - halfWidth, std::min(from.Y, to.Y) - halfWidth,
+               std::max(from.X, to.X) + halfWidth, std::max(from.Y, to.Y) + halfWidth);
+}
+
+}
+
+void DisplayList::FillRectangle(const Rect4& rect, const Color& color)
+{
+  _commands.emplace_back(Fill{rect, color});
+}
+
+void DisplayList::OutlineRectangle(const Rect4& rect, const Color& color, double lineWidth)
+{
+  _commands.emplace_back(Outline{rect, color, lineWidth});
+}
+
+void DisplayList::DrawLine(const Point& from, const Point& to, const Color& color, double lineWidth)
+{
+  _commands.emplace_back(Line{from, to, color, lineWidth});
+}
+
+void DisplayList::Custom(const Rect4& bounds, const CustomDrawing& drawing)
+{
+  _commands.emplace_back(CustomCommand{bounds, drawing});
+}
+
+void DisplayList::PushClip(const Rect4& clip)
+{
+  _commands.emplace_back(Clip{clip});
+}
+
+void DisplayList::PopClip()
+{
+  _commands.emplace_back(Unclip{});
+}
+
+void DisplayList::PushTranslation(const Point& offset)
+{
+  _commands.emplace_back(Translate{offset});
+}
+
+void DisplayList::PopTranslation()
+{
+  _commands.emplace_back(Untranslate{});
+}
+
+void DisplayList::Replay(DrawingContext& target, const boost::optional<Rect4>& area) const
+{
+  // The update area is moved along with each recorded translation so that it stays
+  // in the coordinates of the commands which follow
+  auto updateArea = area;
+  std::vector<boost::optional<Rect4>> updateAreas;
+
+  for (auto& command : _commands)
+  {
+    if (auto fill = std::get_if<Fill>(&command))
+    {
+      if (Overlaps(fill->rect, updateArea))
+      {
+        target.FillRectangle(fill->rect, fill->color);
+      }
+    }
+    else if (auto outline = std::get_if<Outline>(&command))
+    {
+      if (Overlaps(outline->rect, updateArea))
+      {
+        target.OutlineRectangle(outline->rect, outline->color, outline->lineWidth);
+      }
+    }
+    else if (auto line = std::get_if<Line>(&command))
+    {
+      if (Overlaps(LineBounds(line->from, line->to, line->lineWidth), updateArea))
+      {
+        target.DrawLine(line->from, line->to, line->color, line->lineWidth);
+      }
+    }
+    else if (auto custom = std::get_if<CustomCommand>(&command))
+    {
+      if (Overlaps(custom->bounds, updateArea))
+      {
+        auto area = custom->bounds;
+        if (updateArea)
+        {
+          area.IntersectWith(updateArea.get());
+        }
+        custom->drawing(target, area);
+      }
+    }
+    else if (auto clip = std::get_if<Clip>(&command))
+    {
+      // Clips and translations are always replayed so that they stay balanced
+      target.PushClip(clip->clip);
+    }
+    else if (std::holds_alternative<Unclip>(command))
+    {
+      target.PopClip();
+    }
+    else if (auto translate = std::get_if<Translate>(&command))
+    {
+      updateAreas.push_back(updateArea);
+      if (updateArea)
+      {
+        updateArea = updateArea->Translated(-translate->offset.X, -translate->offset.Y);
+      }
+      target.PushTranslation(translate->offset);
+    }
+    else
+    {
+      if (!updateAreas.empty())
+      {
+        updateArea = updateAreas.back();
+        updateAreas.pop_back();
+      }
+      target.PopTranslation();
+    }
+  }
+}
+
+void DisplayList::Clear()
+{
+  _commands.clear();
+}
+
+bool DisplayList::IsEmpty() const
+{
+  return _commands.empty();
+}
+
+size_t DisplayList::GetCommandCount() const
+{
+  return _commands.size();
+}
+
+}
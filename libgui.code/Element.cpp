@@ -1,8 +1,14 @@
 #include "libgui/Element.h"
 #include "libgui/ElementManager.h"
+#include "libgui/IntersectionStack.h"
 #include "libgui/Location.h"
 #include "libgui/Layer.h"
 #include "libgui/ScopeExit.h"
+#include "libgui/WorkStealingPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <boost/container/small_vector.hpp>
 
 #ifdef DBG
 #include <typeinfo>
@@ -22,17 +28,17 @@ Element::Element(Dependencies dependencies)
 }
 
 Element::Element(Dependencies dependencies, std::string_view typeName)
-  : _elementManager(dependencies.parent->_elementManager),
+  : _parent(dependencies.parent),
+    _elementManager(dependencies.parent->_elementManager),
     _layer(dependencies.parent->_layer),
-    _parent(dependencies.parent),
     _typeName(typeName)
 {
 }
 
 // For the Layer class only
 Element::Element(const LayerDependencies& layerDependencies, std::string_view typeName)
-  : _elementManager(layerDependencies.elementManager),
-    _parent(nullptr),
+  : _parent(nullptr),
+    _elementManager(layerDependencies.elementManager),
     _typeName(typeName)
 {
   // Note: _layer will be set later by SetLayerToSharedFromThis()
@@ -40,6 +46,73 @@ Element::Element(const LayerDependencies& layerDependencies, std::string_view ty
   assert(_elementManager);
 }
 
+Element::~Element()
+{
+  // Attached children keep themselves alive, so if this element is destroyed
+  // without having removed its children first then release them here.  The
+  // deepest elements are released first so that the releases don't cascade
+  // recursively through the remaining descendents.
+  TraversalStack<Element*> descendents;
+  for (Element* child = _firstChild.get(); child != nullptr; child = child->_nextsibling.get())
+  {
+    child->VisitThisAndDescendents([&descendents](Element* e) { descendents->push_back(e); });
+  }
+
+  for (auto e : *descendents)
+  {
+    e->_parent      = nullptr;
+    e->_firstChild  = nullptr;
+    e->_lastChild   = nullptr;
+    e->_prevsibling = nullptr;
+    e->_nextsibling = nullptr;
+
+    // This may delete the element
+    auto self = std::move(e->_attachedSelf);
+  }
+}
+
+Element::Flags::Flags()
+  : initialUpdate(false),
+    clipToBounds(false),
+    isVisible(true),
+    isEnabled(true),
+    consumesInput(false),
+    isDetached(false),
+    inArrangeMethodNow(false),
+    updateRearrangesDescendents(false),
+    isInUpdateBatch(false),
+    batchRearrangesDescendants(false),
+    subtreeBoundsDirty(true),
+    hasAncestorClip(false),
+    arrangeChildrenInParallel(false),
+    needsArrange(false),
+    needsDraw(false),
+    descendantNeedsFlush(false),
+    arrangeDependsOnWindowSize(false),
+    hasTranslation(false),
+    translationChanged(false),
+    hasAncestorTranslation(false),
+    hasContentScroll(false),
+    isLeftSet(false),
+    isTopSet(false),
+    isRightSet(false),
+    isBottomSet(false),
+    isCenterXSet(false),
+    isCenterYSet(false),
+    isWidthSet(false),
+    isHeightSet(false)
+{
+}
+
+Element::ColdData& Element::GetColdData()
+{
+  if (!_cold)
+  {
+    _cold = std::make_unique<ColdData>();
+  }
+  return *_cold;
+}
+
 void Element::SetLayerFieldToSharedFromThis()
 {
   _layer = std::dynamic_pointer_cast<Layer>(shared_from_this());
@@ -71,27 +144,40 @@ std::shared_ptr<ViewModelBase> Element::GetViewModel()
 // Visual tree
 std::shared_ptr<Element> Element::GetParent() const
 {
-  return _parent;
+  return SharedFromLink(_parent);
 }
 
 std::shared_ptr<Element> Element::GetFirstChild() const
 {
-  return _firstChild;
+  return SharedFromLink(_firstChild);
 }
 
 std::shared_ptr<Element> Element::GetLastChild() const
 {
-  return _lastChild;
+  return SharedFromLink(_lastChild);
 }
 
 std::shared_ptr<Element> Element::GetPrevSibling() const
 {
-  return _prevsibling;
+  return SharedFromLink(_prevsibling);
 }
 
 std::shared_ptr<Element> Element::GetNextSibling() const
 {
-  return _nextsibling;
+  return SharedFromLink(_nextsibling);
+}
+
+std::shared_ptr<Element> Element::SharedFromLink(const TreeLink<Element>& link)
+{
+  if (link)
+  {
+    if (link->_attachedSelf)
+    {
+      return link->_attachedSelf;
+    }
+    return link->shared_from_this();
+  }
+  return nullptr;
 }
 
 void Element::AddChildHelper(std::shared_ptr<Element> element)
@@ -108,10 +194,36 @@ void Element::AddChildHelper(std::shared_ptr<Element> element)
 
   _lastChild = element;
 
+  // The element keeps itself alive while it is attached to the tree
+  element->_attachedSelf = element;
+
   _childrenCount++;
 
+  if (_childIndex)
+  {
+    _childIndex->MarkDirty();
+  }
+  InvalidateSubtreeBounds();
+
   // Copy the element manager to the child
   element->_elementManager = _elementManager;
+  if (element->_flags.arrangeDependsOnWindowSize)
+  {
+    _elementManager->AddWindowSizeDependent(element.get());
+  }
+
+  // Anything the child's subtree is waiting to have flushed must be reachable from here
+  if (element->_flags.needsArrange || element->_flags.needsDraw || element->_flags.descendantNeedsFlush)
+  {
+    element->MarkAncestorsNeedFlush();
+  }
+
+  // Any clips cached by the child or its descendants came from its previous ancestors
+  element->_clipCacheGeneration = 0;
+  if (element->_firstChild)
+  {
+    _elementManager->InvalidateClipCache();
+  }
 
   // Copy the layer to the child
   element->_layer = _layer;
@@ -129,38 +241,53 @@ void Element::RemoveChildren(UpdateWhenRemoving update)
     });
   }
 
-  // Recurse into children to thoroughly clean the element tree
-  auto e = _firstChild;
-  while (e != nullptr)
+  // Visit all descendents to thoroughly clean the element tree
+  TraversalStack<Element*> descendents;
+  for (Element* child = _firstChild.get(); child != nullptr; child = child->_nextsibling.get())
   {
-    // Allow subclasses to do additional cleanup
-    e->OnElementIsBeingRemoved();
+    child->VisitThisAndDescendents(
+      [&descendents](Element* e)
+      {
+        // Allow subclasses to do additional cleanup
+        e->OnElementIsBeingRemoved();
 
-    e->RemoveChildren(UpdateWhenRemoving::No);
+        descendents->push_back(e);
+        return true;
+      },
+      [](Element*)
+      {
+      });
+  }
 
-    // Clean up pointers so that the class will be deleted
-    e->_parent      = nullptr;
-    e->_prevsibling = nullptr;
-    auto next_e = e->_nextsibling;
-    e->_nextsibling = nullptr;
-    e->_layer       = nullptr;
+  // Detach in reverse order so that each element's descendents are released before it is
+  for (auto i = descendents->rbegin(); i != descendents->rend(); ++i)
+  {
+    auto e = *i;
+
+    e->_firstChild    = nullptr;
+    e->_lastChild     = nullptr;
+    e->_childrenCount = 0;
 
-    // Remove callbacks which often capture shared pointers to other elements
-    // which in turn can hold references to this element and thereby keep
-    // each other alive artificially
-    e->_arrangeCallback      = nullptr;
-    e->_drawCallback         = nullptr;
-    e->_setViewModelCallback = nullptr;
+    if (e->_childIndex)
+    {
+      e->_childIndex->MarkDirty();
+    }
 
-    // Prevent further updates if the class is still kept alive by other shared pointers
-    e->SetIsDetached(true);
+    e->DetachFromTree();
 
-    e = next_e;
+    // Release the tree's reference last since this may delete the element
+    auto child = std::move(e->_attachedSelf);
   }
 
   _firstChild    = nullptr;
   _lastChild     = nullptr;
   _childrenCount = 0;
+
+  if (_childIndex)
+  {
+    _childIndex->MarkDirty();
+  }
+  InvalidateSubtreeBounds();
 }
 
 void Element::RemoveChild(std::shared_ptr<Element> child)
@@ -199,28 +326,50 @@ void Element::RemoveChild(std::shared_ptr<Element> child)
 
   --_childrenCount;
 
-  // Remove the child's pointers to its relatives
-  child->_parent      = nullptr;
-  child->_nextsibling = nullptr;
-  child->_prevsibling = nullptr;
-  child->_layer       = nullptr;
+  if (_childIndex)
+  {
+    _childIndex->MarkDirty();
+  }
+  InvalidateSubtreeBounds();
+
+  child->DetachFromTree();
+  child->_attachedSelf = nullptr;
+
+  // The child should disappear as soon as all shared references to it are released
+}
+
+std::shared_ptr<ElementArena> Element::GetLayerArena() const
+{
+  return _layer ? _layer->GetArena() : nullptr;
+}
+
+void Element::DetachFromTree()
+{
+  // Remove the pointers to relatives
+  _parent      = nullptr;
+  _nextsibling = nullptr;
+  _prevsibling = nullptr;
+  _layer       = nullptr;
 
   // Remove callbacks which often capture shared pointers to other elements
   // which in turn can hold references to this element and thereby keep
   // each other alive artificially
-  child->_arrangeCallback      = nullptr;
-  child->_drawCallback         = nullptr;
-  child->_setViewModelCallback = nullptr;
+  _arrangeCallback = nullptr;
+  _drawCallback    = nullptr;
+  if (_cold)
+  {
+    _cold->setViewModelCallback = nullptr;
+    _cold->recordedDrawCallback = nullptr;
+    _cold->displayList.Clear();
+  }
 
   // Prevent further updates if the class is still kept alive by other shared pointers
-  child->SetIsDetached(true);
-
-  // The child should disappear as soon as all shared references to it are released
+  SetIsDetached(true);
 }
 
 void Element::SetIsDetached(bool isDetached)
 {
-  _isDetached = isDetached;
+  _flags.isDetached = isDetached;
 }
 
 int Element::GetChildrenCount()
@@ -232,7 +381,7 @@ std::shared_ptr<Element> Element::GetSingleChild() const
 {
   if (_childrenCount == 1)
   {
-    return _firstChild;
+    return SharedFromLink(_firstChild);
   }
 
   if (_childrenCount == 0)
@@ -246,16 +395,15 @@ std::shared_ptr<Element> Element::GetSingleChild() const
 // Cache Management
 void Element::ClearCacheAll(int cacheLevel)
 {
-  ClearCacheThis(cacheLevel);
-
-  // Recurse to children
-  if (_firstChild)
-  {
-    for (auto e = _firstChild; e != nullptr; e = e->_nextsibling)
+  VisitThisAndDescendents(
+    [cacheLevel](Element* e)
     {
-      e->ClearCacheAll(cacheLevel);
-    }
-  }
+      e->ClearCacheThis(cacheLevel);
+      return true;
+    },
+    [](Element*)
+    {
+    });
 }
 
 void Element::ClearCacheThis(int cacheLevel)
@@ -275,26 +423,31 @@ void Element::ResetArrangement()
   _width   = 0;
   _height  = 0;
 
-  _isLeftSet    = false;
-  _isTopSet     = false;
-  _isRightSet   = false;
-  _isBottomSet  = false;
-  _isCenterXSet = false;
-  _isCenterYSet = false;
-  _isWidthSet   = false;
-  _isHeightSet  = false;
+  _flags.isLeftSet    = false;
+  _flags.isTopSet     = false;
+  _flags.isRightSet   = false;
+  _flags.isBottomSet  = false;
+  _flags.isCenterXSet = false;
+  _flags.isCenterYSet = false;
+  _flags.isWidthSet   = false;
+  _flags.isHeightSet  = false;
+
+  InvalidateSubtreeBounds();
 }
 
 void Element::SetSetViewModelCallback(const std::function<void(std::shared_ptr<Element>)>& setViewModelCallback)
 {
-  _setViewModelCallback = setViewModelCallback;
+  if (setViewModelCallback || _cold)
+  {
+    GetColdData().setViewModelCallback = setViewModelCallback;
+  }
 }
 
 void Element::PrepareViewModel()
 {
-  if (_setViewModelCallback)
+  if (_cold && _cold->setViewModelCallback)
   {
-    _setViewModelCallback(shared_from_this());
+    _cold->setViewModelCallback(shared_from_this());
   }
   else
   {
@@ -313,15 +466,12 @@ void Element::SetArrangeCallback(const std::function<void(std::shared_ptr<Elemen
 
 bool Element::ThisIsEarlierSiblingOf(Element* other)
 {
-  Element* nextSibling = _nextsibling.get();
-  if (nextSibling == other)
-  {
-    return true;
-  }
-
-  if (nextSibling)
+  for (Element* e = _nextsibling.get(); e != nullptr; e = e->_nextsibling.get())
   {
-    return nextSibling->ThisIsEarlierSiblingOf(other);
+    if (e == other)
+    {
+      return true;
+    }
   }
 
   return false;
@@ -343,9 +493,10 @@ void Element::RegisterOverlappingElement(std::shared_ptr<Element> other)
                                "later can overlap siblings added earlier.");
   }
 
-  if (_overlappedBy.empty())
+  auto& overlappedBy = GetColdData().overlappedBy;
+  if (overlappedBy.empty())
   {
-    _overlappedBy.push_back(other);
+    overlappedBy.push_back(other);
   }
   else
   {
@@ -354,7 +505,7 @@ void Element::RegisterOverlappingElement(std::shared_ptr<Element> other)
     // Since there are already one or more overlapping elements, find the appropriate
     // place to insert into the list so that the elements maintain their drawing order.
     auto currentSibling = _nextsibling;
-    auto insertPos      = _overlappedBy.begin();
+    auto insertPos      = overlappedBy.begin();
 
     // Avoid adding the same element multiple times
     if ((*insertPos).lock() == other)
@@ -368,7 +519,7 @@ void Element::RegisterOverlappingElement(std::shared_ptr<Element> other)
       if (currentSibling == (*insertPos).lock())
       {
         ++insertPos;
-        if (insertPos == _overlappedBy.end())
+        if (insertPos == overlappedBy.end())
         {
           break;
         }
@@ -384,7 +535,7 @@ void Element::RegisterOverlappingElement(std::shared_ptr<Element> other)
     }
 
     // Now do the insert
-    _overlappedBy.insert(insertPos, other);
+    overlappedBy.insert(insertPos, other);
   }
 
   // Register the other way as well
@@ -393,9 +544,10 @@ void Element::RegisterOverlappingElement(std::shared_ptr<Element> other)
 
 void Element::RegisterOverlappedElement(std::shared_ptr<Element> other)
 {
-  if (_overlaps.empty())
+  auto& overlaps = GetColdData().overlaps;
+  if (overlaps.empty())
   {
-    _overlaps.push_back(other);
+    overlaps.push_back(other);
   }
   else
   {
@@ -404,7 +556,7 @@ void Element::RegisterOverlappedElement(std::shared_ptr<Element> other)
     // Since there are already one or more overlapping elements, find the appropriate
     // place to insert into the list so that the elements maintain their drawing order.
     auto currentSibling = _prevsibling;
-    auto insertPos      = _overlaps.rbegin();
+    auto insertPos      = overlaps.rbegin();
 
     // Avoid adding the same element multiple times
     if ((*insertPos).lock() == other)
@@ -418,7 +570,7 @@ void Element::RegisterOverlappedElement(std::shared_ptr<Element> other)
       if (currentSibling == (*insertPos).lock())
       {
         ++insertPos;
-        if (insertPos == _overlaps.rend())
+        if (insertPos == overlaps.rend())
         {
           break;
         }
@@ -435,20 +587,24 @@ void Element::RegisterOverlappedElement(std::shared_ptr<Element> other)
 
     // Now do the insert
     --insertPos; // reverse iterator + insert means you have to go back
-    _overlaps.insert(insertPos.base(), other);
+    overlaps.insert(insertPos.base(), other);
   }
 }
 
 void Element::UnregisterOverlappingElement(std::shared_ptr<Element> other)
 {
-  auto findIter = std::find_if(_overlappedBy.begin(), _overlappedBy.end(),
-  [other] (std::weak_ptr<Element> existing) {
-    return (existing.lock() == other);
-  });
-
-  if (findIter != _overlappedBy.end())
+  if (_cold)
   {
-    _overlappedBy.erase(findIter);
+    auto& overlappedBy = _cold->overlappedBy;
+    auto findIter = std::find_if(overlappedBy.begin(), overlappedBy.end(),
+    [other] (std::weak_ptr<Element> existing) {
+      return (existing.lock() == other);
+    });
+
+    if (findIter != overlappedBy.end())
+    {
+      overlappedBy.erase(findIter);
+    }
   }
 
   // And do the same in the opposite direction
@@ -457,14 +613,18 @@ void Element::UnregisterOverlappingElement(std::shared_ptr<Element> other)
 
 void Element::UnregisterOverlappedElement(std::shared_ptr<Element> other)
 {
-  auto findIter = std::find_if(_overlaps.begin(), _overlaps.end(),
-  [other] (std::weak_ptr<Element> existing) {
-    return (existing.lock() == other);
-  });
-
-  if (findIter != _overlaps.end())
+  if (_cold)
   {
-    _overlaps.erase(findIter);
+    auto& overlaps = _cold->overlaps;
+    auto findIter = std::find_if(overlaps.begin(), overlaps.end(),
+    [other] (std::weak_ptr<Element> existing) {
+      return (existing.lock() == other);
+    });
+
+    if (findIter != overlaps.end())
+    {
+      overlaps.erase(findIter);
+    }
   }
 }
 
@@ -486,46 +646,271 @@ void Element::Arrange()
 }
 
 void Element::ArrangeAndDrawHelper()
+{
+  if (auto pool = _elementManager->GetArrangePool())
+  {
+    // Everything is arranged before anything is drawn so that independent
+    // subtrees can be arranged at the same time, and then drawn in order
+    ArrangeHelper(pool);
+    DrawHelper(false);
+  }
+  else
+  {
+    DrawHelper(true);
+  }
+}
+
+void Element::ArrangeHelper(WorkStealingPool* pool)
 {
   VisitThisAndDescendents(
-    [](Element* e) // What to do for each element before visiting its children
+    [pool](Element* e)
     {
-      #ifdef DBG
-      printf("Arranging %s\n", e->GetTypeName().c_str());
-      fflush(stdout);
-      #endif
-
       e->DoArrangeTasks();
 
-      #ifdef DBG
-      printf("Drawing %s\n", e->GetTypeName().c_str());
-      fflush(stdout);
-      #endif
+      if (!e->GetIsVisible())
+      {
+        return false;
+      }
+      if (!pool || !e->_flags.arrangeChildrenInParallel || e->_childrenCount < 2)
+      {
+        return true;
+      }
+
+      // The children's tasks must not write to this element or its ancestors,
+      // since they run on several threads at once.  The getters resolve the
+      // unset edges lazily, so resolve them all now, and mark beforehand
+      // anything the tasks would otherwise mark.
+      e->GetLeft();
+      e->GetTop();
+      e->GetRight();
+      e->GetBottom();
+      e->GetCenterX();
+      e->GetCenterY();
+      e->GetWidth();
+      e->GetHeight();
+
+      e->InvalidateSubtreeBounds();
+      if (e->_childIndex)
+      {
+        e->_childIndex->MarkDirty();
+      }
+
+      // Remember which elements are only marked as needing a flush for now, so
+      // that the marks can be taken back if none of the children needed them
+      TraversalStack<Element*> markedForFlush;
+      for (Element* a = e; a != nullptr && !a->_flags.descendantNeedsFlush; a = a->_parent.get())
+      {
+        a->_flags.descendantNeedsFlush = true;
+        markedForFlush->push_back(a);
+      }
+
+      std::vector<std::function<void()>> tasks;
+      tasks.reserve(e->_childrenCount);
+      for (auto child = e->_firstChild.get(); child != nullptr; child = child->_nextsibling.get())
+      {
+        tasks.emplace_back([child, pool] { child->ArrangeHelper(pool); });
+      }
+      pool->Run(tasks);
+
+      // Any ancestors marked here are below the nearest parallel ancestor, which
+      // was marked before its own tasks started, so only this thread uses them
+      if (!markedForFlush->empty())
+      {
+        bool childNeedsFlush = false;
+        for (auto child = e->_firstChild.get(); child != nullptr && !childNeedsFlush;
+             child = child->_nextsibling.get())
+        {
+          auto& flags = child->_flags;
+          childNeedsFlush = flags.needsArrange || flags.needsDraw || flags.descendantNeedsFlush;
+        }
+        if (!childNeedsFlush)
+        {
+          for (auto a : *markedForFlush)
+          {
+            a->_flags.descendantNeedsFlush = false;
+          }
+        }
+      }
 
-      return e->DoDrawTasksIfVisible(boost::none); // whether or not to visit its children
+      return false;
     },
-    [](Element* e) // What to do for each element after visiting its children
+    [](Element*) {});
+}
+
+void Element::DrawHelper(bool arrange)
+{
+  // The clip which applies to the children of each element being visited, and
+  // whether that element was drawn (and so needs its drawing cleaned up) or only
+  // had its translation pushed for its children
+  struct ClipFrame
+  {
+    Rect4 clip;
+    bool  hasClip;
+    bool  clipIsEmpty;
+    bool  drawn;
+    bool  translated;
+  };
+  boost::container::small_vector<ClipFrame, 16> frames;
+
+  // Drawing starts out limited by the clipping ancestors and the window.  Each
+  // clip is kept in the coordinates of the bounds of the children of the element
+  // it belongs to, starting with those of this element's parent.
+  ClipFrame outer{Rect4(), false, false, false, false};
+  if (auto ancestorClip = GetAncestorClip())
+  {
+    outer.clip    = *ancestorClip;
+    outer.hasClip = true;
+  }
+  auto& size = _elementManager->GetSize();
+  if (size.width > 0 && size.height > 0)
+  {
+    Rect4 window(0, 0, size.width, size.height);
+    if (outer.hasClip)
     {
-      e->DoDrawTasksCleanup();
+      outer.clip.IntersectWith(window);
+    }
+    else
+    {
+      outer.clip    = window;
+      outer.hasClip = true;
+    }
+  }
+  outer.clipIsEmpty = outer.hasClip &&
+                      (outer.clip.left >= outer.clip.right || outer.clip.top >= outer.clip.bottom);
+  if (outer.hasClip && _parent)
+  {
+    auto offset = GetAncestorTranslation();
+    outer.clip  = outer.clip.Translated(-offset.X, -offset.Y);
+  }
+
+  VisitThisAndDescendents(
+    [&frames, &outer, arrange](Element* e) // What to do for each element before visiting its children
+    {
+      if (arrange)
+      {
+        #ifdef DBG
+        printf("Arranging %s\n", e->GetTypeName().c_str());
+        fflush(stdout);
+        #endif
+
+        e->DoArrangeTasks();
+      }
+
+      if (!e->GetIsVisible())
+      {
+        return false;
+      }
+
+      auto frame       = frames.empty() ? outer : frames.back();
+      frame.drawn      = false;
+      frame.translated = false;
+
+      // Elements entirely outside the clip are still arranged, along with their
+      // descendents, but there is nothing to draw
+      if (!frame.hasClip || (!frame.clipIsEmpty && e->TotalBoundsIntersects(frame.clip)))
+      {
+        #ifdef DBG
+        printf("Drawing %s\n", e->GetTypeName().c_str());
+        fflush(stdout);
+        #endif
+
+        frame.drawn = e->DoDrawTasksIfVisible(boost::none);
+      }
+      else if (e->_flags.hasTranslation)
+      {
+        // Its translation can still bring descendents into the clip, which must
+        // be drawn where the translation puts them. Its own clip doesn't matter
+        // since clipping to its bounds would leave them nothing to draw.
+        e->_elementManager->PushTranslation(e->_cold->translation);
+        frame.translated = true;
+      }
+
+      if (frame.hasClip)
+      {
+        frame.clip = e->Untranslate(frame.clip);
+      }
+
+      if (e->GetClipToBounds() && !frame.clipIsEmpty)
+      {
+        auto bounds = e->GetBounds();
+        if (frame.hasClip)
+        {
+          frame.clip.IntersectWith(bounds);
+        }
+        else
+        {
+          frame.clip    = bounds;
+          frame.hasClip = true;
+        }
+        frame.clipIsEmpty = frame.clip.left >= frame.clip.right || frame.clip.top >= frame.clip.bottom;
+      }
+
+      frames.push_back(frame);
+      return true; // whether or not to visit its children
+    },
+    [&frames](Element* e) // What to do for each element after visiting its children
+    {
+      if (frames.back().drawn)
+      {
+        e->DoDrawTasksCleanup();
+      }
+      else if (frames.back().translated)
+      {
+        e->_elementManager->PopTranslation();
+      }
+      frames.pop_back();
     });
 }
 
 void Element::DoArrangeTasks()
 {
+  // Signal to children that the parent is being arranged
+  _flags.inArrangeMethodNow = true;
+  ScopeExit onScopeExit([this] { _flags.inArrangeMethodNow = false; });
+
+  // Whatever redraws this arrangement also covers where a changed translation left,
+  // and there is no need to arrange it again for a Flush
+  _flags.translationChanged = false;
+  _flags.needsArrange       = false;
+
+  // The clips cached by descendants are only out of date if this element
+  // clips to its bounds and actually moved
+  boost::optional<Rect4> clipBefore;
+  if (_flags.clipToBounds)
+  {
+    clipBefore = GetBounds();
+  }
+
   ResetArrangement();
   PrepareViewModel();
 
-  // Signal to children that the parent is being arranged
-  _inArrangeMethodNow = true;
-  ScopeExit onScopeExit([this] { _inArrangeMethodNow = false; });
-
+  _flags.hasContentScroll = false;
   Arrange();
+
+  if (clipBefore && clipBefore.get() != GetBounds())
+  {
+    _elementManager->InvalidateClipCache();
+  }
+
+  // Whatever was recorded for the previous arrangement is out of date
+  InvalidateDisplayList();
+
+  // The new arrangement of this element moves its entry in the spatial index of its
+  // parent (unless the whole index is to be rebuilt, as when arranging in parallel)
+  if (_parent && _parent->_childIndex && !_parent->_childIndex->IsDirty())
+  {
+    _parent->_childIndex->MarkChildMoved(this);
+  }
 }
 
 bool Element::DoDrawTasksIfVisible(const boost::optional<Rect4>& updateArea)
 {
   if (GetIsVisible())
   {
+    if (_flags.hasTranslation)
+    {
+      _elementManager->PushTranslation(_cold->translation);
+    }
     ClipToBoundsIfNeeded();
 
     // Pass to Draw only the part of the updateArea that intersects
@@ -535,7 +920,7 @@ bool Element::DoDrawTasksIfVisible(const boost::optional<Rect4>& updateArea)
     if (updateArea)
     {
       auto elementUpdateArea = GetTotalBounds();
-      elementUpdateArea.IntersectWith(updateArea.get());
+      elementUpdateArea.IntersectWith(Untranslate(updateArea.get()));
       Draw(elementUpdateArea);
     }
     else
@@ -550,9 +935,16 @@ bool Element::DoDrawTasksIfVisible(const boost::optional<Rect4>& updateArea)
 
 void Element::DoDrawTasksCleanup()
 {
-  if (GetIsVisible() && GetClipToBounds())
+  if (GetIsVisible())
   {
-    _elementManager->PopClip();
+    if (GetClipToBounds())
+    {
+      _elementManager->PopClip();
+    }
+    if (_flags.hasTranslation)
+    {
+      _elementManager->PopTranslation();
+    }
   }
 }
 
@@ -566,21 +958,26 @@ void Element::UpdateAfterModify()
   Update(UpdateType::Modifying);
 }
 
+void Element::UpdateAfterContentChange()
+{
+  Update(UpdateType::ContentChange);
+}
+
 void Element::Update(UpdateType updateType)
 {
   // Elements that have been detached from the visual tree should no longer be updated.
-  if (_isDetached)
+  if (_flags.isDetached)
   {
     return;
   }
 
-  if (UpdateType::Everything != updateType && !_initialUpdate)
+  if (UpdateType::Everything != updateType && !_flags.initialUpdate)
   {
     if (UpdateType::Adding == updateType)
     {
-      VisitThisAndDescendents([](Element* e) { e->_initialUpdate = true; });
+      VisitThisAndDescendents([](Element* e) { e->_flags.initialUpdate = true; });
 
-      if (_parent && _parent->_inArrangeMethodNow)
+      if (_parent && _parent->_flags.inArrangeMethodNow)
       {
         // This call is coming within the Arrange method of the parent element,
         // and as a general rule, when libgui calls Arrange for an element it also
@@ -625,8 +1022,16 @@ void Element::UpdateHelper(UpdateType updateType)
   if (UpdateType::Everything == updateType)
   {
     ArrangeAndDrawHelper();
-    _elementManager->AddToRedrawnRegion(GetTotalBounds());
-    VisitThisAndDescendents([](Element* e) { e->_initialUpdate = true; });
+    _elementManager->AddToRedrawnRegion(GetTotalBoundsInWindow());
+
+    // Whatever was waiting to be flushed has now been done
+    VisitThisAndDescendents([](Element* e) {
+      e->_flags.initialUpdate        = true;
+      e->_flags.needsArrange         = false;
+      e->_flags.needsDraw            = false;
+      e->_flags.descendantNeedsFlush = false;
+      e->_flags.translationChanged   = false;
+    });
     return;
   }
 
@@ -636,27 +1041,71 @@ void Element::UpdateHelper(UpdateType updateType)
   fflush(stdout);
   #endif
 
-  // Arrange this element and monitor the side effects of doing so
+  if (UpdateType::ContentChange == updateType)
+  {
+    if (!GetIsVisible() || !GetAreAncestorsVisible())
+    {
+      return;
+    }
+
+    // Nothing is arranged, so the element is simply redrawn where it is, along
+    // with where it was if it has been translated since
+    InvalidateDisplayList();
+    auto contentEffects = MonitorArrangeEffects(false, true, GetBounds(), GetTotalBoundsInWindow(true))
+                            .Finish(true, GetBounds(), GetTotalBoundsInWindow());
+    _flags.translationChanged = false;
+    RedrawAfterUpdate(updateType, contentEffects, contentEffects.GetUnionedTotalBounds(), false);
+    return;
+  }
+
+  // Arrange this element and monitor the side effects of doing so.  The total
+  // bounds are monitored in window coordinates so that a change of translation
+  // redraws the right areas without counting as a move of the bounds.
   auto monitor = MonitorArrangeEffects(UpdateType::Adding == updateType,
-    GetIsVisible(), GetBounds(), GetTotalBounds());
+    GetIsVisible(), GetBounds(), GetTotalBoundsInWindow(true));
   {
     _monitoringArrangeEffects = monitor;
     ScopeExit onScopeExit([this] { _monitoringArrangeEffects = boost::none; });
 
     DoArrangeTasks();
   }
-  auto arrangeEffects = monitor.Finish(GetIsVisible(), GetBounds(), GetTotalBounds());
-
-  auto& redrawRegion = arrangeEffects.GetUnionedTotalBounds();
-
+  auto arrangeEffects = monitor.Finish(GetIsVisible(), GetBounds(), GetTotalBoundsInWindow());
 
   if (arrangeEffects.WasInvisibleBeforeAndAfter() ||
-      !GetAreAncestorsVisible() ||
-      CoveredByLayerAbove(redrawRegion))
+      !GetAreAncestorsVisible())
+  {
+    return;
+  }
+
+  if (_flags.hasContentScroll && UpdateType::Modifying == updateType &&
+      RedrawAfterContentScroll(arrangeEffects))
   {
     return;
   }
 
+  if (arrangeEffects.TotalBoundsAreDisjoint())
+  {
+    // The element has moved away from where it was, so redraw the area it now
+    // occupies and the area it left separately instead of everything in between
+    bool arranged = RedrawAfterUpdate(updateType, arrangeEffects,
+                                      arrangeEffects.GetCurrentTotalBounds(), true);
+    RedrawAfterUpdate(updateType, arrangeEffects,
+                      arrangeEffects.GetOriginalTotalBounds(), !arranged);
+  }
+  else
+  {
+    RedrawAfterUpdate(updateType, arrangeEffects, arrangeEffects.GetUnionedTotalBounds(), true);
+  }
+}
+
+bool Element::RedrawAfterUpdate(UpdateType updateType, const ArrangeEffects& arrangeEffects,
+                                const Rect4& redrawRegion, bool mayArrangeChildren)
+{
+  if (CoveredByLayerAbove(redrawRegion))
+  {
+    return false;
+  }
+
   #ifdef DBG
   printf("Calculated redraw region as (%f, %f, %f, %f)\n",
          redrawRegion.left, redrawRegion.top, redrawRegion.right, redrawRegion.bottom);
@@ -667,25 +1116,23 @@ void Element::UpdateHelper(UpdateType updateType)
   {
     auto currentLayer = GetLayer().get();
 
-    int thisAndAncestorClips = 0;
+    bool ancestorClipPushed = false;
+
+    // The ancestors which have been drawn, and so need their drawing cleaned up,
+    // along with the sum of their translations which converts the redraw region
+    // from window coordinates to those of the bounds of their children
+    TraversalStack<Element*> drawnAncestors;
+    Point offset{0, 0};
+    bool ancestorTranslationPushed = false;
 
     if (UpdateType::Adding != updateType || currentLayer->AnyLayersAbove())
     {
       // Before we do any drawing we need to make sure that we have all the
       // ancestor clips pushed.  This duplicates the clipping that is done
       // later by ancestors' DoDrawTasksIfVisible but I don't want to
-      // change that and I don't think it makes any real performance impact.
-      // Also, the amount of explicit clipping tends to be minimal in most
-      // applications so I think this is reasonable.  Finally if we are using
-      // IntersectionStack to manage this stack then it will not even forward
-      // the new clip on if it is the same as the previous.
-      VisitAncestors(
-        [&redrawRegion, &thisAndAncestorClips](Element* ancestor) {
-          if (ancestor->GetIsVisible() && ancestor->ClipToBoundsIfNeeded())
-          {
-            ++thisAndAncestorClips;
-          }
-        });
+      // change that.  The ancestor clips are cached as a single rectangle so
+      // this costs one push however deeply the element is nested.
+      ancestorClipPushed = PushAncestorClip();
 
 
       currentLayer->VisitLowerLayersIf(
@@ -710,50 +1157,62 @@ void Element::UpdateHelper(UpdateType updateType)
         });
 
       VisitAncestors(
-        [&redrawRegion, &thisAndAncestorClips](Element* ancestor) {
+        [&redrawRegion, &drawnAncestors, &offset](Element* ancestor) {
           #ifdef DBG
           printf("Redrawing ancestor %s\n", ancestor->GetTypeName().c_str());
           fflush(stdout);
           #endif
 
-          bool visible = ancestor->DoDrawTasksIfVisible(redrawRegion);
-          if (visible && ancestor->GetClipToBounds())
+          if (ancestor->DoDrawTasksIfVisible(redrawRegion.Translated(-offset.X, -offset.Y)))
+          {
+            drawnAncestors->push_back(ancestor);
+          }
+          if (ancestor->_flags.hasTranslation)
           {
-            ++thisAndAncestorClips;
+            offset.X += ancestor->_cold->translation.X;
+            offset.Y += ancestor->_cold->translation.Y;
           }
         });
 
       // Make sure overlapped elements and their children are drawn next
-      VisitOverlappedElements([&redrawRegion](Element* e) {
-        e->RedrawThisAndDescendents(redrawRegion);
+      VisitOverlappedElements([&redrawRegion, &offset](Element* e) {
+        e->RedrawThisAndDescendents(redrawRegion.Translated(-offset.X, -offset.Y));
       });
     }
+    else if (_parent)
+    {
+      // The ancestors aren't drawn, but this element is still drawn within their
+      // translations
+      offset = GetAncestorTranslation();
+      if (offset.X != 0 || offset.Y != 0)
+      {
+        _elementManager->PushTranslation(offset);
+        ancestorTranslationPushed = true;
+      }
+    }
 
     // Now draw this element and its children unless it's invisible
     // or it's going to be removed
     if (GetIsVisible() && UpdateType::Removing != updateType)
     {
-      // Apply the current element clip, if any, before drawing this and children
-      if (ClipToBoundsIfNeeded())
-      {
-        ++thisAndAncestorClips;
-      }
-
       #ifdef DBG
       printf("Drawing %s\n", GetTypeName().c_str());
       fflush(stdout);
       #endif
 
-      Draw(boost::none);
+      // This also applies the translation and clip of this element, if any,
+      // before drawing this and children
+      DoDrawTasksIfVisible(boost::none);
 
-      if (UpdateType::Adding == updateType ||
+      if (mayArrangeChildren &&
+          (UpdateType::Adding == updateType ||
           arrangeEffects.ElementWasMovedOrResized() ||
           arrangeEffects.ElementBecameVisible() || // because if this is the
                                                    // first time it's visible
                                                    // its children will never
                                                    // have been arranged
           arrangeEffects.ChildrenRequestedArrange() ||
-          GetUpdateRearrangesDescendants())
+          GetUpdateRearrangesDescendants()))
       {
         #ifdef DBG
         printf("Rearranging all children of %s\n", GetTypeName().c_str());
@@ -773,26 +1232,45 @@ void Element::UpdateHelper(UpdateType updateType)
         fflush(stdout);
         #endif
 
-        // Element hasn't moved, so just redraw children without arranging
-        VisitChildren([](Element* child) {
-          child->RedrawThisAndDescendents(boost::none);
+        // Element hasn't moved, so just redraw children without arranging,
+        // except those which this element's arrangement asked to be arranged.
+        // Those which can't reach the redraw region would be clipped away anyway.
+        auto childRegion = Untranslate(redrawRegion.Translated(-offset.X, -offset.Y));
+        VisitChildren([&childRegion](Element* child) {
+          if (child->_flags.needsArrange)
+          {
+            child->ArrangeAndDrawHelper();
+          }
+          else if (child->SubtreeBoundsIntersects(childRegion))
+          {
+            child->RedrawThisAndDescendents(boost::none);
+          }
           return true;
         });
       }
+
+      DoDrawTasksCleanup();
     }
 
-    if (UpdateType::Modifying == updateType)
+    if (UpdateType::Modifying == updateType || UpdateType::ContentChange == updateType)
     {
       // Make sure overlapping elements and their children are drawn on top
-      VisitOverlappingElements([&redrawRegion](Element* e) {
-        e->RedrawThisAndDescendents(redrawRegion);
+      VisitOverlappingElements([&redrawRegion, &offset](Element* e) {
+        e->RedrawThisAndDescendents(redrawRegion.Translated(-offset.X, -offset.Y));
       });
     }
 
-    while (thisAndAncestorClips)
+    for (auto i = drawnAncestors->rbegin(); i != drawnAncestors->rend(); ++i)
+    {
+      (*i)->DoDrawTasksCleanup();
+    }
+    if (ancestorTranslationPushed)
+    {
+      _elementManager->PopTranslation();
+    }
+    if (ancestorClipPushed)
     {
       _elementManager->PopClip();
-      --thisAndAncestorClips;
     }
 
     // Now draw the layers above
@@ -810,40 +1288,211 @@ void Element::UpdateHelper(UpdateType updateType)
   _elementManager->PopClip();
 
   _elementManager->AddToRedrawnRegion(redrawRegion);
+  return true;
+}
+
+bool Element::RedrawAfterContentScroll(const ArrangeEffects& arrangeEffects)
+{
+  if (!_flags.clipToBounds || !GetIsVisible() ||
+      arrangeEffects.ElementWasMovedOrResized() ||
+      arrangeEffects.ElementBecameVisible() ||
+      arrangeEffects.ChildrenRequestedArrange() ||
+      arrangeEffects.GetOriginalTotalBounds() != arrangeEffects.GetCurrentTotalBounds() ||
+      !_elementManager->CanCopyArea() ||
+      GetLayer()->AnyLayersAbove())
+  {
+    return false;
+  }
+
+  // Siblings which overlap this element or any of its ancestors would be copied too
+  for (auto e = this; e != nullptr; e = e->_parent.get())
+  {
+    if (e->_cold && !e->_cold->overlappedBy.empty())
+    {
+      return false;
+    }
+  }
+
+  // The pixels on screen are those within the bounds, the clipping ancestors
+  // and the window
+  auto translation = GetTotalTranslation();
+  auto area        = GetBounds().Translated(translation.X, translation.Y);
+  if (auto ancestorClip = GetAncestorClip())
+  {
+    area.IntersectWith(*ancestorClip);
+  }
+  auto& size = _elementManager->GetSize();
+  if (size.width > 0 && size.height > 0)
+  {
+    area.IntersectWith(Rect4(0, 0, size.width, size.height));
+  }
+
+  auto offset = _cold->contentScroll;
+  if (std::abs(offset.X) >= area.right - area.left || std::abs(offset.Y) >= area.bottom - area.top)
+  {
+    // Nothing that is on screen stays on screen
+    return false;
+  }
+
+  // The children are arranged as usual, but only what can't be copied is drawn
+  auto pool = _elementManager->GetArrangePool();
+  bool rearrangeChildren = GetUpdateRearrangesDescendants();
+  VisitChildren([pool, rearrangeChildren](Element* child) {
+    if (rearrangeChildren || child->_flags.needsArrange)
+    {
+      child->ArrangeHelper(pool);
+    }
+    return true;
+  });
+
+  _elementManager->CopyArea(area, offset);
+
+  Region exposed(area);
+  exposed.Subtract(area.Translated(offset.X, offset.Y));
+  for (auto& rect : exposed)
+  {
+    RedrawAfterUpdate(UpdateType::Modifying, arrangeEffects, rect, false);
+  }
+
+  return true;
+}
+
+void Element::ArrangeForBatchedUpdate(UpdateType updateType, bool rearrangeDescendants,
+                                      Region& redrawRegion)
+{
+  // Same arrangement as UpdateHelper, but the drawing is left to the batch
+  // so that it can be done once for the combined region of all its updates
+  auto monitor = MonitorArrangeEffects(UpdateType::Adding == updateType,
+    GetIsVisible(), GetBounds(), GetTotalBoundsInWindow(true));
+  {
+    _monitoringArrangeEffects = monitor;
+    ScopeExit onScopeExit([this] { _monitoringArrangeEffects = boost::none; });
+
+    DoArrangeTasks();
+  }
+  auto arrangeEffects = monitor.Finish(GetIsVisible(), GetBounds(), GetTotalBoundsInWindow());
+
+  if (GetIsVisible() &&
+      (rearrangeDescendants ||
+       UpdateType::Adding == updateType ||
+       arrangeEffects.ElementWasMovedOrResized() ||
+       arrangeEffects.ElementBecameVisible() ||
+       arrangeEffects.ChildrenRequestedArrange() ||
+       GetUpdateRearrangesDescendants()))
+  {
+    // Children of invisible elements are not arranged, as in ArrangeAndDrawHelper
+    auto pool = _elementManager->GetArrangePool();
+    VisitChildren([pool](Element* child) {
+      child->ArrangeHelper(pool);
+      return true;
+    });
+  }
+  else if (GetIsVisible())
+  {
+    // Only the children which this element's arrangement asked to be arranged
+    auto pool = _elementManager->GetArrangePool();
+    VisitChildren([pool](Element* child) {
+      if (child->_flags.needsArrange)
+      {
+        child->ArrangeHelper(pool);
+      }
+      return true;
+    });
+  }
+
+  if (arrangeEffects.WasInvisibleBeforeAndAfter() || !GetAreAncestorsVisible())
+  {
+    return;
+  }
+
+  if (arrangeEffects.TotalBoundsAreDisjoint())
+  {
+    redrawRegion.Union(arrangeEffects.GetCurrentTotalBounds());
+    redrawRegion.Union(arrangeEffects.GetOriginalTotalBounds());
+  }
+  else
+  {
+    redrawRegion.Union(arrangeEffects.GetUnionedTotalBounds());
+  }
 }
 
 void Element::RedrawThisAndDescendents(const boost::optional<Rect4>& redrawRegion)
 {
+  // The redraw region in the coordinates of the bounds of the children of each
+  // element being visited, which differ from its parent's by its translation
+  TraversalStack<Rect4> regions;
+
   VisitThisAndDescendents(
-    [&redrawRegion](Element* e) // What to do for each element before visiting its children
+    [&redrawRegion, &regions](Element* e) // What to do for each element before visiting its children
     {
-      if (redrawRegion && !e->TotalBoundsIntersects(redrawRegion.get()))
+      if (!redrawRegion)
+      {
+        return e->DoDrawTasksIfVisible(boost::none);
+      }
+
+      auto region = regions->empty() ? redrawRegion.get() : regions->back();
+
+      // The subtree bounds of an element without children are just its total bounds
+      bool hasChildren = e->_firstChild != nullptr;
+      if (hasChildren ? !e->SubtreeBoundsIntersects(region)
+                      : !e->TotalBoundsIntersects(region))
       {
         // Ignore any element hierarchy that doesn't intersect with the redraw region
         return false;
       }
 
+      if (hasChildren && !e->TotalBoundsIntersects(region) && !e->_flags.hasTranslation)
+      {
+        // Only descendents drawn outside of this element reach the redraw region,
+        // and those are clipped away if this element clips to its bounds
+        if (!e->GetIsVisible() || e->GetClipToBounds())
+        {
+          return false;
+        }
+        regions->push_back(region);
+        return true;
+      }
+
       #ifdef DBG
       printf("Redrawing this or descendent %s\n", e->GetTypeName().c_str());
       fflush(stdout);
       #endif
 
-      return e->DoDrawTasksIfVisible(redrawRegion);
+      if (!e->DoDrawTasksIfVisible(region))
+      {
+        return false;
+      }
+      regions->push_back(e->Untranslate(region));
+      return true;
     },
-    [](Element* e) // What to do for each element after visiting its children
+    [&redrawRegion, &regions](Element* e) // What to do for each element after visiting its children
     {
       e->DoDrawTasksCleanup();
+      if (redrawRegion)
+      {
+        regions->pop_back();
+      }
     });
 }
 
 void Element::SetIsVisible(bool isVisible)
 {
-  _isVisible = isVisible;
+  if (_flags.clipToBounds && _flags.isVisible != isVisible && _elementManager)
+  {
+    _elementManager->InvalidateClipCache();
+  }
+  _flags.isVisible = isVisible;
+
+  // Invisible children don't contribute to the subtree bounds of their parent
+  if (_parent)
+  {
+    _parent->InvalidateSubtreeBounds();
+  }
 }
 
 bool Element::GetIsVisible()
 {
-  return _isVisible;
+  return _flags.isVisible;
 }
 
 bool Element::GetAreAncestorsVisible()
@@ -860,27 +1509,31 @@ bool Element::GetAreAncestorsVisible()
 
 void Element::SetIsEnabled(bool isEnabled)
 {
-  _isEnabled = isEnabled;
+  _flags.isEnabled = isEnabled;
 }
 
 bool Element::GetIsEnabled()
 {
-  return _isEnabled;
+  return _flags.isEnabled;
 }
 
 void Element::SetClipToBounds(bool clipToBounds)
 {
-  _clipToBounds = clipToBounds;
+  if (_flags.clipToBounds != clipToBounds && _elementManager)
+  {
+    _elementManager->InvalidateClipCache();
+  }
+  _flags.clipToBounds = clipToBounds;
 }
 
 bool Element::GetClipToBounds()
 {
-  return _clipToBounds;
+  return _flags.clipToBounds;
 }
 
 bool Element::ClipToBoundsIfNeeded()
 {
-  if (_clipToBounds)
+  if (_flags.clipToBounds)
   {
     _elementManager->PushClip(Rect4(GetLeft(), GetTop(), GetRight(), GetBottom()));
 
@@ -890,208 +1543,408 @@ bool Element::ClipToBoundsIfNeeded()
   return false;
 }
 
+void Element::UpdateAncestorCacheIfNeeded()
+{
+  auto generation = _elementManager->GetClipCacheGeneration();
+  if (_clipCacheGeneration == generation)
+  {
+    return;
+  }
+
+  // Collect this element and its ancestors whose caches are out of date, then
+  // compute each one from its parent's on the way back down
+  static thread_local std::vector<Element*> outOfDate;
+  outOfDate.clear();
+  for (Element* e = this; e != nullptr && e->_clipCacheGeneration != generation; e = e->_parent.get())
+  {
+    outOfDate.push_back(e);
+  }
+
+  for (auto it = outOfDate.rbegin(); it != outOfDate.rend(); ++it)
+  {
+    auto e      = *it;
+    auto parent = e->_parent.get();
+
+    bool  hasClip        = false;
+    Rect4 clip;
+    bool  hasTranslation = false;
+    Point translation{0, 0};
+    if (parent)
+    {
+      if (parent->_flags.hasAncestorTranslation)
+      {
+        hasTranslation = true;
+        translation    = parent->_cold->ancestorTranslation;
+      }
+      if (parent->_flags.hasTranslation)
+      {
+        hasTranslation = true;
+        translation.X += parent->_cold->translation.X;
+        translation.Y += parent->_cold->translation.Y;
+      }
+
+      if (parent->_flags.hasAncestorClip)
+      {
+        hasClip = true;
+        clip    = parent->_cold->ancestorClip;
+      }
+      if (parent->GetIsVisible() && parent->GetClipToBounds())
+      {
+        // The clips are kept in window coordinates
+        auto bounds = parent->GetBounds().Translated(translation.X, translation.Y);
+        if (hasClip)
+        {
+          clip.IntersectWith(bounds);
+          if (clip.left >= clip.right || clip.top >= clip.bottom)
+          {
+            clip = IntersectionStack::EmptyRegion;
+          }
+        }
+        else
+        {
+          hasClip = true;
+          clip    = bounds;
+        }
+      }
+    }
+
+    e->_flags.hasAncestorClip = hasClip;
+    if (hasClip)
+    {
+      e->GetColdData().ancestorClip = clip;
+    }
+    e->_flags.hasAncestorTranslation = hasTranslation;
+    if (hasTranslation)
+    {
+      e->GetColdData().ancestorTranslation = translation;
+    }
+    e->_clipCacheGeneration = generation;
+  }
+}
+
+const Rect4* Element::GetAncestorClip()
+{
+  UpdateAncestorCacheIfNeeded();
+  return _flags.hasAncestorClip ? &_cold->ancestorClip : nullptr;
+}
+
+Point Element::GetAncestorTranslation()
+{
+  UpdateAncestorCacheIfNeeded();
+  return _flags.hasAncestorTranslation ? _cold->ancestorTranslation : Point{0, 0};
+}
+
+Point Element::GetTotalTranslation()
+{
+  auto translation = GetAncestorTranslation();
+  if (_flags.hasTranslation)
+  {
+    translation.X += _cold->translation.X;
+    translation.Y += _cold->translation.Y;
+  }
+  return translation;
+}
+
+Rect4 Element::GetTotalBoundsInWindow(bool beforeTranslationChange)
+{
+  auto translation = GetTotalTranslation();
+  if (beforeTranslationChange && _flags.translationChanged)
+  {
+    translation.X += _cold->previousTranslation.X - _cold->translation.X;
+    translation.Y += _cold->previousTranslation.Y - _cold->translation.Y;
+  }
+  return GetTotalBounds().Translated(translation.X, translation.Y);
+}
+
+Rect4 Element::Untranslate(const Rect4& region)
+{
+  if (_flags.hasTranslation)
+  {
+    return region.Translated(-_cold->translation.X, -_cold->translation.Y);
+  }
+  return region;
+}
+
+Point Element::Untranslate(const Point& point)
+{
+  if (_flags.hasTranslation)
+  {
+    return Point{point.X - _cold->translation.X, point.Y - _cold->translation.Y};
+  }
+  return point;
+}
+
+void Element::SetTranslation(const Point& translation)
+{
+  auto& current = GetTranslation();
+  if (current.X == translation.X && current.Y == translation.Y)
+  {
+    return;
+  }
+
+  auto& cold = GetColdData();
+
+  // Unless this is being arranged, the next update needs to know where this
+  // element was drawn before so that the area it left is redrawn
+  if (!_flags.inArrangeMethodNow && !_flags.translationChanged)
+  {
+    cold.previousTranslation  = cold.translation;
+    _flags.translationChanged = true;
+  }
+
+  cold.translation      = translation;
+  _flags.hasTranslation = translation.X != 0 || translation.Y != 0;
+
+  // Every descendent's cached ancestor translation, and any clip below, has moved
+  if (_elementManager)
+  {
+    _elementManager->InvalidateClipCache();
+  }
+
+  // Only the placement of this element within its parent changes: its own bounds
+  // and subtree bounds stay as they were arranged
+  if (_parent)
+  {
+    _parent->InvalidateSubtreeBounds();
+    if (_parent->_childIndex)
+    {
+      _parent->_childIndex->MarkChildMoved(this);
+    }
+  }
+}
+
+void Element::ScrollContent(const Point& offset)
+{
+  GetColdData().contentScroll = offset;
+  _flags.hasContentScroll     = true;
+}
+
+const Point& Element::GetTranslation() const
+{
+  static const Point noTranslation{0, 0};
+  return _cold ? _cold->translation : noTranslation;
+}
+
+bool Element::PushAncestorClip()
+{
+  if (auto clip = GetAncestorClip())
+  {
+    _elementManager->PushClip(*clip);
+    return true;
+  }
+  return false;
+}
+
 void Element::SetConsumesInput(bool consumesInput)
 {
-  _consumesInput = consumesInput;
+  _flags.consumesInput = consumesInput;
 }
 
 bool Element::GetConsumesInput()
 {
-  return _consumesInput;
+  return _flags.consumesInput;
 }
 
 void Element::SetLeft(double left)
 {
-  _isLeftSet = true;
+  _flags.isLeftSet = true;
   _left      = left;
+  OnBoundsChanged();
 }
 
 void Element::SetTop(double top)
 {
-  _isTopSet = true;
+  _flags.isTopSet = true;
   _top      = top;
+  OnBoundsChanged();
 }
 
 void Element::SetRight(double right)
 {
-  _isRightSet = true;
+  _flags.isRightSet = true;
   _right      = right;
+  OnBoundsChanged();
 }
 
 void Element::SetBottom(double bottom)
 {
-  _isBottomSet = true;
+  _flags.isBottomSet = true;
   _bottom      = bottom;
+  OnBoundsChanged();
 }
 
 void Element::SetCenterX(double centerX)
 {
-  _isCenterXSet = true;
+  _flags.isCenterXSet = true;
   _centerX      = centerX;
+  OnBoundsChanged();
 }
 
 void Element::SetCenterY(double centerY)
 {
-  _isCenterYSet = true;
+  _flags.isCenterYSet = true;
   _centerY      = centerY;
+  OnBoundsChanged();
 }
 
 void Element::SetWidth(double width)
 {
-  _isWidthSet = true;
+  _flags.isWidthSet = true;
   _width      = width;
+  OnBoundsChanged();
 }
 
 void Element::SetHeight(double height)
 {
-  _isHeightSet = true;
+  _flags.isHeightSet = true;
   _height      = height;
+  OnBoundsChanged();
 }
 
 HPixels Element::GetLeft()
 {
-  if (!_isLeftSet)
+  if (!_flags.isLeftSet)
   {
-    if (_isWidthSet)
+    if (_flags.isWidthSet)
     {
-      if (_isRightSet)
+      if (_flags.isRightSet)
       {
         _left = _right - _width;
       }
-      else if (_isCenterXSet)
+      else if (_flags.isCenterXSet)
       {
         _left = _centerX - (_width / 2);
       }
     }
-    _isLeftSet = true;
+    _flags.isLeftSet = true;
   }
   return HPixels(_left, _elementManager->GetDpiX());
 }
 
 VPixels Element::GetTop()
 {
-  if (!_isTopSet)
+  if (!_flags.isTopSet)
   {
-    if (_isHeightSet)
+    if (_flags.isHeightSet)
     {
-      if (_isBottomSet)
+      if (_flags.isBottomSet)
       {
         _top = _bottom - _height;
       }
-      else if (_isCenterYSet)
+      else if (_flags.isCenterYSet)
       {
         _top = _centerY - (_height / 2);
       }
     }
-    _isTopSet = true;
+    _flags.isTopSet = true;
   }
   return VPixels(_top, _elementManager->GetDpiY());
 }
 
 HPixels Element::GetRight()
 {
-  if (!_isRightSet)
+  if (!_flags.isRightSet)
   {
-    if (_isWidthSet)
+    if (_flags.isWidthSet)
     {
-      if (_isLeftSet)
+      if (_flags.isLeftSet)
       {
         _right = _left + _width;
       }
-      else if (_isCenterXSet)
+      else if (_flags.isCenterXSet)
       {
         _right = _centerX + (_width / 2);
       }
     }
-    _isRightSet = true;
+    _flags.isRightSet = true;
   }
   return HPixels(_right, _elementManager->GetDpiX());
 }
 
 VPixels Element::GetBottom()
 {
-  if (!_isBottomSet)
+  if (!_flags.isBottomSet)
   {
-    if (_isHeightSet)
+    if (_flags.isHeightSet)
     {
-      if (_isTopSet)
+      if (_flags.isTopSet)
       {
         _bottom = _top + _height;
       }
-      else if (_isCenterYSet)
+      else if (_flags.isCenterYSet)
       {
         _bottom = _centerY + (_height / 2);
       }
     }
-    _isBottomSet = true;
+    _flags.isBottomSet = true;
   }
   return VPixels(_bottom, _elementManager->GetDpiY());
 }
 
 HPixels Element::GetCenterX()
 {
-  if (!_isCenterXSet)
+  if (!_flags.isCenterXSet)
   {
-    if (_isLeftSet && _isRightSet)
+    if (_flags.isLeftSet && _flags.isRightSet)
     {
       _centerX = _left + (_right - _left) / 2;
     }
-    else if (_isLeftSet && _isWidthSet)
+    else if (_flags.isLeftSet && _flags.isWidthSet)
     {
       _centerX = _left + (_width / 2);
     }
-    else if (_isRightSet && _isWidthSet)
+    else if (_flags.isRightSet && _flags.isWidthSet)
     {
       _centerX = _right - (_width / 2);
     }
-    _isCenterXSet = true;
+    _flags.isCenterXSet = true;
   }
   return HPixels(_centerX, _elementManager->GetDpiX());
 }
 
 VPixels Element::GetCenterY()
 {
-  if (!_isCenterYSet)
+  if (!_flags.isCenterYSet)
   {
-    if (_isTopSet && _isBottomSet)
+    if (_flags.isTopSet && _flags.isBottomSet)
     {
       _centerY = _top + (_bottom - _top) / 2;
     }
-    else if (_isTopSet && _isHeightSet)
+    else if (_flags.isTopSet && _flags.isHeightSet)
     {
       _centerY = _top + (_height / 2);
     }
-    else if (_isBottomSet && _isHeightSet)
+    else if (_flags.isBottomSet && _flags.isHeightSet)
     {
       _centerY = _bottom - (_height / 2);
     }
-    _isCenterYSet = true;
+    _flags.isCenterYSet = true;
   }
   return VPixels(_centerY, _elementManager->GetDpiY());
 }
 
 HPixels Element::GetWidth()
 {
-  if (!_isWidthSet)
+  if (!_flags.isWidthSet)
   {
-    if (_isLeftSet && _isRightSet)
+    if (_flags.isLeftSet && _flags.isRightSet)
     {
       _width = _right - _left;
     }
-    _isWidthSet = true;
+    _flags.isWidthSet = true;
   }
   return HPixels(_width, _elementManager->GetDpiX());
 }
 
 VPixels Element::GetHeight()
 {
-  if (!_isHeightSet)
+  if (!_flags.isHeightSet)
   {
-    if (_isTopSet && _isBottomSet)
+    if (_flags.isTopSet && _flags.isBottomSet)
     {
       _height = _bottom - _top;
     }
-    _isHeightSet = true;
+    _flags.isHeightSet = true;
   }
   return VPixels(_height, _elementManager->GetDpiY());
 }
@@ -1103,12 +1956,13 @@ Rect4 Element::GetBounds()
 
 void Element::SetTouchMargin(const Rect4& margin)
 {
-  _touchMargin = margin;
+  GetColdData().touchMargin = margin;
 }
 
 const Rect4& Element::GetTouchMargin() const
 {
-  return _touchMargin;
+  static const Rect4 noMargin;
+  return _cold ? _cold->touchMargin : noMargin;
 }
 
 // Drawing
@@ -1123,9 +1977,47 @@ void Element::Draw(const boost::optional<Rect4>& updateArea)
 
     _drawCallback(this, updateArea);
   }
-  else
+
+  if (_cold && _cold->recordedDrawCallback)
+  {
+    auto& cold = *_cold;
+    if (!cold.displayListIsValid)
+    {
+      #ifdef DBG
+      printf("Recording draw callback for %s\n", GetTypeName().c_str());
+      fflush(stdout);
+      #endif
+
+      cold.displayList.Clear();
+      cold.recordedDrawCallback(this, cold.displayList);
+      cold.displayListIsValid = true;
+    }
+
+    if (auto context = _elementManager->GetDrawingContext())
+    {
+      cold.displayList.Replay(*context, updateArea);
+    }
+  }
+
+  // By default no drawing takes place
+}
+
+void Element::SetRecordedDrawCallback(const std::function<void(Element*, DrawingContext&)>& callback)
+{
+  if (callback || _cold)
   {
-    // By default no drawing takes place
+    auto& cold = GetColdData();
+    cold.recordedDrawCallback = callback;
+    cold.displayList.Clear();
+    cold.displayListIsValid = false;
+  }
+}
+
+void Element::InvalidateDisplayList()
+{
+  if (_cold)
+  {
+    _cold->displayListIsValid = false;
   }
 }
 
@@ -1146,39 +2038,42 @@ ElementQueryInfo Element::GetElementAtPoint(const Point& point)
 
 ElementQueryInfo Element::GetElementAtPointHelper(const Point& point, bool hasDisabledAncestor)
 {
-  if (!GetIsVisible() || (!GetConsumesInput() && 0 == GetChildrenCount()))
-  {
-    return ElementQueryInfo();
-  }
-
   // This algorithm relies on a fundamental expectation that each element's bounds is contained
   // by all its ancestors' bounds
   // Because of that, we don't have to check the child of any ancestor that falls outside of the search point
 
-  if (Intersects(point))
+  // Only a single path is followed down the tree, so the result is simply the deepest
+  // element on that path which consumes input
+  ElementQueryInfo result;
+
+  // The point in the coordinates of the parent's bounds of each element on the path
+  Point localPoint = point;
+
+  Element* e = this;
+  while (e != nullptr)
   {
-    if (_firstChild)
+    if (!e->GetIsVisible() || (!e->GetConsumesInput() && 0 == e->GetChildrenCount()) ||
+        !e->Intersects(localPoint))
     {
-      auto childrenHaveDisabledAncestor = hasDisabledAncestor || !GetIsEnabled();
+      break;
+    }
 
-      auto lastChild = FindLastChild(point);
-      if (lastChild)
-      {
-        auto elementQueryInfo = lastChild->GetElementAtPointHelper(point, childrenHaveDisabledAncestor);
-        if (elementQueryInfo.FoundElement())
-        {
-          return elementQueryInfo;
-        }
-      }
+    if (e->GetConsumesInput())
+    {
+      result = ElementQueryInfo(e, hasDisabledAncestor);
     }
-    if (GetConsumesInput())
+
+    if (!e->_firstChild)
     {
-      return ElementQueryInfo(this, hasDisabledAncestor);
+      break;
     }
+
+    hasDisabledAncestor = hasDisabledAncestor || !e->GetIsEnabled();
+    localPoint = e->Untranslate(localPoint);
+    e = e->FindLastChild(localPoint);
   }
 
-  // No matches here
-  return ElementQueryInfo();
+  return result;
 }
 
 bool Element::GetElementInRect(const Rect4& hitRect, FuzzyHitQuery& hitQuery)
@@ -1189,39 +2084,91 @@ bool Element::GetElementInRect(const Rect4& hitRect, FuzzyHitQuery& hitQuery)
 bool Element::GetElementInRectHelper(
   const Rect4& hitRect, FuzzyHitQuery& hitQuery, bool hasDisabledAncestor)
 {
-  if (!GetIsVisible() || (!GetConsumesInput() && 0 == GetChildrenCount()))
+  // This algorithm relies on a fundamental expectation that each element's bounds is contained
+  // by all its ancestors' bounds
+  // Because of that, we don't have to check the child of any ancestor that falls outside of the search point
+
+  auto mayContainHit = [](Element* e, const Rect4& rect) {
+    return e->GetIsVisible() && (e->GetConsumesInput() || 0 != e->GetChildrenCount()) &&
+           e->TouchIntersects(rect);
+  };
+
+  if (!mayContainHit(this, hitRect))
   {
     return false;
   }
 
-  // This algorithm relies on a fundamental expectation that each element's bounds is contained
-  // by all its ancestors' bounds
-  // Because of that, we don't have to check the child of any ancestor that falls outside of the search point
+  // Each frame owns a range of the candidates, which holds the children of
+  // the frame's element in the order given by VisitLastChildren, and has the
+  // hit rect in the coordinates of the element's bounds
+  struct Frame
+  {
+    Element* element;
+    bool     hasDisabledAncestor;
+    Rect4    hitRect;
+    size_t   beginCandidate;
+    size_t   nextCandidate;
+    size_t   endCandidate;
+  };
+
+  TraversalStack<Frame>    frames;
+  TraversalStack<Element*> candidates;
 
-  if (TouchIntersects(hitRect))
+  auto pushFrame = [&frames, &candidates](Element* e, bool hasDisabledAncestor, const Rect4& rect) {
+    auto localRect = e->Untranslate(rect);
+    auto begin     = candidates->size();
+    if (e->_firstChild)
+    {
+      e->VisitLastChildren(localRect, [&candidates](Element* child) {
+        candidates->push_back(child);
+        return true;
+      });
+    }
+    frames->push_back(Frame{e, hasDisabledAncestor, localRect, begin, begin, candidates->size()});
+  };
+
+  pushFrame(this, hasDisabledAncestor, hitRect);
+
+  while (!frames->empty())
   {
-    if (_firstChild)
+    auto& frame = frames->back();
+
+    if (frame.nextCandidate < frame.endCandidate)
     {
-      auto childrenHaveDisabledAncestor = hasDisabledAncestor || !GetIsEnabled();
+      Element* child = (*candidates)[frame.nextCandidate++];
+      auto childrenHaveDisabledAncestor = frame.hasDisabledAncestor || !frame.element->GetIsEnabled();
 
-      VisitLastChildren(hitRect,
-      [&hitRect, &hitQuery, childrenHaveDisabledAncestor] (Element* child) {
-        child->GetElementInRectHelper(hitRect, hitQuery, childrenHaveDisabledAncestor);
-        // Stop visiting children if we have a 'trumping' match
-        return !hitQuery.FoundFiftyPercent();
-      });
-      if (hitQuery.FoundFiftyPercent())
+      if (mayContainHit(child, frame.hitRect))
+      {
+        // The frame may move as a result, so the rect is copied
+        auto rect = frame.hitRect;
+        pushFrame(child, childrenHaveDisabledAncestor, rect);
+      }
+      else if (hitQuery.FoundFiftyPercent())
       {
         // We already have a 'trumping' match, so stop looking
         return true;
       }
+      continue;
+    }
+
+    Element* e = frame.element;
+    bool hasDisabledAncestorOfElement = frame.hasDisabledAncestor;
+    auto localHitRect = frame.hitRect;
+    candidates->resize(frame.beginCandidate);
+    frames->pop_back();
+
+    if (e->_firstChild && hitQuery.FoundFiftyPercent())
+    {
+      // We already have a 'trumping' match, so stop looking
+      return true;
     }
 
-    if (GetConsumesInput() && (_layer.get() != this))
+    if (e->GetConsumesInput() && (e->_layer.get() != e))
     {
       // No children match, but we already know that this element intersects
-      Rect4 bounds = GetBounds();
-      Rect4 intersectionArea = hitRect;
+      Rect4 bounds = e->GetBounds();
+      Rect4 intersectionArea = localHitRect;
       intersectionArea.IntersectWith(bounds);
 
       auto matchingPercent = intersectionArea.Area() / hitRect.Area();
@@ -1233,98 +2180,72 @@ bool Element::GetElementInRectHelper(
           !hitQuery.MaxMatchingElement.FoundElement() )
       {
         hitQuery.MaxMatchingPercent = matchingPercent;
-        hitQuery.MaxMatchingElement = ElementQueryInfo(this, hasDisabledAncestor);
+        hitQuery.MaxMatchingElement = ElementQueryInfo(e, hasDisabledAncestorOfElement);
       }
     }
 
-    // This element does intersect
-    return true;
+    if (hitQuery.FoundFiftyPercent())
+    {
+      // We already have a 'trumping' match, so stop looking
+      return true;
+    }
   }
 
-  return false;
+  // This element does intersect
+  return true;
 }
 
 void Element::VisitAncestors(const std::function<void(Element*)>& action)
 {
-  VisitAncestorsHelper(action, true);
-}
-
-void Element::VisitAncestorsHelper(const std::function<void(Element*)>& action, bool isCallee)
-{
-  if (_parent)
-  {
-    _parent->VisitAncestorsHelper(action, false);
-  }
-
-  if (!isCallee)
-  {
-    action(this);
-  }
+  VisitAncestors<>(action);
 }
 
 void Element::VisitChildren(const std::function<void(Element*)>& action)
 {
-  if (_firstChild)
-  {
-    for (auto e = _firstChild; e != nullptr; e = e->_nextsibling)
-    {
-      action(e.get());
-    }
-  }
+  VisitChildren<>(action);
 }
 
 void Element::VisitOverlappingElements(const std::function<void(Element*)>& action)
 {
-  auto iter = _overlappedBy.begin();
-  while (iter != _overlappedBy.end())
-  {
-    auto& dependentWeakPtr = *iter;
-    if (auto dependent = dependentWeakPtr.lock())
-    {
-      action(dependent.get());
-      ++iter;
-    }
-    else
-    {
-      // The dependent has disappeared so we will remove it from our list
-      auto eraseIter = iter;
-      ++iter;
-      _overlappedBy.erase(eraseIter);
-    }
-  }
+  VisitOverlappingElements<>(action);
 }
 
 void Element::VisitOverlappedElements(const std::function<void(Element*)>& action)
 {
-  auto iter = _overlaps.begin();
-  while (iter != _overlaps.end())
+  VisitOverlappedElements<>(action);
+}
+
+void Element::VisitChildren(const Rect4& region, const std::function<bool(Element*)>& action)
+{
+  if (_childIndex)
   {
-    auto& dependentWeakPtr = *iter;
-    if (auto dependent = dependentWeakPtr.lock())
-    {
-      action(dependent.get());
-      ++iter;
-    }
-    else
+    TraversalStack<Element*> candidates;
+    _childIndex->QueryRegion(this, region, *candidates);
+
+    for (auto e : *candidates)
     {
-      // The dependent has disappeared so we will remove it from our list
-      auto eraseIter = iter;
-      ++iter;
-      _overlaps.erase(eraseIter);
+      if (e->Intersects(region))
+      {
+        if (!action(e))
+        {
+          // The action returned false, so stop
+          return;
+        }
+      }
     }
+    return;
   }
-}
 
-void Element::VisitChildren(const Rect4& region, const std::function<bool(Element*)>& action)
-{
   // This default is a plain old brute force algorithm to search all the children
   if (_firstChild)
   {
-    for (auto e = _firstChild; e != nullptr; e = e->_nextsibling)
+    // The next child is found first in case the action removes this one
+    for (Element* e = _firstChild.get(), *next; e != nullptr; e = next)
     {
+      next = e->_nextsibling.get();
       if (e->Intersects(region))
       {
-        if (!action(e.get()))
+        if (!action(e))
         {
           // The action returned false, so stop
           return;
@@ -1336,14 +2257,35 @@ void Element::VisitChildren(const Rect4& region, const std::function<bool(Elemen
 
 void Element::VisitLastChildren(const Rect4& region, const std::function<bool(Element*)>& action)
 {
+  if (_childIndex)
+  {
+    TraversalStack<Element*> candidates;
+    _childIndex->QueryRegion(this, region, *candidates);
+
+    for (auto iter = candidates->rbegin(); iter != candidates->rend(); ++iter)
+    {
+      if ((*iter)->Intersects(region))
+      {
+        if (!action(*iter))
+        {
+          // The action returned false, so stop
+          return;
+        }
+      }
+    }
+    return;
+  }
+
   // This default is a plain old brute force algorithm to search all the children
   if (_firstChild)
   {
-    for (auto e = _lastChild; e != nullptr; e = e->_prevsibling)
+    // The previous child is found first in case the action removes this one
+    for (Element* e = _lastChild.get(), *prev; e != nullptr; e = prev)
     {
+      prev = e->_prevsibling.get();
       if (e->Intersects(region))
       {
-        if (!action(e.get()))
+        if (!action(e))
         {
           // The action returned false, so stop
           return;
@@ -1355,14 +2297,34 @@ void Element::VisitLastChildren(const Rect4& region, const std::function<bool(El
 
 void Element::VisitChildrenWithTotalBounds(const Rect4& region, const std::function<bool(Element*)>& action)
 {
+  if (_childIndex)
+  {
+    TraversalStack<Element*> candidates;
+    _childIndex->QueryRegion(this, region, *candidates);
+
+    for (auto e : *candidates)
+    {
+      if (e->TotalBoundsIntersects(region))
+      {
+        if (!action(e))
+        {
+          return;
+        }
+      }
+    }
+    return;
+  }
+
   // This default is a plain old brute force algorithm to search all the children
   if (_firstChild)
   {
-    for (auto e = _firstChild; e != nullptr; e = e->_nextsibling)
+    // The next child is found first in case the action removes this one
+    for (Element* e = _firstChild.get(), *next; e != nullptr; e = next)
     {
+      next = e->_nextsibling.get();
       if (e->TotalBoundsIntersects(region))
       {
-        if (!action(e.get()))
+        if (!action(e))
         {
           return;
         }
@@ -1374,45 +2336,25 @@ void Element::VisitChildrenWithTotalBounds(const Rect4& region, const std::funct
 void Element::VisitThisAndDescendents(const std::function<bool(Element*)>& preChildrenAction,
                                       const std::function<void(Element*)>& postChildrenAction)
 {
-  if (preChildrenAction(this))
-  {
-    VisitChildren([&preChildrenAction, &postChildrenAction](Element* child) {
-      child->VisitThisAndDescendents(preChildrenAction, postChildrenAction);
-      return true;
-    });
-
-    postChildrenAction(this);
-  }
+  VisitThisAndDescendents<>(preChildrenAction, postChildrenAction);
 }
 
 void Element::VisitThisAndDescendents(const Rect4& region,
                                       const std::function<bool(Element*)>& preChildrenAction,
                                       const std::function<void(Element*)>& postChildrenAction)
 {
-  if (preChildrenAction(this))
-  {
-    VisitChildren(region,
-                  [&preChildrenAction, &postChildrenAction](Element* child) {
-                    child->VisitThisAndDescendents(preChildrenAction, postChildrenAction);
-                    return true;
-                  });
-
-    postChildrenAction(this);
-  }
+  VisitThisAndDescendents<>(region, preChildrenAction, postChildrenAction);
 }
 
 void Element::VisitThisAndDescendents(const std::function<void(Element*)>& action)
 {
-  VisitChildren([&action](Element* child) {
-    child->VisitThisAndDescendents(action);
-    return true;
-  });
-
-  action(this);
+  VisitThisAndDescendents<>(action);
 }
 
-bool Element::Intersects(const Rect4& region)
+bool Element::Intersects(const Rect4& parentRegion)
 {
+  auto region = Untranslate(parentRegion);
+
   // Thanks to http://stackoverflow.com/a/306332/4307047 for the rectangle intersection logic
   // but including equality with each operator so that identical rectangles would succeed,
   // and also flipping the comparisons for top and bottom since we're using top-down coordinates
@@ -1420,12 +2362,14 @@ bool Element::Intersects(const Rect4& region)
           region.top <= GetBottom() && region.bottom >= GetTop());
 }
 
-bool Element::TouchIntersects(const Rect4& region)
+bool Element::TouchIntersects(const Rect4& parentRegion)
 {
-  auto left   = GetLeft()   + _touchMargin.left;
-  auto top    = GetTop()    + _touchMargin.top;
-  auto right  = GetRight()  - _touchMargin.right;
-  auto bottom = GetBottom() - _touchMargin.bottom;
+  auto region = Untranslate(parentRegion);
+  auto& touchMargin = GetTouchMargin();
+  auto left   = GetLeft()   + touchMargin.left;
+  auto top    = GetTop()    + touchMargin.top;
+  auto right  = GetRight()  - touchMargin.right;
+  auto bottom = GetBottom() - touchMargin.bottom;
   // Thanks to http://stackoverflow.com/a/306332/4307047 for the rectangle intersection logic
   // but including equality with each operator so that identical rectangles would succeed,
   // and also flipping the comparisons for top and bottom since we're using top-down coordinates
@@ -1433,14 +2377,103 @@ bool Element::TouchIntersects(const Rect4& region)
           region.top <= bottom && region.bottom >= top);
 }
 
-bool Element::Intersects(const Point& point)
+bool Element::Intersects(const Point& parentPoint)
 {
+  auto point = Untranslate(parentPoint);
   return (point.X >= GetLeft() && point.X <= GetRight() &&
           point.Y >= GetTop() && point.Y <= GetBottom());
 }
 
-bool Element::TotalBoundsIntersects(const Rect4& region)
+const Rect4& Element::GetSubtreeBounds()
+{
+  if (_flags.subtreeBoundsDirty)
+  {
+    // Only the changed parts of the subtree are recalculated, deepest first,
+    // since the bounds of clean subtrees are still valid.  Elements without
+    // children are handled by their parent rather than being visited.
+    if (!_firstChild)
+    {
+      UpdateSubtreeBounds();
+    }
+    else
+    {
+      VisitThisAndDescendents(
+        [](Element* e) { return e->_flags.subtreeBoundsDirty && e->_firstChild; },
+        [](Element* e) { e->UpdateSubtreeBounds(); });
+    }
+  }
+  return _subtreeBounds;
+}
+
+void Element::UpdateSubtreeBounds()
+{
+  auto totalBounds = GetTotalBounds();
+
+  Rect4 bounds;
+  bounds.left   = std::min(totalBounds.left, totalBounds.right);
+  bounds.top    = std::min(totalBounds.top, totalBounds.bottom);
+  bounds.right  = std::max(totalBounds.left, totalBounds.right);
+  bounds.bottom = std::max(totalBounds.top, totalBounds.bottom);
+
+  for (Element* child = _firstChild.get(); child != nullptr; child = child->_nextsibling.get())
+  {
+    if (child->GetIsVisible())
+    {
+      // Any child which is still invalid has no children of its own
+      if (child->_flags.subtreeBoundsDirty)
+      {
+        child->UpdateSubtreeBounds();
+      }
+
+      // The subtree bounds of each child are in the coordinates of its own bounds
+      auto childBounds = child->_subtreeBounds;
+      if (child->_flags.hasTranslation)
+      {
+        childBounds = childBounds.Translated(child->_cold->translation.X, child->_cold->translation.Y);
+      }
+      bounds.left   = std::min(bounds.left, childBounds.left);
+      bounds.top    = std::min(bounds.top, childBounds.top);
+      bounds.right  = std::max(bounds.right, childBounds.right);
+      bounds.bottom = std::max(bounds.bottom, childBounds.bottom);
+    }
+  }
+
+  _subtreeBounds            = bounds;
+  _flags.subtreeBoundsDirty = false;
+}
+
+bool Element::SubtreeBoundsIntersects(const Rect4& parentRegion)
 {
+  auto region = Untranslate(parentRegion);
+  auto& subtreeBounds = GetSubtreeBounds();
+  return (region.left <= subtreeBounds.right && region.right >= subtreeBounds.left &&
+          region.top <= subtreeBounds.bottom && region.bottom >= subtreeBounds.top);
+}
+
+void Element::OnBoundsChanged()
+{
+  InvalidateSubtreeBounds();
+
+  // Outside of arranging, where DoArrangeTasks takes care of it, a clipping
+  // element which moves changes the clips of its descendants
+  if (_flags.clipToBounds && !_flags.inArrangeMethodNow && _elementManager)
+  {
+    _elementManager->InvalidateClipCache();
+  }
+}
+
+void Element::InvalidateSubtreeBounds()
+{
+  // Every ancestor of an invalid subtree is invalid too, so stop at the first one
+  for (Element* e = this; e != nullptr && !e->_flags.subtreeBoundsDirty; e = e->_parent.get())
+  {
+    e->_flags.subtreeBoundsDirty = true;
+  }
+}
+
+bool Element::TotalBoundsIntersects(const Rect4& parentRegion)
+{
+  auto region = Untranslate(parentRegion);
   auto& totalBounds = GetTotalBounds();
 
   // Thanks to http://stackoverflow.com/a/306332/4307047 for the rectangle intersection logic
@@ -1452,21 +2485,61 @@ bool Element::TotalBoundsIntersects(const Rect4& region)
 
 Element* Element::FindLastChild(const Point& point)
 {
+  if (_childIndex)
+  {
+    TraversalStack<Element*> candidates;
+    _childIndex->QueryPoint(this, point, *candidates);
+
+    for (auto iter = candidates->rbegin(); iter != candidates->rend(); ++iter)
+    {
+      if ((*iter)->Intersects(point))
+      {
+        return *iter;
+      }
+    }
+    return nullptr;
+  }
+
   // This is a plain old brute force algorithm to search all the children
 
   if (_firstChild)
   {
-    for (auto e = _lastChild; e != nullptr; e = e->_prevsibling)
+    for (Element* e = _lastChild.get(); e != nullptr; e = e->_prevsibling.get())
     {
       if (e->Intersects(point))
       {
-        return e.get();
+        return e;
       }
     }
   }
   return nullptr;
 }
 
+void Element::SetUsesChildIndex(bool usesChildIndex)
+{
+  if (usesChildIndex && !_childIndex)
+  {
+    _childIndex = std::make_unique<ChildIndex>();
+  }
+  else if (!usesChildIndex)
+  {
+    _childIndex = nullptr;
+  }
+}
+
+bool Element::GetUsesChildIndex()
+{
+  return bool(_childIndex);
+}
+
+void Element::InvalidateChildIndex()
+{
+  if (_childIndex)
+  {
+    _childIndex->MarkDirty();
+  }
+}
+
 void Element::SetLeft(Inches left)
 {
   SetLeft(double(left) * _elementManager->GetDpiX());
@@ -1572,19 +2645,30 @@ bool Element::ThisOrAncestors(const std::function<bool(Element*)>& predicate)
 
 void Element::SetVisualBounds(const boost::optional<Rect4>& bounds)
 {
-  _visualBounds = bounds;
+  if (bounds || _cold)
+  {
+    GetColdData().visualBounds = bounds;
+  }
+
+  if (_parent && _parent->_childIndex)
+  {
+    _parent->_childIndex->MarkChildMoved(this);
+  }
+
+  InvalidateSubtreeBounds();
 }
 
 const boost::optional<Rect4>& Element::GetVisualBounds()
 {
-  return _visualBounds;
+  static const boost::optional<Rect4> noVisualBounds;
+  return _cold ? _cold->visualBounds : noVisualBounds;
 }
 
 const Rect4 Element::GetTotalBounds()
 {
-  if (_visualBounds)
+  if (_cold && _cold->visualBounds)
   {
-    return _visualBounds.get();
+    return _cold->visualBounds.get();
   }
   else
   {
@@ -1618,12 +2702,84 @@ void Element::SetTypeName(std::string_view name)
 
 void Element::SetUpdateRearrangesDescendants(bool updateRearrangesDescendents)
 {
-  _updateRearrangesDescendents = updateRearrangesDescendents;
+  _flags.updateRearrangesDescendents = updateRearrangesDescendents;
 }
 
 bool Element::GetUpdateRearrangesDescendants()
 {
-  return _updateRearrangesDescendents;
+  return _flags.updateRearrangesDescendents;
+}
+
+void Element::InvalidateArrange()
+{
+  _flags.needsArrange = true;
+  MarkAncestorsNeedFlush();
+}
+
+void Element::InvalidateDraw()
+{
+  // Whatever was recorded is out of date as well
+  InvalidateDisplayList();
+  _flags.needsDraw = true;
+  MarkAncestorsNeedFlush();
+}
+
+bool Element::GetNeedsArrange()
+{
+  return _flags.needsArrange;
+}
+
+bool Element::GetNeedsDraw()
+{
+  return _flags.needsDraw;
+}
+
+void Element::MarkAncestorsNeedFlush()
+{
+  // Flush only descends where this is set, so every ancestor needs it, but any
+  // ancestor which already has it set has had its own ancestors marked as well
+  for (Element* e = _parent.get(); e != nullptr && !e->_flags.descendantNeedsFlush; e = e->_parent.get())
+  {
+    e->_flags.descendantNeedsFlush = true;
+  }
+}
+
+void Element::SetArrangeDependsOnWindowSize(bool arrangeDependsOnWindowSize)
+{
+  if (arrangeDependsOnWindowSize == _flags.arrangeDependsOnWindowSize)
+  {
+    return;
+  }
+  _flags.arrangeDependsOnWindowSize = arrangeDependsOnWindowSize;
+
+  // An element which can't be registered yet, such as one still being constructed,
+  // is registered when it is added to its parent
+  if (_elementManager)
+  {
+    if (arrangeDependsOnWindowSize)
+    {
+      _elementManager->AddWindowSizeDependent(this);
+    }
+    else
+    {
+      _elementManager->RemoveWindowSizeDependent(this);
+    }
+  }
+}
+
+bool Element::GetArrangeDependsOnWindowSize()
+{
+  return _flags.arrangeDependsOnWindowSize;
+}
+
+void Element::SetArrangeChildrenInParallel(bool arrangeChildrenInParallel)
+{
+  _flags.arrangeChildrenInParallel = arrangeChildrenInParallel;
+}
+
+bool Element::GetArrangeChildrenInParallel()
+{
+  return _flags.arrangeChildrenInParallel;
 }
 
 Element::MonitorArrangeEffects::MonitorArrangeEffects(
@@ -1658,6 +2814,7 @@ Element::ArrangeEffects Element::MonitorArrangeEffects::Finish(bool currentlyVis
     result.elementWasMovedOrResized = true;
     result.elementBecameVisible = true;
     result.unionedTotalBounds = currentTotalBounds;
+    result.totalBoundsAreDisjoint = false;
   }
   else
   {
@@ -1694,8 +2851,14 @@ Element::ArrangeEffects Element::MonitorArrangeEffects::Finish(bool currentlyVis
     {
       result.unionedTotalBounds.bottom = currentTotalBounds.bottom;
     }
+
+    result.totalBoundsAreDisjoint = originallyVisible && currentlyVisible &&
+                                    !originalTotalBounds.Intersects(currentTotalBounds);
   }
 
+  result.originalTotalBounds = originalTotalBounds;
+  result.currentTotalBounds  = currentTotalBounds;
+
   result.childrenRequestedArrange = childrenRequestedArrange;
 
   return result;
@@ -1721,6 +2884,21 @@ const Rect4& Element::ArrangeEffects::GetUnionedTotalBounds() const
   return unionedTotalBounds;
 }
 
+bool Element::ArrangeEffects::TotalBoundsAreDisjoint() const
+{
+  return totalBoundsAreDisjoint;
+}
+
+const Rect4& Element::ArrangeEffects::GetOriginalTotalBounds() const
+{
+  return originalTotalBounds;
+}
+
+const Rect4& Element::ArrangeEffects::GetCurrentTotalBounds() const
+{
+  return currentTotalBounds;
+}
+
 bool Element::ArrangeEffects::ChildrenRequestedArrange() const
 {
   return childrenRequestedArrange;
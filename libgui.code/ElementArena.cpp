@@ -0,0 +1,30 @@
+#include "libgui/ElementArena.h"
+
+namespace libgui
+{
+
+ElementArena::ElementArena(size_t initialSize)
+  : _resource(initialSize)
+{
+}
+
+void* ElementArena::Allocate(size_t bytes, size_t alignment)
+{
+  auto pointer = _resource.allocate(bytes, alignment);
+  ++_liveAllocations;
+  return pointer;
+}
+
+void ElementArena::Deallocate(void* pointer, size_t bytes, size_t alignment)
+{
+  // The monotonic resource only releases its memory when it is destroyed
+  _resource.deallocate(pointer, bytes, alignment);
+  --_liveAllocations;
+}
+
+size_t ElementArena::GetLiveAllocations() const
+{
+  return _liveAllocations;
+}
+
+}
@@ -3,9 +3,16 @@
 #include "libgui/Layer.h"
 #include "libgui/ScopeExit.h"
 
+#include <algorithm>
+
+#include <stdexcept>
+
 namespace libgui
 {
 
+// The most rectangles of a redraw region which are redrawn separately
+static const size_t MaxRedrawPasses = 8;
+
 ElementManager::ElementManager()
  : _isDebugLoggingEnabled(false),
    _inUpdateCycle(false),
@@ -166,10 +173,19 @@ void ElementManager::RemoveLayer(std::shared_ptr<Layer> layer)
   // each other alive artificially
   layer->_arrangeCallback = nullptr;
   layer->_drawCallback = nullptr;
-  layer->_setViewModelCallback = nullptr;
+  if (layer->_cold)
+  {
+    layer->_cold->setViewModelCallback = nullptr;
+    layer->_cold->recordedDrawCallback = nullptr;
+    layer->_cold->displayList.Clear();
+  }
 
   layer->SetIsDetached(true);
 
+  // The arena stays alive until the last of its elements has been destroyed
+  // (each holds a reference) and is then released in one go
+  layer->_arena = nullptr;
+
   auto layerBelow = layer->_layerBelow.lock();
   auto layerAbove = layer->_layerAbove.lock();
 
@@ -199,6 +215,30 @@ void ElementManager::RemoveLayer(std::shared_ptr<Layer> layer)
   ReApplyActiveInputs();
 }
 
+void ElementManager::SetArrangeThreadCount(size_t threadCount)
+{
+  if (_inUpdateCycle)
+  {
+    throw std::runtime_error("The arrange thread count cannot be changed during an update");
+  }
+
+  _arrangePool.reset();
+  if (threadCount > 0)
+  {
+    _arrangePool = std::make_unique<WorkStealingPool>(threadCount);
+  }
+}
+
+size_t ElementManager::GetArrangeThreadCount() const
+{
+  return _arrangePool ? _arrangePool->GetWorkerCount() : 0;
+}
+
+WorkStealingPool* ElementManager::GetArrangePool() const
+{
+  return _arrangePool.get();
+}
+
 const ElementManager::LayerList& ElementManager::GetLayers() const
 {
   return _layers;
@@ -288,7 +328,8 @@ void ElementManager::NotifyNewPoint(InputId inputId, Point point)
         // layer and found no matches.
 
         auto origHitRect = hitRect;
-        hitRect.ExcludeWith(layer->GetBounds());
+        auto& translation = layer->GetTranslation();
+        hitRect.ExcludeWith(layer->GetBounds().Translated(translation.X, translation.Y));
         if (hitRect.IsEmpty())
         {
           break;
@@ -414,7 +455,11 @@ void ElementManager::PushClip(const Rect4& clip)
 
   if (_pushClipCallback)
   {
-    _pushClipCallback(clip);
+    _pushClipCallback(clip.Translated(_translation.X, _translation.Y));
+  }
+  if (_drawingContext)
+  {
+    _drawingContext->PushClip(clip);
   }
 }
 
@@ -424,49 +469,138 @@ void ElementManager::PopClip()
   {
     _popClipCallback();
   }
+  if (_drawingContext)
+  {
+    _drawingContext->PopClip();
+  }
 }
 
-void ElementManager::ClearRedrawnRegion()
+void ElementManager::SetPushTranslationCallback(const std::function<void(const Point&)>& callback)
 {
-  _redrawnRegion = boost::none;
+  _pushTranslationCallback = callback;
 }
 
-void ElementManager::AddToRedrawnRegion(const Rect4& region)
+void ElementManager::SetPopTranslationCallback(const std::function<void()>& callback)
+{
+  _popTranslationCallback = callback;
+}
+
+bool ElementManager::CanTranslate() const
+{
+  return (_pushTranslationCallback && _popTranslationCallback) || _drawingContext;
+}
+
+void ElementManager::PushTranslation(const Point& offset)
 {
-  if (_redrawnRegion)
+  _translations.push_back(_translation);
+  _translation.X += offset.X;
+  _translation.Y += offset.Y;
+
+  if (_pushTranslationCallback)
+  {
+    _pushTranslationCallback(offset);
+  }
+  if (_drawingContext)
   {
-    // Expand the existing region to include this new region
-    auto& currentRegion = _redrawnRegion.get();
+    _drawingContext->PushTranslation(offset);
+  }
+}
 
-    if (region.left < currentRegion.left)
-    {
-      currentRegion.left = region.left;
-    }
-    if (region.top < currentRegion.top)
-    {
-      currentRegion.top = region.top;
-    }
-    if (region.right > currentRegion.right)
-    {
-      currentRegion.right = region.right;
-    }
-    if (region.bottom > currentRegion.bottom)
-    {
-      currentRegion.bottom = region.bottom;
-    }
+void ElementManager::PopTranslation()
+{
+  _translation = _translations.back();
+  _translations.pop_back();
+
+  if (_popTranslationCallback)
+  {
+    _popTranslationCallback();
   }
-  else
+  if (_drawingContext)
   {
-    // There isn't any region yet, so use the specified region as the only region
-    _redrawnRegion = region;
+    _drawingContext->PopTranslation();
   }
 }
 
-const boost::optional<Rect4>& ElementManager::GetRedrawnRegion()
+void ElementManager::SetCopyAreaCallback(const std::function<void(const Rect4&, const Point&)>& callback)
+{
+  _copyAreaCallback = callback;
+}
+
+bool ElementManager::CanCopyArea() const
+{
+  return _copyAreaCallback || (_drawingContext && _drawingContext->CanCopyArea());
+}
+
+void ElementManager::CopyArea(const Rect4& area, const Point& offset)
+{
+  if (_copyAreaCallback)
+  {
+    _copyAreaCallback(area, offset);
+  }
+  if (_drawingContext)
+  {
+    _drawingContext->CopyArea(area, offset);
+  }
+
+  // Whatever had already been redrawn within the area has now been moved as well
+  Region moved(_redrawnRegion);
+  moved.Intersect(area);
+  for (auto& rect : moved)
+  {
+    auto destination = rect.Translated(offset.X, offset.Y);
+    destination.IntersectWith(area);
+    _redrawnRegion.Union(destination);
+  }
+
+  _copiedAreas.push_back(CopiedArea{area, offset});
+}
+
+void ElementManager::InvalidateClipCache()
+{
+  // Zero is reserved for elements which have never cached a clip.  This may be
+  // called from arrange threads, hence the atomic increments.
+  if (++_clipCacheGeneration == 0)
+  {
+    ++_clipCacheGeneration;
+  }
+}
+
+uint32_t ElementManager::GetClipCacheGeneration() const
+{
+  return _clipCacheGeneration.load(std::memory_order_relaxed);
+}
+
+void ElementManager::SetDrawingContext(const std::shared_ptr<DrawingContext>& context)
+{
+  _drawingContext = context;
+}
+
+DrawingContext* ElementManager::GetDrawingContext() const
+{
+  return _drawingContext.get();
+}
+
+void ElementManager::ClearRedrawnRegion()
+{
+  _redrawnRegion.Clear();
+  _copiedAreas.clear();
+}
+
+void ElementManager::AddToRedrawnRegion(const Rect4& region)
+{
+  _redrawnRegion.Union(region);
+}
+
+const Region& ElementManager::GetRedrawnRegion() const
 {
   return _redrawnRegion;
 }
 
+const std::vector<ElementManager::CopiedArea>& ElementManager::GetCopiedAreas() const
+{
+  return _copiedAreas;
+}
+
 void ElementManager::UpdateOrAddPending(std::shared_ptr<Element> element,
                                         Element::UpdateType type)
 {
@@ -476,12 +610,24 @@ void ElementManager::UpdateOrAddPending(std::shared_ptr<Element> element,
     return;
   }
 
+  if (_batchDepth > 0 &&
+      (Element::UpdateType::Adding == type || Element::UpdateType::Modifying == type))
+  {
+    AddBatchedUpdate(element, type);
+    return;
+  }
+
   // Beginning a new update cycle and end it when we're done
   _inUpdateCycle = true;
   ScopeExit scopeExit ([this]{ _inUpdateCycle = false; });
 
   element->UpdateHelper(type);
 
+  PerformPendingUpdates();
+}
+
+void ElementManager::PerformPendingUpdates()
+{
   // Before we finish the cycle, process and pop all remaining pending updates
   // (each update here might also add more pending updates which will also
   //  get processed)
@@ -495,6 +641,253 @@ void ElementManager::UpdateOrAddPending(std::shared_ptr<Element> element,
   }
 }
 
+void ElementManager::BeginBatch()
+{
+  ++_batchDepth;
+}
+
+void ElementManager::Commit()
+{
+  if (_batchDepth == 0)
+  {
+    throw std::runtime_error("Commit was called without a matching BeginBatch");
+  }
+
+  if (--_batchDepth > 0)
+  {
+    return;
+  }
+
+  if (_inUpdateCycle)
+  {
+    // Committing from within an update (for example, from an arrange callback)
+    // so the batched updates are performed as soon as the current one is complete
+    for (auto& update : _batchedUpdates)
+    {
+      update.element->_flags.isInUpdateBatch = false;
+      _pendingUpdates.push_back(std::move(update));
+    }
+    _batchedUpdates.clear();
+    return;
+  }
+
+  PerformBatchedUpdates();
+}
+
+bool ElementManager::IsBatching() const
+{
+  return _batchDepth > 0;
+}
+
+void ElementManager::AddBatchedUpdate(std::shared_ptr<Element> element, Element::UpdateType type)
+{
+  if (element->_flags.isInUpdateBatch)
+  {
+    // An element which is modified after being added still needs to be fully added
+    if (Element::UpdateType::Adding == type)
+    {
+      for (auto& update : _batchedUpdates)
+      {
+        if (update.element == element)
+        {
+          update.type = type;
+          break;
+        }
+      }
+    }
+    return;
+  }
+
+  element->_flags.isInUpdateBatch = true;
+  _batchedUpdates.emplace_back(std::move(element), type);
+}
+
+void ElementManager::Flush()
+{
+  if (_inUpdateCycle || _batchDepth > 0)
+  {
+    throw std::runtime_error("Flush cannot be called during an update or a batch");
+  }
+
+  std::vector<Element*> drawOnly;
+  for (auto& layer : _layers)
+  {
+    layer->VisitThisAndDescendents(
+      [this, &drawOnly](Element* e)
+      {
+        auto& flags = e->_flags;
+        bool visitChildren = flags.descendantNeedsFlush;
+
+        // Elements which have never been updated are left for their initial update
+        if (flags.initialUpdate)
+        {
+          if (flags.needsArrange)
+          {
+            AddBatchedUpdate(e->shared_from_this(), Element::UpdateType::Modifying);
+          }
+          else if (flags.needsDraw)
+          {
+            drawOnly.push_back(e);
+          }
+        }
+
+        flags.needsArrange         = false;
+        flags.needsDraw            = false;
+        flags.descendantNeedsFlush = false;
+        return visitChildren;
+      },
+      [](Element*) {});
+  }
+
+  // Elements which only need drawing are redrawn where they already are, and
+  // where they were before being translated, as part of the same region as the
+  // elements being arranged
+  Region redrawRegion;
+  for (auto e : drawOnly)
+  {
+    if (e->GetIsVisible() && e->GetAreAncestorsVisible())
+    {
+      redrawRegion.Union(e->GetTotalBoundsInWindow(true));
+      redrawRegion.Union(e->GetTotalBoundsInWindow());
+    }
+    e->_flags.translationChanged = false;
+  }
+
+  PerformBatchedUpdates(std::move(redrawRegion));
+}
+
+void ElementManager::Post(std::function<void()> action)
+{
+  {
+    std::lock_guard<std::mutex> lock(_postedMutex);
+    _postedActions.push_back(std::move(action));
+  }
+
+  if (_postCallback)
+  {
+    _postCallback();
+  }
+}
+
+void ElementManager::SetPostCallback(const std::function<void()>& callback)
+{
+  _postCallback = callback;
+}
+
+size_t ElementManager::RunPostedActions()
+{
+  std::vector<std::function<void()>> actions;
+  {
+    std::lock_guard<std::mutex> lock(_postedMutex);
+    actions.swap(_postedActions);
+  }
+
+  for (auto& action : actions)
+  {
+    action();
+  }
+  return actions.size();
+}
+
+void ElementManager::PerformBatchedUpdates(Region redrawRegion)
+{
+  auto updates = std::move(_batchedUpdates);
+  _batchedUpdates.clear();
+
+  // Drop the updates of elements which have been removed since, and of elements
+  // whose ancestor is also being updated, in which case the ancestor rearranges
+  // its descendants instead
+  std::vector<bool> isSuperseded(updates.size(), false);
+  for (size_t i = 0; i < updates.size(); ++i)
+  {
+    auto element = updates[i].element.get();
+    if (element->_flags.isDetached)
+    {
+      isSuperseded[i] = true;
+      continue;
+    }
+
+    for (auto ancestor = element->_parent.get(); ancestor; ancestor = ancestor->_parent.get())
+    {
+      if (ancestor->_flags.isInUpdateBatch)
+      {
+        ancestor->_flags.batchRearrangesDescendants = true;
+        isSuperseded[i] = true;
+        break;
+      }
+    }
+  }
+
+  std::vector<bool> rearrangeDescendants(updates.size(), false);
+  for (size_t i = 0; i < updates.size(); ++i)
+  {
+    auto& flags = updates[i].element->_flags;
+    rearrangeDescendants[i]          = flags.batchRearrangesDescendants;
+    flags.isInUpdateBatch            = false;
+    flags.batchRearrangesDescendants = false;
+  }
+
+  _inUpdateCycle = true;
+  ScopeExit scopeExit ([this]{ _inUpdateCycle = false; });
+
+  // Arrange everything first so that the redraw regions can be combined
+  for (size_t i = 0; i < updates.size(); ++i)
+  {
+    if (!isSuperseded[i])
+    {
+      auto& update = updates[i];
+      update.element->ArrangeForBatchedUpdate(update.type, rearrangeDescendants[i], redrawRegion);
+    }
+  }
+
+  if (!redrawRegion.IsEmpty())
+  {
+    RedrawLayers(redrawRegion);
+  }
+
+  PerformPendingUpdates();
+}
+
+void ElementManager::RedrawLayers(const Region& region)
+{
+  // Each rectangle costs a pass over the layers, so a region which has become
+  // fragmented is redrawn as a whole instead
+  if (region.GetRects().size() > MaxRedrawPasses)
+  {
+    RedrawLayers(region.GetBounds());
+    return;
+  }
+
+  for (auto& rect : region)
+  {
+    RedrawLayers(rect);
+  }
+}
+
+void ElementManager::RedrawLayers(const Rect4& region)
+{
+  // Layers below the highest layer whose opaque area covers the region are hidden
+  auto firstLayer = _layers.begin();
+  for (auto it = _layers.end(); it != _layers.begin();)
+  {
+    --it;
+    if ((*it)->OpaqueAreaContains(region))
+    {
+      firstLayer = it;
+      break;
+    }
+  }
+
+  PushClip(region);
+  for (auto it = firstLayer; it != _layers.end(); ++it)
+  {
+    (*it)->RedrawThisAndDescendents(region);
+  }
+  PopClip();
+
+  AddToRedrawnRegion(region);
+}
+
 const Size& ElementManager::GetSize() const
 {
   return _size;
@@ -502,7 +895,61 @@ const Size& ElementManager::GetSize() const
 
 void ElementManager::SetSize(const Size& size)
 {
+  if (size.width == _size.width && size.height == _size.height)
+  {
+    return;
+  }
   _size = size;
+
+  auto iter = _windowSizeDependents.begin();
+  while (iter != _windowSizeDependents.end())
+  {
+    if (auto element = iter->lock())
+    {
+      if (element->GetArrangeDependsOnWindowSize())
+      {
+        element->InvalidateArrange();
+      }
+      ++iter;
+    }
+    else
+    {
+      // The element has disappeared so we will remove it from our list
+      iter = _windowSizeDependents.erase(iter);
+    }
+  }
+}
+
+void ElementManager::AddWindowSizeDependent(Element* element)
+{
+  // Elements can't be referred to until they are owned by a shared_ptr
+  auto dependent = element->weak_from_this();
+  if (dependent.expired())
+  {
+    return;
+  }
+
+  // The same element may be added again, for example when it is moved to another parent
+  for (auto& existing : _windowSizeDependents)
+  {
+    if (!existing.owner_before(dependent) && !dependent.owner_before(existing))
+    {
+      return;
+    }
+  }
+  _windowSizeDependents.push_back(std::move(dependent));
+}
+
+void ElementManager::RemoveWindowSizeDependent(Element* element)
+{
+  auto dependent = element->weak_from_this();
+  _windowSizeDependents.erase(
+    std::remove_if(_windowSizeDependents.begin(), _windowSizeDependents.end(),
+                   [&dependent](const std::weak_ptr<Element>& existing) {
+                     return existing.expired() ||
+                            (!existing.owner_before(dependent) && !dependent.owner_before(existing));
+                   }),
+    _windowSizeDependents.end());
 }
 
 double ElementManager::GetWidth() const
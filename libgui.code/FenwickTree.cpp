@@ -0,0 +1,174 @@
+#include "libgui/FenwickTree.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace libgui
+{
+
+int FenwickTree::GetSize() const
+{
+  return int(_values.size());
+}
+
+void FenwickTree::Assign(int count, double value)
+{
+  _values.assign(count, value);
+  Rebuild();
+}
+
+void FenwickTree::Insert(int index, int count, double value)
+{
+  if (index < 0 || index > GetSize() || count < 0)
+  {
+    throw std::runtime_error("Values can only be inserted within the tree");
+  }
+  if (index == GetSize())
+  {
+    // Appending doesn't change the nodes which are already there
+    for (int i = 0; i < count; ++i)
+    {
+      Append(value);
+    }
+    return;
+  }
+  _values.insert(_values.begin() + index, count, value);
+  Rebuild();
+}
+
+void FenwickTree::Remove(int index, int count)
+{
+  if (index < 0 || count < 0 || index + count > GetSize())
+  {
+    throw std::runtime_error("Values can only be removed from within the tree");
+  }
+  if (index + count == GetSize())
+  {
+    // Nor does removing values from the end
+    _values.resize(index);
+    _tree.resize(index + 1);
+    UpdateHighestBit();
+    return;
+  }
+  _values.erase(_values.begin() + index, _values.begin() + index + count);
+  Rebuild();
+}
+
+void FenwickTree::Move(int index, int count, int newIndex)
+{
+  if (index < 0 || newIndex < 0 || count < 0 ||
+      index + count > GetSize() || newIndex + count > GetSize())
+  {
+    throw std::runtime_error("Values can only be moved within the tree");
+  }
+
+  auto begin = _values.begin();
+  if (newIndex < index)
+  {
+    std::rotate(begin + newIndex, begin + index, begin + index + count);
+  }
+  else
+  {
+    std::rotate(begin + index, begin + index + count, begin + newIndex + count);
+  }
+  Rebuild();
+}
+
+double FenwickTree::Get(int index) const
+{
+  return _values[index];
+}
+
+void FenwickTree::Set(int index, double value)
+{
+  auto delta = value - _values[index];
+  _values[index] = value;
+  for (auto i = index + 1; i < int(_tree.size()); i += i & -i)
+  {
+    _tree[i] += delta;
+  }
+}
+
+double FenwickTree::GetPrefixSum(int count) const
+{
+  double sum = 0;
+  for (auto i = std::min(count, GetSize()); i > 0; i -= i & -i)
+  {
+    sum += _tree[i];
+  }
+  return sum;
+}
+
+double FenwickTree::GetTotal() const
+{
+  return GetPrefixSum(GetSize());
+}
+
+int FenwickTree::FindIndex(double offset) const
+{
+  // Descend from the largest power of two, taking each range which ends at or
+  // before the offset, to count the values which end at or before it
+  int    count     = 0;
+  double remaining = offset;
+  for (auto bit = _highestBit; bit > 0; bit >>= 1)
+  {
+    auto next = count + bit;
+    if (next < int(_tree.size()) && _tree[next] <= remaining)
+    {
+      count      = next;
+      remaining -= _tree[next];
+    }
+  }
+  return std::min(count, GetSize() - 1);
+}
+
+void FenwickTree::Rebuild()
+{
+  // Each node passes its sum up to its parent, which builds the tree in O(n)
+  _tree.assign(_values.size() + 1, 0.0);
+  for (int i = 1; i < int(_tree.size()); ++i)
+  {
+    _tree[i] += _values[i - 1];
+    auto parent = i + (i & -i);
+    if (parent < int(_tree.size()))
+    {
+      _tree[parent] += _tree[i];
+    }
+  }
+
+  UpdateHighestBit();
+}
+
+void FenwickTree::Append(double value)
+{
+  // The new node covers the value and the ranges of the nodes which end just
+  // before it, down to the start of its own range, so it is the sum of those
+  if (_tree.empty())
+  {
+    _tree.push_back(0.0);
+  }
+  auto i = int(_tree.size());
+  auto sum = value;
+  for (auto j = i - 1; j > i - (i & -i); j -= j & -j)
+  {
+    sum += _tree[j];
+  }
+  _values.push_back(value);
+  _tree.push_back(sum);
+
+  if (_highestBit * 2 <= GetSize())
+  {
+    _highestBit = std::max(1, _highestBit * 2);
+  }
+}
+
+void FenwickTree::UpdateHighestBit()
+{
+  _highestBit = 1;
+  while (_highestBit * 2 <= GetSize())
+  {
+    _highestBit *= 2;
+  }
+}
+
+}
@@ -1,4 +1,5 @@
 ﻿#include "libgui/Grid.h"
+#include "libgui/ElementManager.h"
 
 #include <cmath>
 
@@ -8,7 +9,6 @@ Grid::Grid(Element::Dependencies elementDependencies)
   : Element(elementDependencies, "Grid")
 {
   SetClipToBounds(true);
-  SetUpdateRearrangesDescendants(true);
 }
 
 void Grid::Arrange()
@@ -21,10 +21,31 @@ void Grid::Arrange()
   if (_cellHeight == 0 || !_itemsProvider || !_cellCreateCallback)
   {
     // Invalid state
+    _cellsWereArranged = false;
     return;
   }
 
-  auto totalCount = _itemsProvider->GetTotalItems();
+  auto totalCount     = _itemsProvider->GetTotalItems();
+  _arrangeTotalItems  = totalCount;
+
+  if (!_itemReady)
+  {
+    // Loaded items are handed back on whichever thread loaded them, so the cell
+    // is updated from the ElementManager's thread
+    std::weak_ptr<Grid> weakGrid = std::static_pointer_cast<Grid>(shared_from_this());
+    std::weak_ptr<ElementManager> weakElementManager = GetElementManager()->shared_from_this();
+    _itemReady = [weakGrid, weakElementManager](int index) {
+      if (auto elementManager = weakElementManager.lock())
+      {
+        elementManager->Post([weakGrid, index] {
+          if (auto grid = weakGrid.lock())
+          {
+            grid->OnItemReady(index);
+          }
+        });
+      }
+    };
+  }
 
   if (_lastHeightUsedForScrollCheck != GetHeight() ||
       _lastItemCountUsedForScrollCheck != totalCount)
@@ -43,6 +64,11 @@ void Grid::Arrange()
   }
 
   auto childrenCount   = GetChildrenCount();
+  if (0 == childrenCount)
+  {
+    // The cells may have been removed externally
+    _cells.clear();
+  }
   int  visibleRows     = int(std::ceil(GetHeight() / _cellHeight)) + 1; // Need an extra for partial rows
   auto visibleItems    = visibleRows * _columns;
   auto missingChildren = std::min(totalCount, visibleItems) - childrenCount;
@@ -50,6 +76,7 @@ void Grid::Arrange()
   for (int i = 0; i < missingChildren; i++)
   {
     auto cellContainer = this->CreateChild<Cell>(childrenCount + i);
+    _cells.push_back(cellContainer.get());
     _cellCreateCallback(cellContainer);
     cellContainer->UpdateAfterAdd();
   }
@@ -67,6 +94,88 @@ void Grid::Arrange()
   currentRow     = std::max(0, currentRow);
   _baseItemIndex = currentRow * _columns;
 
+  // The rows are positioned relative to this, so if it is all that has changed
+  // then the grid has simply been scrolled and every cell has moved by the difference
+  auto scrollTop      = currentRow * _cellHeight + _rowOffset;
+  bool cellsCanBeKept = _cellsWereArranged && missingChildren <= 0 &&
+                        _arrangedBounds == GetBounds() && _arrangedColumns == _columns &&
+                        _arrangedCellHeight == _cellHeight && _arrangedItemCount == totalCount;
+  bool scrolled       = _arrangedScrollTop != scrollTop;
+  bool onlyScrolled   = cellsCanBeKept && scrolled && !_itemsChanged;
+
+  if (_scrollByCopy && onlyScrolled)
+  {
+    // Cells are snapped to pixel boundaries, so they only look the same after
+    // moving by a whole number of pixels
+    auto scrolled = _arrangedScrollTop - scrollTop;
+    if (std::abs(scrolled - std::round(scrolled)) < 1e-6)
+    {
+      ScrollContent(Point{0, std::round(scrolled)});
+    }
+  }
+
+  // After a scroll or changes which were notified by the items provider, the cells
+  // which still show the same item are only moved (or, if the backend can't draw
+  // them translated, arranged again with the item they already have) and just those
+  // which now show another item are rebound.  Any other update arranges every cell,
+  // so that changes to the items are shown.
+  bool keepCells    = cellsCanBeKept && (scrolled || _itemsChanged);
+  bool canTranslate = GetElementManager()->CanTranslate();
+  _reboundCells.clear();
+  auto cellRows = (int(_cells.size()) + _columns - 1) / _columns;
+  for (int cellRow = 0; cellRow < cellRows; ++cellRow)
+  {
+    auto itemRow = GetItemRowForCellRow(cellRow);
+    for (int column = 0; column < _columns; ++column)
+    {
+      auto index = cellRow * _columns + column;
+      if (index >= int(_cells.size()))
+      {
+        break;
+      }
+
+      auto cell      = _cells[index];
+      auto itemIndex = itemRow * _columns + column;
+      if (keepCells && cell->GetItemIndex() == itemIndex)
+      {
+        if (canTranslate)
+        {
+          cell->SetTranslation(Point{0, std::round(GetCellTop(itemRow)) - cell->GetTop()});
+        }
+        else
+        {
+          cell->SetItem(cell->GetViewModel());
+          cell->InvalidateArrange();
+        }
+      }
+      else
+      {
+        cell->SetItemIndex(itemIndex);
+        cell->InvalidateArrange();
+        _reboundCells.push_back(cell);
+      }
+    }
+  }
+  FetchReboundItems(totalCount);
+
+  if (_prefetchRows > 0)
+  {
+    int direction = 0;
+    if (onlyScrolled)
+    {
+      direction = scrollTop > _arrangedScrollTop ? 1 : -1;
+    }
+    PrefetchRows(direction);
+  }
+
+  _cellsWereArranged  = true;
+  _arrangedBounds     = GetBounds();
+  _arrangedColumns    = _columns;
+  _arrangedCellHeight = _cellHeight;
+  _arrangedItemCount  = totalCount;
+  _arrangedScrollTop  = scrollTop;
+  _arrangeTotalItems  = -1;
+  _itemsChanged       = false;
 }
 
 double Grid::GetCurrentOffsetPercent()
@@ -76,7 +185,7 @@ double Grid::GetCurrentOffsetPercent()
 
 double Grid::GetThumbSizePercent()
 {
-  auto totalRows          = std::ceil(double(_itemsProvider->GetTotalItems()) / _columns);
+  auto totalRows          = std::ceil(double(GetTotalItems()) / _columns);
   auto totalContentHeight = (totalRows * _cellHeight) + _topPadding + _bottomPadding;
   return std::min(1.0, GetHeight() / totalContentHeight);
 }
@@ -114,7 +223,7 @@ void Grid::ScrollTo(std::shared_ptr<ViewModelBase> item)
   // Figure out what row this item is in
   int row = index / _columns;
 
-  auto totalRows          = std::ceil(double(_itemsProvider->GetTotalItems()) / _columns);
+  auto totalRows          = std::ceil(double(GetTotalItems()) / _columns);
   auto totalContentHeight = (totalRows * _cellHeight) + _topPadding + _bottomPadding;
 
   auto rowTop = (row * _cellHeight) + _topPadding;
@@ -132,16 +241,19 @@ bool Grid::CanScroll()
 {
   if (!_itemsProvider) return false; // No content
 
-  auto totalRows          = std::ceil(double(_itemsProvider->GetTotalItems()) / _columns);
+  auto totalRows          = std::ceil(double(GetTotalItems()) / _columns);
   auto totalContentHeight = (totalRows * _cellHeight) + _topPadding + _bottomPadding;
   return totalContentHeight > GetHeight();
 }
 
-Grid::Cell::Cell(Element::Dependencies elementDependencies, int index)
+Grid::Cell::Cell(Element::Dependencies elementDependencies, int itemIndex)
   : Element(elementDependencies, "Grid::Cell"),
     _grid(std::dynamic_pointer_cast<Grid>(elementDependencies.parent)),
-    _index(index)
+    _itemIndex(itemIndex)
 {
+  // What the descendents show depends on the item, so when a cell is updated
+  // because its item has been loaded they are all rearranged
+  SetUpdateRearrangesDescendants(true);
 }
 
 void Grid::Cell::PrepareViewModel()
@@ -150,10 +262,17 @@ void Grid::Cell::PrepareViewModel()
   {
     if (grid->_itemsProvider)
     {
-      auto index = grid->_baseItemIndex + _index;
-      if (index < grid->_itemsProvider->GetTotalItems())
+      if (_hasItem)
+      {
+        // Already fetched along with the other cells' items
+        _hasItem = false;
+      }
+      else if (_itemIndex < grid->_itemsProvider->GetTotalItems())
       {
-        SetViewModel(grid->_itemsProvider->GetItem(index));
+        auto& items = grid->_fetchedItems;
+        grid->_itemsProvider->RequestItems(_itemIndex, 1, grid->_itemReady, items);
+        SetViewModel(items.empty() ? nullptr : items.front());
+        items.clear();
       }
       else
       {
@@ -169,23 +288,41 @@ void Grid::Cell::Arrange()
   {
     SetIsVisible(GetViewModel() != nullptr);
 
-    auto row = _index / grid->_columns;
-    auto col = _index % grid->_columns;
+    auto row = _itemIndex / grid->_columns;
+    auto col = _itemIndex % grid->_columns;
 
-    auto left   = (grid->GetLeft() + col * grid->_cellWidth);
-    auto right  = left + grid->_cellWidth;
-    auto top    = grid->GetTop() - grid->_rowOffset
-                  + row * grid->_cellHeight;
-    auto bottom = top + grid->_cellHeight;
+    auto left  = (grid->GetLeft() + col * grid->_cellWidth);
+    auto right = left + grid->_cellWidth;
+    auto top   = grid->GetCellTop(row);
 
     // Snap to pixel boundaries
     SetLeft(std::round(left));
     SetRight(std::round(right));
     SetTop(std::round(top));
-    SetBottom(std::round(bottom));
+    SetBottom(std::round(top + grid->_cellHeight));
+
+    // Any translation which moved the cell since it was last arranged is replaced
+    // by the new arrangement
+    SetTranslation(Point{0, 0});
   }
 }
 
+int Grid::Cell::GetItemIndex() const
+{
+  return _itemIndex;
+}
+
+void Grid::Cell::SetItemIndex(int itemIndex)
+{
+  _itemIndex = itemIndex;
+}
+
+void Grid::Cell::SetItem(std::shared_ptr<ViewModelBase> item)
+{
+  SetViewModel(std::move(item));
+  _hasItem = true;
+}
+
 int Grid::GetColumns() const
 {
   return _columns;
@@ -233,7 +370,25 @@ std::shared_ptr<ItemsProvider> Grid::GetItemsProvider() const
 
 void Grid::SetItemsProvider(std::shared_ptr<ItemsProvider> itemsProvider)
 {
-  _itemsProvider = itemsProvider;
+  if (_itemsProvider)
+  {
+    _itemsProvider->RemoveItemsChangedHandler(_itemsChangedHandlerId);
+  }
+
+  _itemsProvider     = itemsProvider;
+  _cellsWereArranged = false;
+
+  if (_itemsProvider)
+  {
+    std::weak_ptr<Grid> weakGrid = std::static_pointer_cast<Grid>(shared_from_this());
+    _itemsChangedHandlerId = _itemsProvider->AddItemsChangedHandler(
+      [weakGrid](const ItemsProvider::ItemsChange& change) {
+        if (auto grid = weakGrid.lock())
+        {
+          grid->OnItemsChanged(change);
+        }
+      });
+  }
 }
 
 void Grid::SetCellCreateCallback(const std::function<void(std::shared_ptr<Element>)>& cellCreateCallback)
@@ -241,10 +396,361 @@ void Grid::SetCellCreateCallback(const std::function<void(std::shared_ptr<Elemen
   _cellCreateCallback = cellCreateCallback;
 }
 
+void Grid::SetScrollByCopy(bool scrollByCopy)
+{
+  _scrollByCopy = scrollByCopy;
+}
+
+bool Grid::GetScrollByCopy() const
+{
+  return _scrollByCopy;
+}
+
+int Grid::GetTotalItems()
+{
+  return _arrangeTotalItems >= 0 ? _arrangeTotalItems : _itemsProvider->GetTotalItems();
+}
+
+void Grid::FetchReboundItems(int totalCount)
+{
+  if (_reboundCells.empty())
+  {
+    return;
+  }
+
+  // The rebound cells show consecutive items (after a scroll, the rows which came
+  // into view), so one range covers them all
+  auto first = totalCount;
+  auto end   = 0;
+  for (auto cell : _reboundCells)
+  {
+    auto index = cell->GetItemIndex();
+    if (index < totalCount)
+    {
+      first = std::min(first, index);
+      end   = std::max(end, index + 1);
+    }
+  }
+
+  _fetchedItems.clear();
+  if (first < end)
+  {
+    _itemsProvider->RequestItems(first, end - first, _itemReady, _fetchedItems);
+  }
+
+  for (auto cell : _reboundCells)
+  {
+    auto offset = cell->GetItemIndex() - first;
+    if (offset >= 0 && offset < int(_fetchedItems.size()) && offset < end - first)
+    {
+      cell->SetItem(_fetchedItems[offset]);
+    }
+    else
+    {
+      cell->SetItem(nullptr);
+    }
+  }
+
+  _fetchedItems.clear();
+  _reboundCells.clear();
+}
+
+void Grid::SetPrefetchRows(int prefetchRows)
+{
+  _prefetchRows = prefetchRows;
+}
+
+int Grid::GetPrefetchRows() const
+{
+  return _prefetchRows;
+}
+
+void Grid::PrefetchRows(int direction)
+{
+  auto baseRow = _baseItemIndex / _columns;
+  if (baseRow == _prefetchedBaseRow && direction == _prefetchedDirection)
+  {
+    // The same rows have already been prefetched
+    return;
+  }
+  _prefetchedBaseRow   = baseRow;
+  _prefetchedDirection = direction;
+
+  auto cellRows = (int(_cells.size()) + _columns - 1) / _columns;
+  if (direction >= 0)
+  {
+    PrefetchItemRows(baseRow + cellRows, baseRow + cellRows + _prefetchRows);
+  }
+  if (direction <= 0)
+  {
+    PrefetchItemRows(baseRow - _prefetchRows, baseRow);
+  }
+}
+
+void Grid::PrefetchItemRows(int firstRow, int endRow)
+{
+  auto index = std::max(0, firstRow * _columns);
+  auto end   = std::min(GetTotalItems(), endRow * _columns);
+  if (index < end)
+  {
+    _itemsProvider->Prefetch(index, end - index);
+  }
+}
+
+void Grid::OnItemReady(int index)
+{
+  for (auto cell : _cells)
+  {
+    if (cell->GetItemIndex() == index)
+    {
+      cell->UpdateAfterModify();
+      return;
+    }
+  }
+}
+
+void Grid::OnItemsChanged(const ItemsProvider::ItemsChange& change)
+{
+  if (!_cellsWereArranged)
+  {
+    // Every cell is bound when the grid is next arranged anyway
+    InvalidateArrange();
+    return;
+  }
+
+  auto oldCount = _arrangedItemCount;
+  auto newCount = oldCount;
+  if (ItemsProvider::ItemsChange::Type::Inserted == change.type)
+  {
+    newCount += change.count;
+  }
+  else if (ItemsProvider::ItemsChange::Type::Removed == change.type)
+  {
+    newCount -= change.count;
+  }
+
+  // Keep the rows in view where they are.  The items can only stay in the same
+  // cells when they move by whole rows, but the grid scrolls by whole rows either way.
+  auto anchor    = _baseItemIndex;
+  auto rowsMoved = change.MapViewIndex(anchor) / _columns - anchor / _columns;
+
+  auto offset      = _offsetPercent * GetContentHeight(oldCount) + rowsMoved * _cellHeight;
+  auto totalHeight = GetContentHeight(newCount);
+  _offsetPercent   = totalHeight > 0 ? offset / totalHeight : 0.0;
+
+  _baseItemIndex     += rowsMoved * _columns;
+  _arrangedScrollTop += rowsMoved * _cellHeight;
+  _cellRowShift      -= rowsMoved;
+
+  // Renumber the cells' items, so that the next arrange can tell which cells still
+  // show the right item
+  bool cellsAffected = false;
+  for (auto cell : _cells)
+  {
+    auto index    = cell->GetItemIndex();
+    auto newIndex = index < oldCount && !change.Invalidates(index) ? change.MapIndex(index) : -1;
+    cell->SetItemIndex(newIndex);
+    cellsAffected |= newIndex != index + rowsMoved * _columns;
+  }
+
+  _arrangedItemCount = newCount;
+  _itemsChanged      = true;
+  _prefetchedBaseRow = -1;
+
+  if (cellsAffected)
+  {
+    InvalidateArrange();
+  }
+  else if (_thumbDataChangeCallback)
+  {
+    // Every cell still shows the same item in the same place, as when items are
+    // appended below the view, so only the scroll position and range have changed
+    _thumbDataChangeCallback();
+  }
+}
+
+double Grid::GetContentHeight(int itemCount)
+{
+  auto totalRows = std::ceil(double(itemCount) / _columns);
+  return (totalRows * _cellHeight) + _topPadding + _bottomPadding;
+}
+
 void Grid::OnElementIsBeingRemoved()
 {
   // Release anything held in a lambda capture
   _cellCreateCallback = nullptr;
+  _itemReady          = nullptr;
+
+  if (_itemsProvider)
+  {
+    _itemsProvider->RemoveItemsChangedHandler(_itemsChangedHandlerId);
+    _itemsChangedHandlerId = -1;
+  }
+
+  _cells.clear();
+}
+
+int Grid::GetItemRowForCellRow(int cellRow)
+{
+  auto baseRow = _baseItemIndex / _columns;
+  if (_cells.size() % _columns != 0)
+  {
+    return baseRow + cellRow;
+  }
+
+  auto cellRows = int(_cells.size()) / _columns;
+  return baseRow + ((cellRow - _cellRowShift - baseRow) % cellRows + cellRows) % cellRows;
+}
+
+double Grid::GetCellTop(int itemRow)
+{
+  return GetTop() - _rowOffset + (itemRow - _baseItemIndex / _columns) * _cellHeight;
+}
+
+bool Grid::CanLookUpCellsDirectly()
+{
+  // The cell layout is only known once the grid has been arranged with valid
+  // parameters, and it only describes the children if they are all cells
+  return _cellHeight > 0 && _cellWidth > 0 &&
+         !_cells.empty() && int(_cells.size()) == GetChildrenCount();
+}
+
+bool Grid::GetCellRange(const Rect4& region, int& firstRow, int& lastRow,
+                        int& firstColumn, int& lastColumn)
+{
+  auto rows = (int(_cells.size()) + _columns - 1) / _columns;
+
+  auto top  = GetTop() - _rowOffset;
+  auto left = GetLeft();
+
+  // Cells are snapped to pixel boundaries, so widen the range by one cell
+  // in every direction and leave the exact test to the caller
+  firstRow    = int(std::floor((region.top - top) / _cellHeight)) - 1;
+  lastRow     = int(std::floor((region.bottom - top) / _cellHeight)) + 1;
+  firstColumn = int(std::floor((region.left - left) / _cellWidth)) - 1;
+  lastColumn  = int(std::floor((region.right - left) / _cellWidth)) + 1;
+
+  firstRow    = std::max(0, firstRow);
+  lastRow     = std::min(rows - 1, lastRow);
+  firstColumn = std::max(0, firstColumn);
+  lastColumn  = std::min(_columns - 1, lastColumn);
+
+  return firstRow <= lastRow && firstColumn <= lastColumn;
+}
+
+Element* Grid::FindLastChild(const Point& point)
+{
+  if (!CanLookUpCellsDirectly())
+  {
+    return Element::FindLastChild(point);
+  }
+
+  int firstRow, lastRow, firstColumn, lastColumn;
+  if (!GetCellRange(Rect4(point.X, point.Y, point.X, point.Y),
+                    firstRow, lastRow, firstColumn, lastColumn))
+  {
+    return nullptr;
+  }
+
+  // Search from the last cell to the first to match the drawing order
+  auto baseRow  = _baseItemIndex / _columns;
+  auto cellRows = (int(_cells.size()) + _columns - 1) / _columns;
+  for (int cellRow = cellRows - 1; cellRow >= 0; --cellRow)
+  {
+    auto row = GetItemRowForCellRow(cellRow) - baseRow;
+    if (row < firstRow || row > lastRow)
+    {
+      continue;
+    }
+    for (int column = lastColumn; column >= firstColumn; --column)
+    {
+      auto index = cellRow * _columns + column;
+      if (index < int(_cells.size()) && _cells[index]->Intersects(point))
+      {
+        return _cells[index];
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+void Grid::VisitChildren(const Rect4& region, const std::function<bool(Element*)>& action)
+{
+  if (!CanLookUpCellsDirectly())
+  {
+    Element::VisitChildren(region, action);
+    return;
+  }
+
+  int firstRow, lastRow, firstColumn, lastColumn;
+  if (!GetCellRange(region, firstRow, lastRow, firstColumn, lastColumn))
+  {
+    return;
+  }
+
+  // Visit the cells in the drawing order, which is the order of the rows of cells
+  // rather than the rows they show
+  auto baseRow  = _baseItemIndex / _columns;
+  auto cellRows = (int(_cells.size()) + _columns - 1) / _columns;
+  for (int cellRow = 0; cellRow < cellRows; ++cellRow)
+  {
+    auto row = GetItemRowForCellRow(cellRow) - baseRow;
+    if (row < firstRow || row > lastRow)
+    {
+      continue;
+    }
+    for (int column = firstColumn; column <= lastColumn; ++column)
+    {
+      auto index = cellRow * _columns + column;
+      if (index < int(_cells.size()) && _cells[index]->Intersects(region))
+      {
+        if (!action(_cells[index]))
+        {
+          // The action returned false, so stop
+          return;
+        }
+      }
+    }
+  }
+}
+
+void Grid::VisitLastChildren(const Rect4& region, const std::function<bool(Element*)>& action)
+{
+  if (!CanLookUpCellsDirectly())
+  {
+    Element::VisitLastChildren(region, action);
+    return;
+  }
+
+  int firstRow, lastRow, firstColumn, lastColumn;
+  if (!GetCellRange(region, firstRow, lastRow, firstColumn, lastColumn))
+  {
+    return;
+  }
+
+  auto baseRow  = _baseItemIndex / _columns;
+  auto cellRows = (int(_cells.size()) + _columns - 1) / _columns;
+  for (int cellRow = cellRows - 1; cellRow >= 0; --cellRow)
+  {
+    auto row = GetItemRowForCellRow(cellRow) - baseRow;
+    if (row < firstRow || row > lastRow)
+    {
+      continue;
+    }
+    for (int column = lastColumn; column >= firstColumn; --column)
+    {
+      auto index = cellRow * _columns + column;
+      if (index < int(_cells.size()) && _cells[index]->Intersects(region))
+      {
+        if (!action(_cells[index]))
+        {
+          // The action returned false, so stop
+          return;
+        }
+      }
+    }
+  }
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "libgui/IndexedItemsProvider.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace libgui
+{
+
+int IndexedItemsProvider::GetTotalItems()
+{
+  return int(_items.size());
+}
+
+std::shared_ptr<ViewModelBase> IndexedItemsProvider::GetItem(int index)
+{
+  if (index < 0 || index >= int(_items.size()))
+  {
+    return nullptr;
+  }
+  return _items[index];
+}
+
+void IndexedItemsProvider::GetItems(int first, int count, std::vector<std::shared_ptr<ViewModelBase>>& items)
+{
+  ThrowIfOutOfRange(first, count);
+  items.assign(_items.begin() + first, _items.begin() + first + count);
+}
+
+int IndexedItemsProvider::GetItemIndex(std::shared_ptr<ViewModelBase> item)
+{
+  // Catch up with the items which have moved since the last lookup
+  for (; _indexedCount < int(_items.size()); ++_indexedCount)
+  {
+    _positions[_items[_indexedCount].get()] = _indexedCount;
+  }
+
+  auto it = _positions.find(item.get());
+  if (it == _positions.end())
+  {
+    return -1;
+  }
+  return it->second;
+}
+
+void IndexedItemsProvider::Insert(int index, const std::vector<std::shared_ptr<ViewModelBase>>& items)
+{
+  ThrowIfOutOfRange(index, 0);
+  _items.insert(_items.begin() + index, items.begin(), items.end());
+  _indexedCount = std::min(_indexedCount, index);
+  NotifyItemsInserted(index, int(items.size()));
+}
+
+void IndexedItemsProvider::Insert(int index, std::shared_ptr<ViewModelBase> item)
+{
+  ThrowIfOutOfRange(index, 0);
+  _items.insert(_items.begin() + index, std::move(item));
+  _indexedCount = std::min(_indexedCount, index);
+  NotifyItemsInserted(index, 1);
+}
+
+void IndexedItemsProvider::Append(const std::vector<std::shared_ptr<ViewModelBase>>& items)
+{
+  Insert(int(_items.size()), items);
+}
+
+void IndexedItemsProvider::Remove(int index, int count)
+{
+  ThrowIfOutOfRange(index, count);
+  for (int i = index; i < index + count; ++i)
+  {
+    _positions.erase(_items[i].get());
+  }
+  _items.erase(_items.begin() + index, _items.begin() + index + count);
+  _indexedCount = std::min(_indexedCount, index);
+  NotifyItemsRemoved(index, count);
+}
+
+void IndexedItemsProvider::Clear()
+{
+  auto count = int(_items.size());
+  _items.clear();
+  _positions.clear();
+  _indexedCount = 0;
+  NotifyItemsRemoved(0, count);
+}
+
+void IndexedItemsProvider::Move(int index, int count, int newIndex)
+{
+  ThrowIfOutOfRange(index, count);
+  ThrowIfOutOfRange(newIndex, count);
+
+  auto begin = _items.begin();
+  if (newIndex < index)
+  {
+    std::rotate(begin + newIndex, begin + index, begin + index + count);
+  }
+  else
+  {
+    std::rotate(begin + index, begin + index + count, begin + newIndex + count);
+  }
+  _indexedCount = std::min(_indexedCount, std::min(index, newIndex));
+  NotifyItemsMoved(index, count, newIndex);
+}
+
+void IndexedItemsProvider::Replace(int index, std::shared_ptr<ViewModelBase> item)
+{
+  ThrowIfOutOfRange(index, 1);
+  _positions.erase(_items[index].get());
+  _items[index] = std::move(item);
+  if (index < _indexedCount)
+  {
+    _positions[_items[index].get()] = index;
+  }
+  NotifyItemsChanged(index, 1);
+}
+
+void IndexedItemsProvider::ThrowIfOutOfRange(int index, int count) const
+{
+  if (index < 0 || count < 0 || index + count > int(_items.size()))
+  {
+    throw std::runtime_error("The range of items is outside the list");
+  }
+}
+
+}
@@ -20,18 +20,18 @@ void IntersectionStack::PushRegion(const Rect4& newRegion)
   if (_stack.empty())
   {
     SignalChangeIfNeeded(newRegion);
-    _stack.push(newRegion);
+    _stack.push_back(newRegion);
   }
   else
   {
     // Intersect the current region and push the result
-    auto& currentRegion = _stack.top();
+    auto currentRegion = _stack.back();
 
     if (currentRegion == EmptyRegion)
     {
       // The current region is empty, and intersecting empty with anything else results in empty.
       SignalChangeIfNeeded(EmptyRegion);
-      _stack.push(EmptyRegion);
+      _stack.push_back(EmptyRegion);
     }
     else
     {
@@ -46,13 +46,13 @@ void IntersectionStack::PushRegion(const Rect4& newRegion)
       {
         // The rectangles overlap
         SignalChangeIfNeeded(intersection);
-        _stack.push(intersection);
+        _stack.push_back(intersection);
       }
       else
       {
         // The rectangles do not overlap, so clip everything
         SignalChangeIfNeeded(EmptyRegion);
-        _stack.push(EmptyRegion);
+        _stack.push_back(EmptyRegion);
       }
     }
   }
@@ -61,7 +61,7 @@ void IntersectionStack::PushRegion(const Rect4& newRegion)
 
 void IntersectionStack::PopRegion()
 {
-  _stack.pop();
+  _stack.pop_back();
 
   SignalChangeIfNeeded(GetCurrentRegion());
 }
@@ -102,7 +102,7 @@ IntersectionStack::OptRegion IntersectionStack::GetCurrentRegion()
   }
   else
   {
-    return _stack.top();
+    return _stack.back();
   }
 }
 
@@ -7,4 +7,141 @@ ItemsProvider::~ItemsProvider()
 {
 }
 
+void ItemsProvider::GetItems(int first, int count, std::vector<std::shared_ptr<ViewModelBase>>& items)
+{
+  items.clear();
+  for (int i = 0; i < count; ++i)
+  {
+    items.push_back(GetItem(first + i));
+  }
+}
+
+void ItemsProvider::RequestItems(int first, int count, const ItemReady&,
+                                 std::vector<std::shared_ptr<ViewModelBase>>& items)
+{
+  GetItems(first, count, items);
+}
+
+void ItemsProvider::Prefetch(int, int)
+{
+}
+
+int ItemsProvider::ItemsChange::MapIndex(int index) const
+{
+  auto end = this->index + count;
+  switch (type)
+  {
+    case Type::Inserted:
+      return index < this->index ? index : index + count;
+
+    case Type::Removed:
+      if (index < this->index)
+      {
+        return index;
+      }
+      return index < end ? -1 : index - count;
+
+    case Type::Moved:
+    {
+      if (index >= this->index && index < end)
+      {
+        return newIndex + index - this->index;
+      }
+      auto remaining = index < this->index ? index : index - count;
+      return remaining < newIndex ? remaining : remaining + count;
+    }
+
+    case Type::Changed:
+      return index;
+  }
+  return index;
+}
+
+int ItemsProvider::ItemsChange::MapViewIndex(int index) const
+{
+  auto end = this->index + count;
+  switch (type)
+  {
+    case Type::Inserted:
+      return this->index < index ? index + count : index;
+
+    case Type::Removed:
+      if (index < this->index)
+      {
+        return index;
+      }
+      return index < end ? this->index : index - count;
+
+    case Type::Moved:
+    {
+      auto remaining = index < this->index ? index : (index < end ? this->index : index - count);
+      return newIndex < remaining ? remaining + count : remaining;
+    }
+
+    case Type::Changed:
+      return index;
+  }
+  return index;
+}
+
+bool ItemsProvider::ItemsChange::Invalidates(int index) const
+{
+  return (Type::Removed == type || Type::Changed == type) &&
+         index >= this->index && index < this->index + count;
+}
+
+int ItemsProvider::AddItemsChangedHandler(const ItemsChangedHandler& handler)
+{
+  auto handlerId = _nextHandlerId++;
+  _itemsChangedHandlers.emplace_back(handlerId, handler);
+  return handlerId;
+}
+
+void ItemsProvider::RemoveItemsChangedHandler(int handlerId)
+{
+  for (auto it = _itemsChangedHandlers.begin(); it != _itemsChangedHandlers.end(); ++it)
+  {
+    if (it->first == handlerId)
+    {
+      _itemsChangedHandlers.erase(it);
+      return;
+    }
+  }
+}
+
+void ItemsProvider::NotifyItemsInserted(int index, int count)
+{
+  Notify(ItemsChange{ItemsChange::Type::Inserted, index, count, index});
+}
+
+void ItemsProvider::NotifyItemsRemoved(int index, int count)
+{
+  Notify(ItemsChange{ItemsChange::Type::Removed, index, count, index});
+}
+
+void ItemsProvider::NotifyItemsMoved(int index, int count, int newIndex)
+{
+  Notify(ItemsChange{ItemsChange::Type::Moved, index, count, newIndex});
+}
+
+void ItemsProvider::NotifyItemsChanged(int index, int count)
+{
+  Notify(ItemsChange{ItemsChange::Type::Changed, index, count, index});
+}
+
+void ItemsProvider::Notify(const ItemsChange& change)
+{
+  if (change.count <= 0)
+  {
+    return;
+  }
+
+  // A handler may remove itself or others while being called
+  auto handlers = _itemsChangedHandlers;
+  for (auto& handler : handlers)
+  {
+    handler.second(change);
+  }
+}
+
 }
@@ -35,6 +35,11 @@ void Layer::PostConstructInternal()
   SetLayerFieldToSharedFromThis();
 }
 
+const std::shared_ptr<ElementArena>& Layer::GetArena() const
+{
+  return _arena;
+}
+
 void Layer::SetOpaqueArea(const boost::optional<Rect4>& opaqueArea)
 {
   _opaqueArea = opaqueArea;
@@ -58,46 +63,12 @@ bool Layer::GetCapturesAllIntersectingTouchInput() const
 void Layer::VisitLowerLayersIf(const std::function<bool(Layer* currentLayer)>& continueDownPredicate,
                                const std::function<void(Layer* lowerLayer)>& action)
 {
-  VisitLowerLayersIfHelper(continueDownPredicate, action, true);
-}
-
-void Layer::VisitLowerLayersIfHelper(const std::function<bool(Layer* currentLayer)>& continueDownPredicate,
-                                     const std::function<void(Layer* lowerLayer)>& action, bool isFirst)
-{
-  if (continueDownPredicate(this))
-  {
-    auto nextLayerBelow = GetLayerBelow();
-    if (nextLayerBelow)
-    {
-      nextLayerBelow->VisitLowerLayersIfHelper(continueDownPredicate, action, false);
-    }
-  }
-
-  // Only perform this on the lower layers, not on the layer that launched this operation
-  if (!isFirst)
-  {
-    action(this);
-  }
+  VisitLowerLayersIf<>(continueDownPredicate, action);
 }
 
 void Layer::VisitHigherLayers(const std::function<void(Layer*)>& action)
 {
-  VisitHigherLayersHelper(action, true);
-}
-
-void Layer::VisitHigherLayersHelper(const std::function<void(Layer*)>& action, bool isFirst)
-{
-  // Only perform this on the higher layers, not on the layer that launched this operation
-  if (!isFirst)
-  {
-    action(this);
-  }
-
-  auto nextLayerAbove = GetLayerAbove();
-  if (nextLayerAbove)
-  {
-    nextLayerAbove->VisitHigherLayersHelper(action, false);
-  }
+  VisitHigherLayers<>(action);
 }
 
 std::shared_ptr<Layer> Layer::GetLayerAbove()
@@ -0,0 +1,296 @@
+#include "libgui/RasterDrawingContext.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace libgui
+{
+
+RasterDrawingContext::RasterDrawingContext(int width, int height)
+  : _width(0),
+    _height(0)
+{
+  Resize(width, height);
+
+  // Converting the clip to pixels only when it changes keeps it out of each fill
+  _clips.SetRegionChangedCallback([this](const IntersectionStack::OptRegion& region) {
+    _isClipped = bool(region);
+    if (region)
+    {
+      _clipPixels = ToPixels(region.get());
+    }
+  });
+}
+
+void RasterDrawingContext::Resize(int width, int height)
+{
+  _width  = std::max(0, width);
+  _height = std::max(0, height);
+  _pixels.assign(size_t(_width) * size_t(_height) * 4, 0);
+}
+
+int RasterDrawingContext::GetWidth() const
+{
+  return _width;
+}
+
+int RasterDrawingContext::GetHeight() const
+{
+  return _height;
+}
+
+void RasterDrawingContext::Clear(const Color& color)
+{
+  for (size_t i = 0; i < _pixels.size(); i += 4)
+  {
+    _pixels[i]     = color.r;
+    _pixels[i + 1] = color.g;
+    _pixels[i + 2] = color.b;
+    _pixels[i + 3] = color.a;
+  }
+}
+
+Color RasterDrawingContext::GetPixel(int x, int y) const
+{
+  if (x < 0 || y < 0 || x >= _width || y >= _height)
+  {
+    return Color{0, 0, 0, 0};
+  }
+  auto pixel = &_pixels[(size_t(y) * size_t(_width) + size_t(x)) * 4];
+  return Color{pixel[0], pixel[1], pixel[2], pixel[3]};
+}
+
+const uint8_t* RasterDrawingContext::GetData() const
+{
+  return _pixels.data();
+}
+
+void RasterDrawingContext::CopyTo(RasterDrawingContext& destination, const Region& region) const
+{
+  if (destination._width != _width || destination._height != _height)
+  {
+    destination.Resize(_width, _height);
+  }
+
+  for (auto& rect : region)
+  {
+    auto pixels = ToPixels(rect);
+    if (pixels.left >= pixels.right)
+    {
+      continue;
+    }
+    for (int y = pixels.top; y < pixels.bottom; ++y)
+    {
+      auto offset = (size_t(y) * size_t(_width) + size_t(pixels.left)) * 4;
+      std::memcpy(&destination._pixels[offset], &_pixels[offset], size_t(pixels.right - pixels.left) * 4);
+    }
+  }
+}
+
+void RasterDrawingContext::WritePam(std::ostream& stream) const
+{
+  stream << "P7\nWIDTH " << _width << "\nHEIGHT " << _height
+         << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+  stream.write(reinterpret_cast<const char*>(_pixels.data()), std::streamsize(_pixels.size()));
+}
+
+uint64_t RasterDrawingContext::GetPixelsWritten() const
+{
+  return _pixelsWritten;
+}
+
+void RasterDrawingContext::ResetPixelsWritten()
+{
+  _pixelsWritten = 0;
+}
+
+void RasterDrawingContext::FillRectangle(const Rect4& rect, const Color& color)
+{
+  Blend(Clipped(rect.Translated(_translation.X, _translation.Y)), color);
+}
+
+void RasterDrawingContext::OutlineRectangle(const Rect4& rect, const Color& color, double lineWidth)
+{
+  // Each edge is drawn inside the rectangle, with the top and bottom edges
+  // covering the corners so that no pixel is blended twice
+  auto width = std::min({lineWidth, (rect.right - rect.left) / 2, (rect.bottom - rect.top) / 2});
+  if (width <= 0)
+  {
+    return;
+  }
+
+  FillRectangle(Rect4(rect.left, rect.top, rect.right, rect.top + width), color);
+  FillRectangle(Rect4(rect.left, rect.bottom - width, rect.right, rect.bottom), color);
+  FillRectangle(Rect4(rect.left, rect.top + width, rect.left + width, rect.bottom - width), color);
+  FillRectangle(Rect4(rect.right - width, rect.top + width, rect.right, rect.bottom - width), color);
+}
+
+void RasterDrawingContext::DrawLine(const Point& from, const Point& to, const Color& color, double lineWidth)
+{
+  auto halfWidth = std::max(lineWidth, 1.0) / 2;
+
+  if (from.X == to.X || from.Y == to.Y)
+  {
+    FillRectangle(Rect4(std::min(from.X, to.X) - halfWidth, std::min(from.Y, to.Y) - halfWidth,
+                        std::max(from.X, to.X) + halfWidth, std::max(from.Y, to.Y) + halfWidth), color);
+    return;
+  }
+
+  // Step one pixel at a time along the longer axis and fill a span across the
+  // line at each step
+  auto dx    = to.X - from.X;
+  auto dy    = to.Y - from.Y;
+  auto steps = int(std::ceil(std::max(std::abs(dx), std::abs(dy))));
+  bool mostlyHorizontal = std::abs(dx) >= std::abs(dy);
+
+  for (int i = 0; i <= steps; ++i)
+  {
+    auto x = from.X + dx * i / steps;
+    auto y = from.Y + dy * i / steps;
+    if (mostlyHorizontal)
+    {
+      FillRectangle(Rect4(x - 0.5, y - halfWidth, x + 0.5, y + halfWidth), color);
+    }
+    else
+    {
+      FillRectangle(Rect4(x - halfWidth, y - 0.5, x + halfWidth, y + 0.5), color);
+    }
+  }
+}
+
+void RasterDrawingContext::Custom(const Rect4& bounds, const CustomDrawing& drawing)
+{
+  auto pixels = Clipped(bounds.Translated(_translation.X, _translation.Y));
+  if (pixels.left < pixels.right && pixels.top < pixels.bottom)
+  {
+    // The drawing is given the area in its own coordinates, since whatever it
+    // draws is translated again
+    drawing(*this, Rect4(pixels.left, pixels.top, pixels.right, pixels.bottom)
+                     .Translated(-_translation.X, -_translation.Y));
+  }
+}
+
+void RasterDrawingContext::PushClip(const Rect4& clip)
+{
+  _clips.PushRegion(clip.Translated(_translation.X, _translation.Y));
+}
+
+void RasterDrawingContext::PopClip()
+{
+  _clips.PopRegion();
+}
+
+void RasterDrawingContext::PushTranslation(const Point& offset)
+{
+  _translations.push_back(_translation);
+  _translation.X += offset.X;
+  _translation.Y += offset.Y;
+}
+
+void RasterDrawingContext::PopTranslation()
+{
+  _translation = _translations.back();
+  _translations.pop_back();
+}
+
+bool RasterDrawingContext::CanCopyArea() const
+{
+  return true;
+}
+
+void RasterDrawingContext::CopyArea(const Rect4& area, const Point& offset)
+{
+  auto pixels = ToPixels(area);
+  auto dx     = int(std::lround(offset.X));
+  auto dy     = int(std::lround(offset.Y));
+
+  // The destination is the part of the area whose source is also in the area
+  auto left   = std::max(pixels.left, pixels.left + dx);
+  auto right  = std::min(pixels.right, pixels.right + dx);
+  auto top    = std::max(pixels.top, pixels.top + dy);
+  auto bottom = std::min(pixels.bottom, pixels.bottom + dy);
+  if (left >= right || top >= bottom)
+  {
+    return;
+  }
+
+  // Rows are copied in the opposite direction to the move so that each source
+  // row is read before it is overwritten
+  auto length = size_t(right - left) * 4;
+  for (int i = 0; i < bottom - top; ++i)
+  {
+    auto y = dy > 0 ? bottom - 1 - i : top + i;
+    auto destination = (size_t(y) * size_t(_width) + size_t(left)) * 4;
+    auto source      = (size_t(y - dy) * size_t(_width) + size_t(left - dx)) * 4;
+    std::memmove(&_pixels[destination], &_pixels[source], length);
+  }
+}
+
+RasterDrawingContext::PixelRect RasterDrawingContext::ToPixels(const Rect4& rect) const
+{
+  // Pixel centers are at half coordinates so rounding finds the covered pixels
+  PixelRect pixels;
+  pixels.left   = std::max(0, int(std::lround(rect.left)));
+  pixels.top    = std::max(0, int(std::lround(rect.top)));
+  pixels.right  = std::min(_width, int(std::lround(rect.right)));
+  pixels.bottom = std::min(_height, int(std::lround(rect.bottom)));
+  return pixels;
+}
+
+RasterDrawingContext::PixelRect RasterDrawingContext::Clipped(const Rect4& rect) const
+{
+  auto pixels = ToPixels(rect);
+
+  if (_isClipped)
+  {
+    pixels.left   = std::max(pixels.left, _clipPixels.left);
+    pixels.top    = std::max(pixels.top, _clipPixels.top);
+    pixels.right  = std::min(pixels.right, _clipPixels.right);
+    pixels.bottom = std::min(pixels.bottom, _clipPixels.bottom);
+  }
+
+  return pixels;
+}
+
+void RasterDrawingContext::Blend(const PixelRect& pixels, const Color& color)
+{
+  if (pixels.left >= pixels.right || pixels.top >= pixels.bottom || color.a == 0)
+  {
+    return;
+  }
+
+  _pixelsWritten += uint64_t(pixels.right - pixels.left) * uint64_t(pixels.bottom - pixels.top);
+
+  for (int y = pixels.top; y < pixels.bottom; ++y)
+  {
+    auto pixel = &_pixels[(size_t(y) * size_t(_width) + size_t(pixels.left)) * 4];
+    auto end   = pixel + size_t(pixels.right - pixels.left) * 4;
+
+    if (color.a == 255)
+    {
+      for (; pixel != end; pixel += 4)
+      {
+        pixel[0] = color.r;
+        pixel[1] = color.g;
+        pixel[2] = color.b;
+        pixel[3] = 255;
+      }
+    }
+    else
+    {
+      // Source over destination with straight alpha, rounding to nearest
+      unsigned alpha   = color.a;
+      unsigned inverse = 255 - alpha;
+      for (; pixel != end; pixel += 4)
+      {
+        pixel[0] = uint8_t((color.r * alpha + pixel[0] * inverse + 127) / 255);
+        pixel[1] = uint8_t((color.g * alpha + pixel[1] * inverse + 127) / 255);
+        pixel[2] = uint8_t((color.b * alpha + pixel[2] * inverse + 127) / 255);
+        pixel[3] = uint8_t(alpha + (pixel[3] * inverse + 127) / 255);
+      }
+    }
+  }
+}
+
+}
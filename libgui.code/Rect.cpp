@@ -191,6 +191,11 @@ void Rect4::ExcludeWith(const Rect4& other)
   }
 }
 
+Rect4 Rect4::Translated(double x, double y) const
+{
+  return Rect4(left + x, top + y, right + x, bottom + y);
+}
+
 double Rect4::Area() const
 {
   return (right - left) * (bottom - top);
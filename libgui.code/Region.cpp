@@ -0,0 +1,377 @@
+#include "libgui/Region.h"
+
+#include <algorithm>
+
+namespace libgui
+{
+
+namespace
+{
+
+bool IsValid(const Rect4& rect)
+{
+  return rect.left < rect.right && rect.top < rect.bottom;
+}
+
+// Returns the index just past the band which begins at the specified index
+size_t BandEnd(const std::vector<Rect4>& rects, size_t begin)
+{
+  auto end = begin + 1;
+  while (end < rects.size() && rects[end].top == rects[begin].top)
+  {
+    ++end;
+  }
+  return end;
+}
+
+// Finds the band of rects which spans the specified top (an empty range if there
+// is none), having first skipped any bands which end before it
+void FindBand(const std::vector<Rect4>& rects, size_t& next, double top,
+              size_t& begin, size_t& end)
+{
+  while (next < rects.size() && rects[next].bottom <= top)
+  {
+    next = BandEnd(rects, next);
+  }
+
+  begin = next;
+  end   = next;
+  if (next < rects.size() && rects[next].top <= top)
+  {
+    end = BandEnd(rects, next);
+  }
+}
+
+// Returns the specified rect as a list of rects without allocating each time
+const std::vector<Rect4>& AsList(const Rect4& rect)
+{
+  static thread_local std::vector<Rect4> list;
+  list.assign(1, rect);
+  return list;
+}
+
+}
+
+Region::Region() = default;
+
+Region::Region(const Rect4& rect)
+{
+  if (IsValid(rect))
+  {
+    _rects.push_back(rect);
+  }
+}
+
+bool Region::IsEmpty() const
+{
+  return _rects.empty();
+}
+
+void Region::Clear()
+{
+  _rects.clear();
+}
+
+void Region::Union(const Rect4& rect)
+{
+  if (!IsValid(rect))
+  {
+    return;
+  }
+  if (_rects.empty())
+  {
+    _rects.push_back(rect);
+    return;
+  }
+
+  // Damage often arrives from top to bottom, in which case the rect can simply
+  // be appended as a new band or merged into the last band
+  auto& last = _rects.back();
+  if (rect.top >= last.bottom)
+  {
+    bool lastBandIsSingleRect = _rects.size() == 1 || _rects[_rects.size() - 2].top != last.top;
+    if (rect.top == last.bottom && rect.left == last.left && rect.right == last.right &&
+        lastBandIsSingleRect)
+    {
+      last.bottom = rect.bottom;
+    }
+    else
+    {
+      _rects.push_back(rect);
+    }
+    return;
+  }
+
+  // Repeatedly redrawing the same area is common, so check for that cheaply
+  for (auto& r : _rects)
+  {
+    if (r.left <= rect.left && r.top <= rect.top && r.right >= rect.right && r.bottom >= rect.bottom)
+    {
+      return;
+    }
+  }
+  Combine(AsList(rect), Operation::Union);
+}
+
+void Region::Union(const Region& other)
+{
+  if (_rects.empty())
+  {
+    _rects = other._rects;
+    return;
+  }
+  if (!other._rects.empty())
+  {
+    Combine(other._rects, Operation::Union);
+  }
+}
+
+void Region::Intersect(const Rect4& rect)
+{
+  if (!IsValid(rect))
+  {
+    _rects.clear();
+    return;
+  }
+  if (!_rects.empty())
+  {
+    Combine(AsList(rect), Operation::Intersect);
+  }
+}
+
+void Region::Intersect(const Region& other)
+{
+  if (!_rects.empty())
+  {
+    Combine(other._rects, Operation::Intersect);
+  }
+}
+
+void Region::Subtract(const Rect4& rect)
+{
+  if (IsValid(rect) && Intersects(rect))
+  {
+    Combine(AsList(rect), Operation::Subtract);
+  }
+}
+
+void Region::Subtract(const Region& other)
+{
+  if (!_rects.empty() && !other._rects.empty())
+  {
+    Combine(other._rects, Operation::Subtract);
+  }
+}
+
+bool Region::Intersects(const Rect4& rect) const
+{
+  for (auto& r : _rects)
+  {
+    if (r.top >= rect.bottom)
+    {
+      break;
+    }
+    if (r.left < rect.right && r.right > rect.left && r.bottom > rect.top)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Region::Contains(const Rect4& rect) const
+{
+  if (!IsValid(rect))
+  {
+    return true;
+  }
+  Region remainder(rect);
+  remainder.Subtract(*this);
+  return remainder.IsEmpty();
+}
+
+Rect4 Region::GetBounds() const
+{
+  if (_rects.empty())
+  {
+    return Rect4();
+  }
+
+  // The bands are sorted vertically but each band has its own horizontal extent
+  Rect4 bounds(_rects.front().left, _rects.front().top, _rects.front().right, _rects.back().bottom);
+  for (auto& r : _rects)
+  {
+    bounds.left  = std::min(bounds.left, r.left);
+    bounds.right = std::max(bounds.right, r.right);
+  }
+  return bounds;
+}
+
+double Region::Area() const
+{
+  double area = 0;
+  for (auto& r : _rects)
+  {
+    area += (r.right - r.left) * (r.bottom - r.top);
+  }
+  return area;
+}
+
+const std::vector<Rect4>& Region::GetRects() const
+{
+  return _rects;
+}
+
+std::vector<Rect4>::const_iterator Region::begin() const
+{
+  return _rects.begin();
+}
+
+std::vector<Rect4>::const_iterator Region::end() const
+{
+  return _rects.end();
+}
+
+bool Region::operator==(const Region& other) const
+{
+  // The banded form is canonical so equal regions have identical rectangles
+  return _rects == other._rects;
+}
+
+bool Region::operator!=(const Region& other) const
+{
+  return !operator==(other);
+}
+
+void Region::Combine(const std::vector<Rect4>& other, Operation operation)
+{
+  // The working storage is reused between calls to avoid allocating each time
+  static thread_local std::vector<double> edges;
+  static thread_local std::vector<double> spanEdges;
+  static thread_local std::vector<Rect4>  result;
+
+  // Every top and bottom edge of either region starts a new band of the result
+  edges.clear();
+  for (auto& r : _rects)
+  {
+    edges.push_back(r.top);
+    edges.push_back(r.bottom);
+  }
+  for (auto& r : other)
+  {
+    edges.push_back(r.top);
+    edges.push_back(r.bottom);
+  }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  result.clear();
+
+  size_t nextA = 0;
+  size_t nextB = 0;
+  size_t previousBand = 0;
+  bool   hasPreviousBand = false;
+
+  for (size_t e = 0; e + 1 < edges.size(); ++e)
+  {
+    auto top    = edges[e];
+    auto bottom = edges[e + 1];
+
+    size_t beginA, endA, beginB, endB;
+    FindBand(_rects, nextA, top, beginA, endA);
+    FindBand(other, nextB, top, beginB, endB);
+
+    // Combine the horizontal spans of both bands in the same way
+    spanEdges.clear();
+    for (auto i = beginA; i < endA; ++i)
+    {
+      spanEdges.push_back(_rects[i].left);
+      spanEdges.push_back(_rects[i].right);
+    }
+    for (auto i = beginB; i < endB; ++i)
+    {
+      spanEdges.push_back(other[i].left);
+      spanEdges.push_back(other[i].right);
+    }
+    std::sort(spanEdges.begin(), spanEdges.end());
+    spanEdges.erase(std::unique(spanEdges.begin(), spanEdges.end()), spanEdges.end());
+
+    auto bandBegin = result.size();
+    auto a = beginA;
+    auto b = beginB;
+    for (size_t s = 0; s + 1 < spanEdges.size(); ++s)
+    {
+      auto left  = spanEdges[s];
+      auto right = spanEdges[s + 1];
+
+      while (a < endA && _rects[a].right <= left)
+      {
+        ++a;
+      }
+      while (b < endB && other[b].right <= left)
+      {
+        ++b;
+      }
+      bool inA = a < endA && _rects[a].left <= left;
+      bool inB = b < endB && other[b].left <= left;
+
+      bool included = false;
+      switch (operation)
+      {
+        case Operation::Union:
+          included = inA || inB;
+          break;
+        case Operation::Intersect:
+          included = inA && inB;
+          break;
+        case Operation::Subtract:
+          included = inA && !inB;
+          break;
+      }
+
+      if (included)
+      {
+        if (result.size() > bandBegin && result.back().right == left)
+        {
+          result.back().right = right;
+        }
+        else
+        {
+          result.emplace_back(left, top, right, bottom);
+        }
+      }
+    }
+
+    if (result.size() == bandBegin)
+    {
+      continue;
+    }
+
+    // Merge with the band above when it touches this one and has the same spans
+    auto bandSize = result.size() - bandBegin;
+    if (hasPreviousBand &&
+        result[previousBand].bottom == top &&
+        bandBegin - previousBand == bandSize &&
+        std::equal(result.begin() + bandBegin, result.end(), result.begin() + previousBand,
+                   [](const Rect4& current, const Rect4& previous) {
+                     return current.left == previous.left && current.right == previous.right;
+                   }))
+    {
+      for (auto i = previousBand; i < bandBegin; ++i)
+      {
+        result[i].bottom = bottom;
+      }
+      result.resize(bandBegin);
+    }
+    else
+    {
+      previousBand    = bandBegin;
+      hasPreviousBand = true;
+    }
+  }
+
+  // Keep the previous storage for next time
+  _rects.swap(result);
+}
+
+}
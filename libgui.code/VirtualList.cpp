@@ -0,0 +1,623 @@
+#include "libgui/VirtualList.h"
+#include "libgui/ElementManager.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace libgui
+{
+VirtualList::VirtualList(Element::Dependencies elementDependencies)
+  : Element(elementDependencies, "VirtualList")
+{
+  SetClipToBounds(true);
+}
+
+void VirtualList::Arrange()
+{
+  // First arrange the element itself
+  Element::Arrange();
+
+  if (_estimatedItemHeight <= 0 || !_itemsProvider || !_cellCreateCallback)
+  {
+    // Invalid state
+    _cellsWereArranged = false;
+    return;
+  }
+
+  if (!_itemReady)
+  {
+    // Loaded items are handed back on whichever thread loaded them, so the list
+    // is updated from the ElementManager's thread
+    std::weak_ptr<VirtualList> weakList = std::static_pointer_cast<VirtualList>(shared_from_this());
+    std::weak_ptr<ElementManager> weakElementManager = GetElementManager()->shared_from_this();
+    _itemReady = [weakList, weakElementManager](int index) {
+      if (auto elementManager = weakElementManager.lock())
+      {
+        elementManager->Post([weakList, index] {
+          if (auto list = weakList.lock())
+          {
+            list->OnItemReady(index);
+          }
+        });
+      }
+    };
+  }
+
+  auto totalCount = _itemsProvider->GetTotalItems();
+  SyncItemHeights(totalCount);
+
+  if (_measuredWidth != GetWidth())
+  {
+    // Heights measured at another width are kept as estimates until the items are
+    // measured again
+    _itemIsMeasured.assign(_itemIsMeasured.size(), false);
+    _measuredWidth = GetWidth();
+  }
+
+  LimitScrollTop();
+
+  // After a scroll or changes to the items or their heights, the cells which still
+  // show the same item are only moved and just those which now show another item
+  // are arranged.  Any other update arranges every cell, as Grid does.
+  bool scrolled  = _arrangedScrollTop != _scrollTop;
+  bool keepCells = _cellsWereArranged && _arrangedBounds == GetBounds() && (scrolled || _itemsChanged);
+  if (!keepCells)
+  {
+    for (auto cell : _cells)
+    {
+      cell->SetItemIndex(-1);
+    }
+  }
+
+  // Measuring the items which come into view can change how many of them fit, so
+  // repeat until the heights of all the items in view are known
+  bool heightsChanged = true;
+  while (heightsChanged)
+  {
+    auto first = 0;
+    auto end   = 0;
+    if (totalCount > 0)
+    {
+      first = _itemHeights.FindIndex(_scrollTop);
+      end   = first;
+
+      auto top    = _itemHeights.GetPrefixSum(first);
+      auto bottom = _scrollTop + GetHeight();
+      while (end < totalCount && top < bottom)
+      {
+        top += _itemHeights.Get(end);
+        ++end;
+      }
+    }
+
+    BindCells(first, end);
+    heightsChanged = FetchAndMeasureReboundItems(totalCount);
+    LimitScrollTop();
+  }
+
+  bool canTranslate = GetElementManager()->CanTranslate();
+  for (auto cell : _visibleCells)
+  {
+    if (cell->GetNeedsArrange())
+    {
+      continue;
+    }
+
+    auto index  = cell->GetItemIndex();
+    auto top    = GetTop() + GetItemTop(index) - _scrollTop;
+    auto height = std::round(top + _itemHeights.Get(index)) - std::round(top);
+    if (cell->GetHeight() != height || !canTranslate)
+    {
+      // Still the same item, but its height has changed or the backend can't draw
+      // it translated
+      cell->SetItem(cell->GetViewModel());
+      cell->InvalidateArrange();
+    }
+    else
+    {
+      cell->SetTranslation(Point{0, std::round(top) - cell->GetTop()});
+    }
+  }
+
+  _cellsWereArranged = true;
+  _arrangedBounds    = GetBounds();
+  _arrangedScrollTop = _scrollTop;
+  _itemsChanged      = false;
+
+  NotifyThumbIfChanged();
+}
+
+double VirtualList::GetCurrentOffsetPercent()
+{
+  auto contentHeight = GetContentHeight();
+  return contentHeight > 0 ? _scrollTop / contentHeight : 0.0;
+}
+
+double VirtualList::GetThumbSizePercent()
+{
+  auto contentHeight = GetContentHeight();
+  return contentHeight > 0 ? std::min(1.0, GetHeight() / contentHeight) : 1.0;
+}
+
+void VirtualList::WhenThumbDataChanges(const std::function<void()>& handler)
+{
+  _thumbDataChangeCallback = handler;
+}
+
+void VirtualList::MoveToOffsetPercent(double offsetPercent, bool notify_thumb)
+{
+  _scrollTop = offsetPercent * GetContentHeight();
+
+  if (notify_thumb)
+  {
+    if (_thumbDataChangeCallback)
+    {
+      _thumbDataChangeCallback();
+    }
+  }
+}
+
+void VirtualList::ScrollTo(int index)
+{
+  if (index < 0 || index >= _itemHeights.GetSize())
+  {
+    return;
+  }
+
+  _scrollTop = GetItemTop(index);
+  LimitScrollTop();
+
+  if (_thumbDataChangeCallback)
+  {
+    _thumbDataChangeCallback();
+  }
+}
+
+void VirtualList::ScrollTo(std::shared_ptr<ViewModelBase> item)
+{
+  if (!CanScroll()) return; // All items are visible
+
+  ScrollTo(_itemsProvider->GetItemIndex(item));
+}
+
+bool VirtualList::CanScroll()
+{
+  if (!_itemsProvider) return false; // No content
+
+  return GetContentHeight() > GetHeight();
+}
+
+double VirtualList::GetScrollTop() const
+{
+  return _scrollTop;
+}
+
+void VirtualList::SetEstimatedItemHeight(double estimatedItemHeight)
+{
+  _estimatedItemHeight = estimatedItemHeight;
+  for (int i = 0; i < _itemHeights.GetSize(); ++i)
+  {
+    if (!_itemIsMeasured[i])
+    {
+      _itemHeights.Set(i, estimatedItemHeight);
+    }
+  }
+}
+
+double VirtualList::GetEstimatedItemHeight() const
+{
+  return _estimatedItemHeight;
+}
+
+void VirtualList::SetMeasureCallback(const std::function<double(const std::shared_ptr<ViewModelBase>& item, double width)>& measureCallback)
+{
+  _measureCallback = measureCallback;
+}
+
+void VirtualList::SetItemHeight(int index, double height)
+{
+  auto oldHeight = _itemHeights.Get(index);
+  _itemHeights.Set(index, height);
+  _itemIsMeasured[index] = true;
+
+  // Keep the rows in view where they are when a row which starts above them
+  // changes height, as when rows are measured
+  if (GetItemTop(index) < _scrollTop)
+  {
+    _scrollTop         += height - oldHeight;
+    _arrangedScrollTop += height - oldHeight;
+  }
+
+  _itemsChanged = true;
+  InvalidateArrange();
+}
+
+double VirtualList::GetItemHeight(int index)
+{
+  return _itemHeights.Get(index);
+}
+
+double VirtualList::GetItemTop(int index)
+{
+  return _itemHeights.GetPrefixSum(index);
+}
+
+double VirtualList::GetContentHeight()
+{
+  return _itemHeights.GetTotal();
+}
+
+std::shared_ptr<ItemsProvider> VirtualList::GetItemsProvider() const
+{
+  return _itemsProvider;
+}
+
+void VirtualList::SetItemsProvider(std::shared_ptr<ItemsProvider> itemsProvider)
+{
+  if (_itemsProvider)
+  {
+    _itemsProvider->RemoveItemsChangedHandler(_itemsChangedHandlerId);
+  }
+
+  _itemsProvider     = itemsProvider;
+  _cellsWereArranged = false;
+  _itemHeights.Assign(0, 0.0);
+  _itemIsMeasured.clear();
+
+  if (_itemsProvider)
+  {
+    std::weak_ptr<VirtualList> weakList = std::static_pointer_cast<VirtualList>(shared_from_this());
+    _itemsChangedHandlerId = _itemsProvider->AddItemsChangedHandler(
+      [weakList](const ItemsProvider::ItemsChange& change) {
+        if (auto list = weakList.lock())
+        {
+          list->OnItemsChanged(change);
+        }
+      });
+  }
+}
+
+void VirtualList::SetCellCreateCallback(const std::function<void(std::shared_ptr<Element>)>& cellCreateCallback)
+{
+  _cellCreateCallback = cellCreateCallback;
+}
+
+VirtualList::Cell::Cell(Element::Dependencies elementDependencies)
+  : Element(elementDependencies, "VirtualList::Cell"),
+    _list(std::dynamic_pointer_cast<VirtualList>(elementDependencies.parent))
+{
+  // What the descendents show depends on the item, so when a cell is updated
+  // because its item has been loaded they are all rearranged
+  SetUpdateRearrangesDescendants(true);
+}
+
+void VirtualList::Cell::PrepareViewModel()
+{
+  if (auto list = _list.lock())
+  {
+    if (list->_itemsProvider)
+    {
+      if (_hasItem)
+      {
+        // Already fetched along with the other cells' items
+        _hasItem = false;
+      }
+      else if (_itemIndex >= 0 && _itemIndex < list->_itemsProvider->GetTotalItems())
+      {
+        auto& items = list->_fetchedItems;
+        list->_itemsProvider->RequestItems(_itemIndex, 1, list->_itemReady, items);
+        SetViewModel(items.empty() ? nullptr : items.front());
+        items.clear();
+      }
+      else
+      {
+        SetViewModel(nullptr);
+      }
+    }
+  }
+}
+
+void VirtualList::Cell::Arrange()
+{
+  if (auto list = _list.lock())
+  {
+    SetIsVisible(GetViewModel() != nullptr);
+
+    if (_itemIndex >= 0 && _itemIndex < list->_itemHeights.GetSize())
+    {
+      auto top = list->GetTop() + list->GetItemTop(_itemIndex) - list->_scrollTop;
+
+      // Snap to pixel boundaries
+      SetLeft(std::round(list->GetLeft()));
+      SetRight(std::round(list->GetRight()));
+      SetTop(std::round(top));
+      SetBottom(std::round(top + list->_itemHeights.Get(_itemIndex)));
+    }
+
+    // Any translation which moved the cell since it was last arranged is replaced
+    // by the new arrangement
+    SetTranslation(Point{0, 0});
+  }
+}
+
+int VirtualList::Cell::GetItemIndex() const
+{
+  return _itemIndex;
+}
+
+void VirtualList::Cell::SetItemIndex(int itemIndex)
+{
+  _itemIndex = itemIndex;
+}
+
+void VirtualList::Cell::SetItem(std::shared_ptr<ViewModelBase> item)
+{
+  SetViewModel(std::move(item));
+  _hasItem = true;
+}
+
+void VirtualList::SyncItemHeights(int totalCount)
+{
+  if (_itemHeights.GetSize() != totalCount)
+  {
+    _itemHeights.Assign(totalCount, _estimatedItemHeight);
+    _itemIsMeasured.assign(totalCount, false);
+    _cellsWereArranged = false;
+  }
+}
+
+void VirtualList::LimitScrollTop()
+{
+  _scrollTop = std::max(0.0, std::min(_scrollTop, GetContentHeight() - GetHeight()));
+}
+
+void VirtualList::BindCells(int first, int end)
+{
+  _visibleCells.assign(end - first, nullptr);
+  _freeCells.clear();
+  for (auto cell : _cells)
+  {
+    auto index = cell->GetItemIndex();
+    if (index >= first && index < end && !_visibleCells[index - first])
+    {
+      _visibleCells[index - first] = cell;
+    }
+    else
+    {
+      _freeCells.push_back(cell);
+    }
+  }
+
+  size_t nextFreeCell = 0;
+  for (auto index = first; index < end; ++index)
+  {
+    auto& cell = _visibleCells[index - first];
+    if (cell)
+    {
+      continue;
+    }
+
+    if (nextFreeCell < _freeCells.size())
+    {
+      cell = _freeCells[nextFreeCell++];
+    }
+    else
+    {
+      auto cellContainer = this->CreateChild<Cell>();
+      _cells.push_back(cellContainer.get());
+      _cellCreateCallback(cellContainer);
+      cellContainer->UpdateAfterAdd();
+      cell = cellContainer.get();
+    }
+
+    cell->SetItemIndex(index);
+    cell->InvalidateArrange();
+    _reboundCells.push_back(cell);
+  }
+
+  // Hide the cells which aren't needed
+  for (; nextFreeCell < _freeCells.size(); ++nextFreeCell)
+  {
+    auto cell = _freeCells[nextFreeCell];
+    if (cell->GetItemIndex() != -1 || cell->GetViewModel())
+    {
+      cell->SetItemIndex(-1);
+      cell->SetItem(nullptr);
+      cell->InvalidateArrange();
+    }
+  }
+}
+
+bool VirtualList::FetchAndMeasureReboundItems(int totalCount)
+{
+  if (_reboundCells.empty())
+  {
+    return false;
+  }
+
+  // The rebound cells show consecutive items (after a scroll, the rows which came
+  // into view), so one range covers them all
+  auto first = totalCount;
+  auto end   = 0;
+  for (auto cell : _reboundCells)
+  {
+    first = std::min(first, cell->GetItemIndex());
+    end   = std::max(end, cell->GetItemIndex() + 1);
+  }
+
+  _fetchedItems.clear();
+  _itemsProvider->RequestItems(first, end - first, _itemReady, _fetchedItems);
+
+  bool heightsChanged = false;
+  for (auto cell : _reboundCells)
+  {
+    auto index  = cell->GetItemIndex();
+    auto offset = index - first;
+    auto item   = offset < int(_fetchedItems.size()) ? _fetchedItems[offset] : nullptr;
+    cell->SetItem(item);
+
+    if (_measureCallback && item && !_itemIsMeasured[index])
+    {
+      _itemIsMeasured[index] = true;
+
+      auto height    = _measureCallback(item, GetWidth());
+      auto oldHeight = _itemHeights.Get(index);
+      if (height != oldHeight)
+      {
+        // An item which starts above the view, such as one scrolled partly into view
+        // from above, grows upwards so that the items below it stay where they are.
+        // An item at the top of the view (as after ScrollTo) keeps its top there.
+        if (GetItemTop(index) < _scrollTop)
+        {
+          _scrollTop         += height - oldHeight;
+          _arrangedScrollTop += height - oldHeight;
+        }
+
+        _itemHeights.Set(index, height);
+        heightsChanged = true;
+      }
+    }
+  }
+
+  _fetchedItems.clear();
+  _reboundCells.clear();
+  return heightsChanged;
+}
+
+void VirtualList::NotifyThumbIfChanged()
+{
+  auto contentHeight = GetContentHeight();
+  if (_notifiedContentHeight != contentHeight || _notifiedHeight != GetHeight())
+  {
+    _notifiedContentHeight = contentHeight;
+    _notifiedHeight        = GetHeight();
+
+    // Notify that the thumb size should be recalculated
+    if (_thumbDataChangeCallback)
+    {
+      _thumbDataChangeCallback();
+    }
+  }
+}
+
+void VirtualList::OnItemReady(int index)
+{
+  for (auto cell : _cells)
+  {
+    if (cell->GetItemIndex() == index)
+    {
+      if (_measureCallback)
+      {
+        // The loaded item may be a different height from its placeholder, so it is
+        // measured again and the rows after it rearranged
+        _itemIsMeasured[index] = false;
+        cell->SetItemIndex(-1);
+        _itemsChanged = true;
+        UpdateAfterModify();
+      }
+      else
+      {
+        cell->UpdateAfterModify();
+      }
+      return;
+    }
+  }
+}
+
+void VirtualList::OnItemsChanged(const ItemsProvider::ItemsChange& change)
+{
+  InvalidateArrange();
+  if (!_cellsWereArranged)
+  {
+    // The heights are set up and every cell is bound when the list is next arranged
+    return;
+  }
+
+  auto begin = change.index;
+  auto end   = change.index + change.count;
+  auto size  = _itemHeights.GetSize();
+  bool inRange = ItemsProvider::ItemsChange::Type::Inserted == change.type ? begin <= size :
+                 end <= size && change.newIndex + change.count <= size;
+  if (begin < 0 || !inRange)
+  {
+    // The items have changed without notifications before, so start again
+    _cellsWereArranged = false;
+    return;
+  }
+
+  // Remember where the view is relative to the first item in it
+  auto anchor       = size > 0 ? _itemHeights.FindIndex(_scrollTop) : 0;
+  auto anchorOffset = _scrollTop - GetItemTop(anchor);
+  switch (change.type)
+  {
+    case ItemsProvider::ItemsChange::Type::Inserted:
+      _itemHeights.Insert(begin, change.count, _estimatedItemHeight);
+      _itemIsMeasured.insert(_itemIsMeasured.begin() + begin, change.count, false);
+      break;
+
+    case ItemsProvider::ItemsChange::Type::Removed:
+      _itemHeights.Remove(begin, change.count);
+      _itemIsMeasured.erase(_itemIsMeasured.begin() + begin, _itemIsMeasured.begin() + end);
+      break;
+
+    case ItemsProvider::ItemsChange::Type::Moved:
+    {
+      _itemHeights.Move(begin, change.count, change.newIndex);
+      auto measured = _itemIsMeasured.begin();
+      if (change.newIndex < begin)
+      {
+        std::rotate(measured + change.newIndex, measured + begin, measured + end);
+      }
+      else
+      {
+        std::rotate(measured + begin, measured + end, measured + change.newIndex + change.count);
+      }
+      break;
+    }
+
+    case ItemsProvider::ItemsChange::Type::Changed:
+      // Measured again when next shown
+      std::fill(_itemIsMeasured.begin() + begin, _itemIsMeasured.begin() + end, false);
+      break;
+  }
+
+  // Keep the view where it was
+  auto newAnchor = change.MapViewIndex(anchor);
+  if (newAnchor < _itemHeights.GetSize())
+  {
+    _scrollTop = GetItemTop(newAnchor) + (change.MapIndex(anchor) == newAnchor ? anchorOffset : 0.0);
+  }
+  else
+  {
+    _scrollTop = GetContentHeight();
+  }
+  _arrangedScrollTop = _scrollTop;
+
+  // Renumber the cells' items, so that the next arrange can tell which cells still
+  // show the right item
+  for (auto cell : _cells)
+  {
+    auto index = cell->GetItemIndex();
+    cell->SetItemIndex(index >= 0 && !change.Invalidates(index) ? change.MapIndex(index) : -1);
+  }
+
+  _itemsChanged = true;
+}
+
+void VirtualList::OnElementIsBeingRemoved()
+{
+  // Release anything held in a lambda capture
+  _cellCreateCallback = nullptr;
+  _measureCallback    = nullptr;
+  _itemReady          = nullptr;
+
+  if (_itemsProvider)
+  {
+    _itemsProvider->RemoveItemsChangedHandler(_itemsChangedHandlerId);
+    _itemsChangedHandlerId = -1;
+  }
+
+  _cells.clear();
+}
+
+}
@@ -0,0 +1,175 @@
+#include "libgui/WorkStealingPool.h"
+
+namespace libgui
+{
+
+namespace
+{
+
+// The pool whose worker is running on this thread, and the worker's queue
+thread_local const WorkStealingPool* currentPool       = nullptr;
+thread_local size_t                  currentQueueIndex = 0;
+
+}
+
+WorkStealingPool::WorkStealingPool(size_t workerCount)
+{
+  for (size_t i = 0; i <= workerCount; ++i)
+  {
+    _queues.push_back(std::make_unique<Queue>());
+  }
+  for (size_t i = 1; i <= workerCount; ++i)
+  {
+    _workers.emplace_back([this, i] { WorkerLoop(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(_wakeMutex);
+    _stopping = true;
+  }
+  _wake.notify_all();
+
+  for (auto& worker : _workers)
+  {
+    worker.join();
+  }
+}
+
+size_t WorkStealingPool::GetWorkerCount() const
+{
+  return _workers.size();
+}
+
+void WorkStealingPool::Run(const std::vector<std::function<void()>>& tasks)
+{
+  if (tasks.empty())
+  {
+    return;
+  }
+
+  Batch batch;
+  batch.remaining = tasks.size();
+
+  // The tasks are counted before they are queued so that the count never
+  // drops below zero when they are taken
+  {
+    std::lock_guard<std::mutex> lock(_wakeMutex);
+    _queuedTasks += tasks.size();
+  }
+
+  auto queueIndex = GetQueueIndex();
+  {
+    // Queued in reverse so that the owner takes them in their original order
+    auto& queue = *_queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    for (auto it = tasks.rbegin(); it != tasks.rend(); ++it)
+    {
+      queue.tasks.push_back(Task{&*it, &batch});
+    }
+  }
+  _wake.notify_all();
+
+  // Help until the whole batch is done.  Other batches' tasks may be run here
+  // too, which is fine because none of them wait on this one.
+  while (batch.remaining > 0)
+  {
+    Task task;
+    if (TryTakeTask(queueIndex, task))
+    {
+      RunTask(task);
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  if (batch.exception)
+  {
+    std::rethrow_exception(batch.exception);
+  }
+}
+
+size_t WorkStealingPool::GetQueueIndex() const
+{
+  return currentPool == this ? currentQueueIndex : 0;
+}
+
+bool WorkStealingPool::TryTakeTask(size_t queueIndex, Task& task)
+{
+  // The newest task of our own queue is the one most likely to be in cache
+  {
+    auto& queue = *_queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty())
+    {
+      task = queue.tasks.back();
+      queue.tasks.pop_back();
+      --_queuedTasks;
+      return true;
+    }
+  }
+
+  // Otherwise steal the oldest task of another queue, which tends to be the largest
+  for (size_t i = 1; i < _queues.size(); ++i)
+  {
+    auto& queue = *_queues[(queueIndex + i) % _queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty())
+    {
+      task = queue.tasks.front();
+      queue.tasks.pop_front();
+      --_queuedTasks;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void WorkStealingPool::RunTask(const Task& task)
+{
+  try
+  {
+    (*task.work)();
+  }
+  catch (...)
+  {
+    std::lock_guard<std::mutex> lock(task.batch->exceptionMutex);
+    if (!task.batch->exception)
+    {
+      task.batch->exception = std::current_exception();
+    }
+  }
+
+  // The batch may be destroyed as soon as this reaches zero
+  --task.batch->remaining;
+}
+
+void WorkStealingPool::WorkerLoop(size_t queueIndex)
+{
+  currentPool       = this;
+  currentQueueIndex = queueIndex;
+
+  while (true)
+  {
+    Task task;
+    if (TryTakeTask(queueIndex, task))
+    {
+      RunTask(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(_wakeMutex);
+    _wake.wait(lock, [this] { return _stopping || _queuedTasks > 0; });
+    if (_stopping)
+    {
+      return;
+    }
+  }
+}
+
+}
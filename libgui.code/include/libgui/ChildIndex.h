@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Point.h"
+#include "Rect.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace libgui
+{
+
+class Element;
+
+/**
+ * ChildIndex
+ *
+ * A uniform bucket grid over the children of a single element, used by the
+ * default child lookup methods of Element (FindLastChild, VisitChildren with a
+ * region, VisitLastChildren and VisitChildrenWithTotalBounds) when the element
+ * has opted in via Element::SetUsesChildIndex.
+ *
+ * The index is rebuilt lazily on the first query after it has been marked
+ * dirty, which happens whenever a child is added or removed.  A child which is
+ * arranged or moved is only marked as moved, and the next query moves just its
+ * entry between the buckets it left and joined, unless it moved outside the
+ * area the buckets cover.  Each bucket keeps its entries in sibling order so
+ * that queries can preserve the drawing order (and therefore the
+ * last-child-first hit testing order).
+ */
+class ChildIndex
+{
+public:
+  void MarkDirty();
+  bool IsDirty() const;
+
+  // Updates the entry of just the child when the index is next queried
+  void MarkChildMoved(Element* child);
+
+  // Fills result with the candidate children that may contain the specified
+  // point, ordered first to last.  The candidates still need to be hit tested.
+  void QueryPoint(Element* parent, const Point& point, std::vector<Element*>& result);
+
+  // Fills result with the candidate children whose bounds or total bounds may
+  // intersect the specified region, ordered first to last.  The candidates
+  // still need to be hit tested.
+  void QueryRegion(Element* parent, const Rect4& region, std::vector<Element*>& result);
+
+private:
+  struct Entry
+  {
+    Element* element;
+    Rect4    extent;
+  };
+
+  std::vector<Entry>            _entries;
+  std::vector<std::vector<int>> _buckets;
+  std::vector<unsigned int>     _visitedStamps;
+  std::vector<int>              _queryIndexes;
+  std::vector<Element*>         _movedChildren;
+
+  std::unordered_map<Element*, int> _entryIndexes;
+
+  Rect4        _extent;
+  int          _columns      = 0;
+  int          _rows         = 0;
+  double       _bucketWidth  = 0;
+  double       _bucketHeight = 0;
+  unsigned int _stamp        = 0;
+  bool         _isDirty      = true;
+
+  void RebuildIfNeeded(Element* parent);
+  void UpdateMovedChildren();
+
+  int ColumnAt(double x) const;
+  int RowAt(double y) const;
+};
+
+}
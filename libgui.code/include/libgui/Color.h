@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+namespace libgui
+{
+
+// An 8-bit per channel color with straight (non-premultiplied) alpha
+struct Color
+{
+  uint8_t r = 0;
+  uint8_t g = 0;
+  uint8_t b = 0;
+  uint8_t a = 255;
+
+  bool operator==(const Color& other) const
+  {
+    return r == other.r && g == other.g && b == other.b && a == other.a;
+  }
+
+  bool operator!=(const Color& other) const
+  {
+    return !(*this == other);
+  }
+};
+
+}
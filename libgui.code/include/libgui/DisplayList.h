@@ -0,0 +1,90 @@
+#pragma once
+
+#include "DrawingContext.h"
+
+#include <boost/optional.hpp>
+#include <variant>
+#include <vector>
+
+namespace libgui
+{
+
+/**
+ * DisplayList
+ *
+ * A DrawingContext which records the commands drawn into it so that they can
+ * be replayed later, any number of times, without running the code which drew
+ * them again.
+ */
+class DisplayList: public DrawingContext
+{
+public:
+  void FillRectangle(const Rect4& rect, const Color& color) override;
+  void OutlineRectangle(const Rect4& rect, const Color& color, double lineWidth) override;
+  void DrawLine(const Point& from, const Point& to, const Color& color, double lineWidth) override;
+  void Custom(const Rect4& bounds, const CustomDrawing& drawing) override;
+  void PushClip(const Rect4& clip) override;
+  void PopClip() override;
+  void PushTranslation(const Point& offset) override;
+  void PopTranslation() override;
+
+  // Draws the recorded commands into the target.  If an update area is specified,
+  // commands which fall entirely outside of it are skipped.
+  void Replay(DrawingContext& target, const boost::optional<Rect4>& updateArea) const;
+
+  void Clear();
+  bool IsEmpty() const;
+  size_t GetCommandCount() const;
+
+private:
+  struct Fill
+  {
+    Rect4 rect;
+    Color color;
+  };
+
+  struct Outline
+  {
+    Rect4  rect;
+    Color  color;
+    double lineWidth;
+  };
+
+  struct Line
+  {
+    Point  from;
+    Point  to;
+    Color  color;
+    double lineWidth;
+  };
+
+  struct CustomCommand
+  {
+    Rect4         bounds;
+    CustomDrawing drawing;
+  };
+
+  struct Clip
+  {
+    Rect4 clip;
+  };
+
+  struct Unclip
+  {
+  };
+
+  struct Translate
+  {
+    Point offset;
+  };
+
+  struct Untranslate
+  {
+  };
+
+  using Command = std::variant<Fill, Outline, Line, CustomCommand, Clip, Unclip, Translate, Untranslate>;
+
+  std::vector<Command> _commands;
+};
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Color.h"
+#include "Point.h"
+#include "Rect.h"
+
+#include <functional>
+
+namespace libgui
+{
+
+/**
+ * DrawingContext
+ *
+ * The drawing interface used by elements which draw through
+ * Element::SetRecordedDrawCallback.  Those elements record their drawing into a
+ * DisplayList (which is itself a DrawingContext) and the list is then replayed
+ * into the DrawingContext given to ElementManager::SetDrawingContext, which is
+ * implemented by the rendering backend.
+ *
+ * Drawing which has no command of its own (such as text) can be recorded with
+ * Custom.  The function receives the backend's DrawingContext and the area
+ * being redrawn, so expensive preparation like text layout can be done once
+ * when recording and captured by the function.
+ */
+class DrawingContext
+{
+public:
+  using CustomDrawing = std::function<void(DrawingContext& target, const Rect4& updateArea)>;
+
+  virtual ~DrawingContext() = default;
+
+  virtual void FillRectangle(const Rect4& rect, const Color& color) = 0;
+
+  // Outlines the rectangle with lines of the specified width drawn inside its edges
+  virtual void OutlineRectangle(const Rect4& rect, const Color& color, double lineWidth) = 0;
+
+  virtual void DrawLine(const Point& from, const Point& to, const Color& color, double lineWidth) = 0;
+
+  // Backend specific drawing which is confined to the specified bounds
+  virtual void Custom(const Rect4& bounds, const CustomDrawing& drawing) = 0;
+
+  // Clipping works like ElementManager::PushClip and PopClip: each new clip
+  // rectangle further reduces the area which can be drawn
+  virtual void PushClip(const Rect4& clip) = 0;
+  virtual void PopClip() = 0;
+
+  // Translation works like ElementManager::PushTranslation and PopTranslation:
+  // each new offset is added to the current one and moves everything drawn
+  // afterwards, including clips
+  virtual void PushTranslation(const Point& offset) = 0;
+  virtual void PopTranslation() = 0;
+
+  // Backends which can move pixels that have already been drawn say so here, so
+  // that scrolled elements only need to draw the area which they expose (see
+  // ElementManager::CopyArea)
+  virtual bool CanCopyArea() const
+  {
+    return false;
+  }
+
+  // Moves the pixels within the area (in window coordinates, regardless of the
+  // current clip and translation) by the offset.  Pixels moved outside the area
+  // are discarded and those exposed within it are left as they were.
+  virtual void CopyArea(const Rect4& /*area*/, const Point& /*offset*/)
+  {
+  }
+};
+
+}
@@ -1,17 +1,24 @@
 #pragma once
 
 #include "CallPostConstructIfPresent.h"
+#include "ChildIndex.h"
+#include "DisplayList.h"
+#include "ElementArena.h"
 #include "Location.h"
 #include "Point.h"
 #include "Rect.h"
+#include "Region.h"
+#include "TraversalStack.h"
+#include "TreeLink.h"
 #include "Types.h"
 #include "ViewModelBase.h"
 
 #include <boost/optional.hpp>
-#include <deque>
+#include <cstdint>
 #include <memory>
 #include <string_view>
 #include <type_traits>
+#include <vector>
 
 namespace libgui
 {
@@ -22,6 +29,7 @@ namespace libgui
 
 class ElementManager;
 class Element;
+class WorkStealingPool;
 class Layer;
 class LayerDependencies;
 
@@ -56,6 +64,7 @@ struct FuzzyHitQuery
 class Element: public std::enable_shared_from_this<Element>
 {
   friend class ElementManager;
+  friend class ChildIndex;
 
 public:
   class Dependencies
@@ -110,7 +119,17 @@ public:
   template<class ChildType, class... ChildArgs>
   std::shared_ptr<ChildType> CreateChild(ChildArgs&& ... args)
   {
-    auto child = std::make_shared<ChildType>(Dependencies{shared_from_this()}, std::forward<ChildArgs>(args)...);
+    // Children of a layer which has an arena are allocated from it
+    std::shared_ptr<ChildType> child;
+    if (auto arena = GetLayerArena())
+    {
+      child = std::allocate_shared<ChildType>(ArenaAllocator<ChildType>(std::move(arena)),
+                                              Dependencies{shared_from_this()}, std::forward<ChildArgs>(args)...);
+    }
+    else
+    {
+      child = std::make_shared<ChildType>(Dependencies{shared_from_this()}, std::forward<ChildArgs>(args)...);
+    }
     CallPostConstructIfPresent(child);
     AddChildHelper(child);
     return child;
@@ -180,6 +199,32 @@ public:
    */
   void UpdateAfterModify();
 
+  /**
+   * Request that this element and its descendants be redrawn after something which
+   * only affects what the element draws (such as the text of a label) has changed.
+   * Nothing is arranged: the element is redrawn within its current total bounds.
+   */
+  void UpdateAfterContentChange();
+
+  // Marks this element as needing to be arranged (and so also drawn) by the next
+  // ElementManager::Flush.  Descendents are rearranged too if it moves or is resized.
+  // An element's Arrange can also call this for some of its children, so that an
+  // update which doesn't rearrange all of its descendants still arranges those.
+  void InvalidateArrange();
+
+  // Marks this element as needing to be drawn by the next ElementManager::Flush,
+  // without being arranged, for changes which only affect what it draws
+  void InvalidateDraw();
+
+  bool GetNeedsArrange();
+  bool GetNeedsDraw();
+
+  // Set whether the arrangement of this element depends on the size of the window,
+  // so that it is marked as needing to be arranged whenever ElementManager::SetSize
+  // changes the size
+  void SetArrangeDependsOnWindowSize(bool arrangeDependsOnWindowSize);
+  bool GetArrangeDependsOnWindowSize();
+
   // Called during each arrange cycle to set or update the position and size of the element
   // (unless the Arrange method is overridden)
   void SetArrangeCallback(const std::function<void(std::shared_ptr<Element>)>&);
@@ -194,6 +239,15 @@ public:
   // Descendents of an updated element are always redrawn regardless of this setting.
   bool GetUpdateRearrangesDescendants();
 
+  // Declares that the children of this element, along with their descendents, can
+  // be arranged concurrently with one another.  When the ElementManager has arrange
+  // threads (see ElementManager::SetArrangeThreadCount), each child's subtree is
+  // then arranged as a separate task before anything is drawn.  The arrange callbacks
+  // of those elements must only touch their own element and read their ancestors,
+  // and must not create or remove elements.
+  void SetArrangeChildrenInParallel(bool arrangeChildrenInParallel);
+  bool GetArrangeChildrenInParallel();
+
   // Register a later sibling that overlaps this one. Note that this
   // registration does not change the drawing order.  It simply ensures
   // that when this element is being updated, overlapping elements get
@@ -272,15 +326,44 @@ public:
   HPixels GetHPixels(double px);
   VPixels GetVPixels(double px);
 
+  // -----------------------------------------------------------------
+  // Translation
+  //
+  // An offset from where this element and its descendents were arranged to where
+  // they are drawn and hit tested, which also moves the clips they apply.  The
+  // bounds stay as arranged, so descendents keep arranging themselves relative to
+  // them.  Changing the translation and then calling UpdateAfterModify (or
+  // InvalidateDraw and ElementManager::Flush, which doesn't even arrange this
+  // element) moves the whole subtree without arranging any of its descendents,
+  // which suits dragging, sliding panels and scrolling.
+
+  void SetTranslation(const Point& translation);
+  const Point& GetTranslation() const;
+
   // -----------------------------------------------------------------
   // Drawing
 
   // Called during each arrange cycle to draw this element (unless the Draw method is overridden)
   void SetDrawCallback(const std::function<void(Element* e, const boost::optional<Rect4>& updateArea)>&);
 
+  // Draws this element through a DrawingContext (unless the Draw method is overridden).
+  // The drawing is recorded and the recording is replayed into the ElementManager's
+  // DrawingContext whenever this element needs to be redrawn, so the callback itself
+  // only runs again after the element has been arranged again (for example, through
+  // UpdateAfterModify) or InvalidateDisplayList has been called.
+  void SetRecordedDrawCallback(const std::function<void(Element* e, DrawingContext& context)>&);
+
+  // Makes the recorded draw callback run again the next time this element is drawn
+  void InvalidateDisplayList();
+
 
   // -----------------------------------------------------------------
   // Hit testing
+  // -----------
+  // Points and regions are given in the coordinates of the parent's bounds (window
+  // coordinates for a layer), so the translation of this element is applied to its
+  // bounds, and those of its descendents on the way down.  The same is true of
+  // Intersects and the other intersection queries below.
 
   ElementQueryInfo GetElementAtPoint(const Point& point);
 
@@ -297,9 +380,21 @@ public:
   // It is strongly recommended that this method be overridden in each container class
   // in order to increase efficiency of hit testing, assuming that the container class
   // has a more optimized mechanism for locating its children than this
-  // default brute force search
+  // default search (which is brute force unless the child index is enabled)
   virtual Element* FindLastChild(const Point& point);
 
+  // Opt in to a spatial index over the children of this element.  When enabled, the
+  // default implementations of FindLastChild, VisitChildren (with a region),
+  // VisitLastChildren and VisitChildrenWithTotalBounds consult the index rather than
+  // searching every child.  This is recommended for containers with many children.
+  // The index is refreshed automatically after children are added, removed or arranged.
+  void SetUsesChildIndex(bool usesChildIndex);
+  bool GetUsesChildIndex();
+
+  // Call this if the bounds of any children have been changed outside of an arrange
+  // cycle so that the child index (if enabled) is refreshed before the next query
+  void InvalidateChildIndex();
+
   // Returns whether this element intersects with the specified region
   bool Intersects(const Rect4& region);
 
@@ -310,46 +405,165 @@ public:
   // Returns whether the TotalBounds of this element intersects with the specified region
   bool TotalBoundsIntersects(const Rect4& region);
 
+  // Returns the union of the total bounds of this element and all its visible descendents,
+  // which can extend beyond this element when descendents have visual bounds of their own.
+  // This is cached and only recalculated for the parts of the subtree which have changed.
+  const Rect4& GetSubtreeBounds();
+
+  // Returns whether the SubtreeBounds of this element intersects with the specified region
+  bool SubtreeBoundsIntersects(const Rect4& region);
+
   // Returns whether this element intersects with the specified point
   bool Intersects(const Point& point);
 
   // -----------------------------------------------------------------
   // Visitors
+  // --------
+  // Each visitor is available both as a template, which is selected for lambdas
+  // and other callables so that the action can be inlined, and as a std::function
+  // overload for callers that need a stable, non-template signature.
+  //
+  // The visitors follow the links between elements without holding references to
+  // them, so the child visitors allow the action to remove the child it is given
+  // but not any of the other children.
 
   // Visit children first to last
   void VisitChildren(const std::function<void(Element*)>& action);
 
+  template<class Action>
+  void VisitChildren(Action&& action)
+  {
+    // The next child is found first in case the action removes this one
+    for (Element* e = _firstChild.get(), *next; e != nullptr; e = next)
+    {
+      next = e->_nextsibling.get();
+      action(e);
+    }
+  }
+
   // Visit ancestors of this element, oldest ancestor first
   void VisitAncestors(const std::function<void(Element*)>& action);
 
+  template<class Action>
+  void VisitAncestors(Action&& action)
+  {
+    TraversalStack<Element*> ancestors;
+    for (Element* e = _parent.get(); e != nullptr; e = e->_parent.get())
+    {
+      ancestors->push_back(e);
+    }
+
+    for (auto i = ancestors->rbegin(); i != ancestors->rend(); ++i)
+    {
+      action(*i);
+    }
+  }
+
   void VisitOverlappingElements(const std::function<void(Element*)>& action);
   void VisitOverlappedElements(const std::function<void(Element*)>& action);
 
+  template<class Action>
+  void VisitOverlappingElements(Action&& action)
+  {
+    if (_cold)
+    {
+      VisitLiveElements(_cold->overlappedBy, action);
+    }
+  }
+
+  template<class Action>
+  void VisitOverlappedElements(Action&& action)
+  {
+    if (_cold)
+    {
+      VisitLiveElements(_cold->overlaps, action);
+    }
+  }
+
   void VisitThisAndDescendents(const std::function<bool(Element*)>& preChildrenAction,
                                const std::function<void(Element*)>& postChildrenAction);
 
+  template<class PreChildrenAction, class PostChildrenAction>
+  void VisitThisAndDescendents(PreChildrenAction&& preChildrenAction,
+                               PostChildrenAction&& postChildrenAction)
+  {
+    if (!preChildrenAction(this))
+    {
+      return;
+    }
+
+    TraversalStack<TraversalFrame> frames;
+    frames->push_back(TraversalFrame{this, nullptr});
+
+    while (!frames->empty())
+    {
+      // The next sibling is only read once the previous child's subtree has been
+      // visited, just like the recursive form, so actions may add children (but
+      // not remove the elements being visited)
+      auto& frame = frames->back();
+      Element* next = frame.child ? frame.child->_nextsibling.get() : frame.element->_firstChild.get();
+      if (next == nullptr)
+      {
+        Element* element = frame.element;
+        frames->pop_back();
+        postChildrenAction(element);
+        continue;
+      }
+
+      frame.child = next;
+      if (preChildrenAction(next))
+      {
+        frames->push_back(TraversalFrame{next, nullptr});
+      }
+    }
+  }
+
   void VisitThisAndDescendents(const std::function<void(Element*)>& action);
 
+  template<class Action>
+  void VisitThisAndDescendents(Action&& action)
+  {
+    VisitThisAndDescendents([](Element*) { return true; }, action);
+  }
+
   void VisitThisAndDescendents(const Rect4& region,
                                const std::function<bool(Element*)>& preChildrenAction,
                                const std::function<void(Element*)>& postChildrenAction);
 
+  template<class PreChildrenAction, class PostChildrenAction>
+  void VisitThisAndDescendents(const Rect4& region,
+                               PreChildrenAction&& preChildrenAction,
+                               PostChildrenAction&& postChildrenAction)
+  {
+    if (preChildrenAction(this))
+    {
+      // The region query is virtual so it still goes through a single std::function,
+      // but the descendents of each matching child are visited without one
+      VisitChildren(region, [&preChildrenAction, &postChildrenAction](Element* child) {
+        child->VisitThisAndDescendents(preChildrenAction, postChildrenAction);
+        return true;
+      });
+
+      postChildrenAction(this);
+    }
+  }
+
   // It is strongly recommended that this method be overridden in each container class
   // in order to increase efficiency of inter-layer element updates, assuming that the
   // container class has a more optimized mechanism for locating its children than this
-  // default brute force search
+  // default search (which is brute force unless the child index is enabled)
   virtual void VisitChildren(const Rect4& region, const std::function<bool(Element*)>& action);
 
   // It is strongly recommended that this method be overridden in each container class
   // in order to increase efficiency of inter-layer element updates, assuming that the
   // container class has a more optimized mechanism for locating its children than this
-  // default brute force search
+  // default search (which is brute force unless the child index is enabled)
   virtual void VisitLastChildren(const Rect4& region, const std::function<bool(Element*)>& action);
 
   // It is strongly recommended that this method be overridden in each container class
   // in order to increase efficiency of hit testing, assuming that the container class
   // has a more optimized mechanism for locating its children than this
-  // default brute force search
+  // default search (which is brute force unless the child index is enabled)
   virtual void VisitChildrenWithTotalBounds(const Rect4& region, const std::function<bool(Element*)>& action);
 
   // -----------------------------------------------------------------
@@ -359,9 +573,7 @@ public:
 
   // -----------------------------------------------------------------
   // Destructor
-  virtual ~Element()
-  {
-  }
+  virtual ~Element();
 
 protected:
 
@@ -372,6 +584,16 @@ protected:
   virtual void PrepareViewModel();
   virtual void Arrange();
 
+  // Called from Arrange by elements which clip to their bounds to report that
+  // everything drawn within them has moved by the specified offset since they were
+  // last drawn, for example because they have been scrolled.  When such an element
+  // is updated with UpdateAfterModify without having been moved or resized, the
+  // pixels already on screen are moved with ElementManager::CopyArea and only the
+  // area which that exposes is drawn, although the children are still arranged as
+  // the update would otherwise arrange them.  The whole element is redrawn as usual
+  // if the backend can't copy or if anything may be drawn on top of the element.
+  void ScrollContent(const Point& offset);
+
   // -----------------------------------------------------------------
   // Draw cycle
 
@@ -395,6 +617,82 @@ protected:
 
 
 private:
+  // The data is split by how often it is used.  The hot fields which are touched by
+  // every traversal, arrange and draw come first and are kept compact, while rarely
+  // used data lives in a side table which is only allocated when it is first needed.
+
+  // -----------------------------------------------------------------
+  // Visual tree
+
+  // The links are non-owning.  Instead, each element that is attached to
+  // the tree holds a reference to itself which is released upon removal.
+  TreeLink<Element>        _parent;
+  TreeLink<Element>        _firstChild;
+  TreeLink<Element>        _lastChild;
+  TreeLink<Element>        _prevsibling;
+  TreeLink<Element>        _nextsibling;
+  int                      _childrenCount = 0;
+
+  // -----------------------------------------------------------------
+  // State tracking
+
+  struct Flags
+  {
+    Flags();
+
+    bool initialUpdate               : 1;
+    bool clipToBounds                : 1;
+    bool isVisible                   : 1;
+    bool isEnabled                   : 1;
+    bool consumesInput               : 1;
+    bool isDetached                  : 1;
+    bool inArrangeMethodNow          : 1;
+    bool updateRearrangesDescendents : 1;
+    bool isInUpdateBatch             : 1;
+    bool batchRearrangesDescendants  : 1;
+    bool subtreeBoundsDirty          : 1;
+    bool hasAncestorClip             : 1;
+    bool arrangeChildrenInParallel   : 1;
+    bool needsArrange                : 1;
+    bool needsDraw                   : 1;
+    bool descendantNeedsFlush        : 1;
+    bool arrangeDependsOnWindowSize  : 1;
+    bool hasTranslation              : 1;
+    bool translationChanged          : 1;
+    bool hasAncestorTranslation      : 1;
+    bool hasContentScroll            : 1;
+
+    bool isLeftSet                   : 1;
+    bool isTopSet                    : 1;
+    bool isRightSet                  : 1;
+    bool isBottomSet                 : 1;
+    bool isCenterXSet                : 1;
+    bool isCenterYSet                : 1;
+    bool isWidthSet                  : 1;
+    bool isHeightSet                 : 1;
+  };
+
+  Flags _flags;
+
+  // The ElementManager clip cache generation for which the ancestor clip and
+  // translation were computed, or zero if they never have been
+  uint32_t _clipCacheGeneration = 0;
+
+  // -----------------------------------------------------------------
+  // Position and size
+
+  double _left    = 0;
+  double _top     = 0;
+  double _right   = 0;
+  double _bottom  = 0;
+  double _centerX = 0;
+  double _centerY = 0;
+  double _width   = 0;
+  double _height  = 0;
+
+  // Cached union of the total bounds of this element and its visible descendents
+  Rect4 _subtreeBounds;
+
   // -----------------------------------------------------------------
   // Objects shared among multiple elements
 
@@ -409,8 +707,6 @@ private:
   // -----------------------------------------------------------------
   // Arrange cycle
 
-  bool _inArrangeMethodNow = false;
-
   struct ArrangeEffects
   {
     bool WasInvisibleBeforeAndAfter() const;
@@ -419,11 +715,20 @@ private:
     const Rect4& GetUnionedTotalBounds() const;
     bool ChildrenRequestedArrange() const;
 
+    // Whether the element was visible before and after but its original and
+    // current total bounds don't overlap (so they can be redrawn separately)
+    bool TotalBoundsAreDisjoint() const;
+    const Rect4& GetOriginalTotalBounds() const;
+    const Rect4& GetCurrentTotalBounds() const;
+
     bool  wasInvisibleBeforeAndAfter;
     bool  elementWasMovedOrResized;
     bool  elementBecameVisible;
     Rect4 unionedTotalBounds;
     bool  childrenRequestedArrange;
+    bool  totalBoundsAreDisjoint;
+    Rect4 originalTotalBounds;
+    Rect4 currentTotalBounds;
   };
 
   struct MonitorArrangeEffects
@@ -449,75 +754,68 @@ private:
 
   boost::optional<MonitorArrangeEffects&> _monitoringArrangeEffects;
 
-  std::deque<std::weak_ptr<Element>> _overlappedBy;
-  std::deque<std::weak_ptr<Element>> _overlaps;
-
-  bool _updateRearrangesDescendents       = false;
-
-  // -----------------------------------------------------------------
-  // Visual tree
-
-  std::shared_ptr<Element> _parent;
-  std::shared_ptr<Element> _firstChild;
-  std::shared_ptr<Element> _lastChild;
-  std::shared_ptr<Element> _prevsibling;
-  std::shared_ptr<Element> _nextsibling;
-  int                      _childrenCount = 0;
-
   // -----------------------------------------------------------------
   // Arrangement
 
-  std::function<void(std::shared_ptr<Element>)>
-                           _setViewModelCallback;
   std::function<void(std::shared_ptr<Element>)>
                            _arrangeCallback;
 
   // -----------------------------------------------------------------
-  // Bounds
-
-  boost::optional<Rect4> _visualBounds;
-  Rect4 _touchMargin;
-
-  // -----------------------------------------------------------------
-  // State tracking
+  // Drawing
 
-  bool _initialUpdate  = false;
-  bool _clipToBounds   = false;
-  bool _isVisible      = true;
-  bool _isEnabled      = true;
-  bool _consumesInput  = false;
-  bool _isDetached     = false;
+  std::function<void(Element*, const boost::optional<Rect4>&)>
+                           _drawCallback;
 
   // -----------------------------------------------------------------
-  // Position and size
-
-  double _left    = 0;
-  double _top     = 0;
-  double _right   = 0;
-  double _bottom  = 0;
-  double _centerX = 0;
-  double _centerY = 0;
-  double _width   = 0;
-  double _height  = 0;
+  // Lifetime and lookup
 
-  bool _isLeftSet    = false;
-  bool _isTopSet     = false;
-  bool _isRightSet   = false;
-  bool _isBottomSet  = false;
-  bool _isCenterXSet = false;
-  bool _isCenterYSet = false;
-  bool _isWidthSet   = false;
-  bool _isHeightSet  = false;
+  std::shared_ptr<Element>    _attachedSelf;
+  std::unique_ptr<ChildIndex> _childIndex;
 
   // -----------------------------------------------------------------
   // Debugging
   std::string_view _typeName;
 
   // -----------------------------------------------------------------
-  // Drawing
+  // Rarely used data
 
-  std::function<void(Element*, const boost::optional<Rect4>&)>
-              _drawCallback;
+  struct ColdData
+  {
+    std::vector<std::weak_ptr<Element>> overlappedBy;
+    std::vector<std::weak_ptr<Element>> overlaps;
+
+    boost::optional<Rect4> visualBounds;
+    Rect4                  touchMargin;
+
+    std::function<void(std::shared_ptr<Element>)>
+                           setViewModelCallback;
+
+    std::function<void(Element*, DrawingContext&)>
+                           recordedDrawCallback;
+    DisplayList            displayList;
+    bool                   displayListIsValid = false;
+
+    // The intersection of the bounds of every visible ancestor which clips to its
+    // bounds, in window coordinates
+    Rect4                  ancestorClip;
+
+    Point                  translation{0, 0};
+
+    // The translation as of the last time this element was updated, while
+    // translationChanged is set
+    Point                  previousTranslation{0, 0};
+
+    // The sum of the translations of all the ancestors
+    Point                  ancestorTranslation{0, 0};
+
+    // The offset reported by the last arrangement, while hasContentScroll is set
+    Point                  contentScroll{0, 0};
+  };
+
+  std::unique_ptr<ColdData> _cold;
+
+  // Returns the side table, allocating it if necessary
+  ColdData& GetColdData();
 
   // -----------------------------------------------------------------
   // Hit Testing
@@ -530,11 +828,52 @@ private:
   // Helper methods
 
   void AddChildHelper(std::shared_ptr<Element>);
+  void DetachFromTree();
+  void InvalidateSubtreeBounds();
+  void UpdateSubtreeBounds();
+  void OnBoundsChanged();
+  void MarkAncestorsNeedFlush();
+  std::shared_ptr<ElementArena> GetLayerArena() const;
+
+  static std::shared_ptr<Element> SharedFromLink(const TreeLink<Element>& link);
 
   bool CoveredByLayerAbove(const Rect4& region);
   void RedrawThisAndDescendents(const boost::optional<Rect4>& redrawRegion);
 
-  void VisitAncestorsHelper(const std::function<void(Element*)>& action, bool isCallee);
+  // An element whose children are being visited, along with the child
+  // currently being visited (if any)
+  struct TraversalFrame
+  {
+    Element* element;
+    Element* child;
+  };
+
+  // Visits the elements which are still alive and removes the rest from the list
+  template<class Action>
+  static void VisitLiveElements(std::vector<std::weak_ptr<Element>>& elements, Action& action)
+  {
+    auto iter = elements.begin();
+    while (iter != elements.end())
+    {
+      if (auto element = iter->lock())
+      {
+        action(element.get());
+        ++iter;
+      }
+      else
+      {
+        // The element has disappeared so we will remove it from our list
+        iter = elements.erase(iter);
+      }
+    }
+  }
+
+  // Arranges this element and its descendents without drawing them, running the
+  // subtrees of elements which arrange their children in parallel on the pool (if any)
+  void ArrangeHelper(WorkStealingPool* pool);
+
+  // Draws this element and its descendents, first arranging each one if specified
+  void DrawHelper(bool arrange);
 
   void DoArrangeTasks();
 
@@ -546,6 +885,32 @@ private:
 
   bool ClipToBoundsIfNeeded();
 
+  // Recomputes the cached ancestor clip and translation of this element and its
+  // ancestors if any of them are out of date
+  void UpdateAncestorCacheIfNeeded();
+
+  // Returns the cached clip of all the ancestors, or null if none of them clip
+  const Rect4* GetAncestorClip();
+
+  // Returns the offset from the coordinates of the bounds of this element's parent,
+  // or of this element itself, to window coordinates
+  Point GetAncestorTranslation();
+  Point GetTotalTranslation();
+
+  // Returns the total bounds in window coordinates.  If specified, and the
+  // translation has changed since this element was last updated, the bounds are
+  // returned where they were before the change.
+  Rect4 GetTotalBoundsInWindow(bool beforeTranslationChange = false);
+
+  // Converts a region or point from the coordinates of the parent's bounds to
+  // those of this element's bounds, by removing its own translation
+  Rect4 Untranslate(const Rect4& region);
+  Point Untranslate(const Point& point);
+
+  // Pushes the clip of all the ancestors as a single clip and returns whether
+  // there was one to push
+  bool PushAncestorClip();
+
   // Specifies the type of update to be performed.  It is important to specify the correct type of
   // update so that the arranging and drawing logic will work correctly and provide the best
   // performance.
@@ -561,6 +926,9 @@ private:
     // Indicates that the element is in the process of being removed from the element hierarchy
       Removing,
 
+    // Indicates that only what the element draws has changed, so it does not need arranging
+      ContentChange,
+
     // Update the whole element tree at once.
       Everything
   };
@@ -569,6 +937,23 @@ private:
   void Update(UpdateType updateType);
 
   void UpdateHelper(UpdateType updateType);
+
+  // Draws everything affected by an update within the specified region, arranging
+  // the children too if needed and allowed.  Returns false if nothing was drawn
+  // because the region is hidden by a layer above.
+  bool RedrawAfterUpdate(UpdateType updateType, const ArrangeEffects& arrangeEffects,
+                         const Rect4& redrawRegion, bool mayArrangeChildren);
+
+  // Arranges the descendents of an element which has reported a scroll of its
+  // content, moves the pixels already drawn and then draws what is exposed.
+  // Returns false, having done nothing, if the scroll can't be done by copying.
+  bool RedrawAfterContentScroll(const ArrangeEffects& arrangeEffects);
+
+  // Arranges this element (and its descendants if needed) for a batched update
+  // and adds the area which needs to be redrawn to the specified region
+  void ArrangeForBatchedUpdate(UpdateType updateType, bool rearrangeDescendants,
+                               Region& redrawRegion);
+
   void ArrangeAndDrawHelper();
 
   void SetIsDetached(bool isDetached);
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+namespace libgui
+{
+
+/**
+ * ElementArena
+ *
+ * A monotonic arena from which all the elements of a layer can be allocated
+ * (see LayerArena).  Allocating from the arena keeps the elements of a subtree
+ * close together in memory and avoids churning the general heap for transient
+ * UI such as dialogs.
+ *
+ * Individual deallocations are ignored; instead the memory is released all at
+ * once when the arena is destroyed.  Every element allocated from the arena
+ * holds a reference to it (through ArenaAllocator) so this happens only after
+ * the last of its elements has been destroyed.
+ */
+class ElementArena
+{
+public:
+  explicit ElementArena(size_t initialSize);
+
+  ElementArena(const ElementArena&) = delete;
+  ElementArena& operator=(const ElementArena&) = delete;
+
+  void* Allocate(size_t bytes, size_t alignment);
+  void Deallocate(void* pointer, size_t bytes, size_t alignment);
+
+  // The number of allocations which have not yet been deallocated
+  size_t GetLiveAllocations() const;
+
+private:
+  std::pmr::monotonic_buffer_resource _resource;
+  size_t                              _liveAllocations = 0;
+};
+
+/**
+ * LayerArena
+ *
+ * Passed to ElementManager::CreateLayerAbove or CreateLayerBelow to allocate the
+ * new layer and all the elements created in it from an ElementArena of its own,
+ * with the specified initial size in bytes.  Since the memory of elements which
+ * are removed is only reclaimed with the whole arena, this is only for transient
+ * layers, which are built once and then removed, and not for layers whose
+ * elements come and go.
+ */
+struct LayerArena
+{
+  size_t initialSize;
+};
+
+/**
+ * ArenaAllocator
+ *
+ * A standard allocator which allocates from an ElementArena, for use with
+ * std::allocate_shared.  Each copy shares ownership of the arena.
+ */
+template<class T>
+class ArenaAllocator
+{
+  template<class U>
+  friend class ArenaAllocator;
+
+public:
+  using value_type = T;
+
+  explicit ArenaAllocator(std::shared_ptr<ElementArena> arena)
+    : _arena(std::move(arena))
+  {
+  }
+
+  template<class U>
+  ArenaAllocator(const ArenaAllocator<U>& other)
+    : _arena(other._arena)
+  {
+  }
+
+  T* allocate(size_t count)
+  {
+    return static_cast<T*>(_arena->Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* pointer, size_t count)
+  {
+    _arena->Deallocate(pointer, count * sizeof(T), alignof(T));
+  }
+
+  template<class U>
+  bool operator==(const ArenaAllocator<U>& other) const
+  {
+    return _arena == other._arena;
+  }
+
+  template<class U>
+  bool operator!=(const ArenaAllocator<U>& other) const
+  {
+    return _arena != other._arena;
+  }
+
+private:
+  std::shared_ptr<ElementArena> _arena;
+};
+
+}
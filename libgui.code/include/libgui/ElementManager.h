@@ -5,9 +5,13 @@
 #include "Element.h"
 #include "Input.h"
 #include "Layer.h"
+#include "Region.h"
+#include "WorkStealingPool.h"
 
+#include <atomic>
 #include <vector>
 #include <list>
+#include <mutex>
 #include <boost/optional.hpp>
 #include <queue>
 
@@ -32,6 +36,9 @@ public:
   // size should be updated to reflect the new size.
 
   // Sets the overall size of the ElementManager.  Typically this is the window size.
+  // When the size changes, the elements whose arrangement depends on it (see
+  // Element::SetArrangeDependsOnWindowSize) are marked as needing to be arranged,
+  // so that a following Flush only rearranges those subtrees.
   void SetSize(const Size& size);
 
   // Returns the overall size of the ElementManager.  Typically this is the window size.
@@ -67,9 +74,17 @@ public:
   template<class LayerType=Layer, class... LayerArgs>
   std::shared_ptr<LayerType> CreateLayerAbove(std::shared_ptr<Layer> existing, LayerArgs&& ... args)
   {
-    auto layer = std::make_shared<LayerType>(LayerDependencies{this}, std::forward<LayerArgs>(args)...);
-    layer->PostConstructInternal();
-    CallPostConstructIfPresent(layer);
+    auto layer = CreateLayer<LayerType>(0, std::forward<LayerArgs>(args)...);
+    AddLayerAbove(existing, layer);
+    return layer;
+  }
+
+  // As above, but the layer and the elements created in it are allocated from an
+  // ElementArena of their own (see LayerArena), for transient UI such as dialogs
+  template<class LayerType=Layer, class... LayerArgs>
+  std::shared_ptr<LayerType> CreateLayerAbove(std::shared_ptr<Layer> existing, LayerArena arena, LayerArgs&& ... args)
+  {
+    auto layer = CreateLayer<LayerType>(arena.initialSize, std::forward<LayerArgs>(args)...);
     AddLayerAbove(existing, layer);
     return layer;
   }
@@ -91,9 +106,17 @@ public:
   template<class LayerType=Layer, class... LayerArgs>
   std::shared_ptr<LayerType> CreateLayerBelow(std::shared_ptr<Layer> existing, LayerArgs&& ... args)
   {
-    auto layer = std::make_shared<LayerType>(LayerDependencies{this}, std::forward<LayerArgs>(args)...);
-    layer->PostConstructInternal();
-    CallPostConstructIfPresent(layer);
+    auto layer = CreateLayer<LayerType>(0, std::forward<LayerArgs>(args)...);
+    AddLayerBelow(existing, layer);
+    return layer;
+  }
+
+  // As above, but the layer and the elements created in it are allocated from an
+  // ElementArena of their own (see LayerArena), for transient UI such as dialogs
+  template<class LayerType=Layer, class... LayerArgs>
+  std::shared_ptr<LayerType> CreateLayerBelow(std::shared_ptr<Layer> existing, LayerArena arena, LayerArgs&& ... args)
+  {
+    auto layer = CreateLayer<LayerType>(arena.initialSize, std::forward<LayerArgs>(args)...);
     AddLayerBelow(existing, layer);
     return layer;
   }
@@ -103,6 +126,21 @@ public:
   // Removes the specified layer, automatically performing an update during the removal
   void RemoveLayer(std::shared_ptr<Layer> layer);
 
+  // SetArrangeThreadCount
+  // ---------------------
+  // When non-zero, a WorkStealingPool with the specified number of worker threads is
+  // used to arrange the children of elements which allow it (see
+  // Element::SetArrangeChildrenInParallel) concurrently.  Whenever the pool is in use,
+  // full arranges are done as a separate pass before drawing, which is always done
+  // in order on the calling thread.  Zero (the default) arranges everything on the
+  // calling thread while drawing.
+  void SetArrangeThreadCount(size_t threadCount);
+  size_t GetArrangeThreadCount() const;
+
+  // Used internally by elements to arrange in parallel.  Null if there are no
+  // arrange threads.
+  WorkStealingPool* GetArrangePool() const;
+
   // GetLayers
   // ---------
   // Return all the layers from bottom to top
@@ -125,6 +163,47 @@ public:
 
   void UpdateEverything();
 
+  // Batched updates
+  // ---------------
+  // Between BeginBatch and Commit, elements which are added or modified are not
+  // updated immediately.  Instead, Commit arranges each of them once (an element
+  // updated several times, or whose ancestor is also updated, is only arranged
+  // through the one update) and then redraws all the layers within the combined
+  // redraw region in a single pass.  Removals are still performed immediately.
+  // Batches can be nested, in which case only the outermost Commit performs the
+  // updates.
+
+  void BeginBatch();
+  void Commit();
+  bool IsBatching() const;
+
+  // Deferred invalidation
+  // ---------------------
+  // Instead of being updated straight away, elements can be marked with
+  // Element::InvalidateArrange or Element::InvalidateDraw.  Flush then visits only
+  // the marked parts of the element tree, arranges the elements which need it in the
+  // same way as a batch (see above), and redraws once the combined region of those
+  // elements and the current bounds of the elements which only need to be drawn.
+  // Flush cannot be called during an update or a batch.
+
+  void Flush();
+
+  // Posted actions
+  // --------------
+  // Work done on other threads, such as loading items (see ItemsProvider::RequestItem),
+  // hands its results back by posting an action, which is run on the thread which uses
+  // the ElementManager the next time it calls RunPostedActions (typically from the
+  // application's event loop).  Post can be called from any thread.  The post callback
+  // is called on the posting thread after each action is posted, so that the
+  // application can wake up its event loop, and so must be set before anything is posted.
+
+  void Post(std::function<void()> action);
+  void SetPostCallback(const std::function<void()>& callback);
+
+  // Runs the actions posted so far, in the order they were posted, and returns how
+  // many were run.  Actions posted while they run are left for the next call.
+  size_t RunPostedActions();
+
   // -------------------------------------------------------------------------------------
   // Input notification
   // ------------------
@@ -162,7 +241,8 @@ public:
   // meaning that multiple clip rectangles can be pushed onto the stack or popped off
   // the stack, with each new clip rectangle decreasing the current clip area.
   // For an example of an OpenGL implementation of such a stack, refer to the examples
-  // in this library.
+  // in this library.  Clips are pushed in the current translation (see below), but
+  // the clip callbacks always receive them in window coordinates.
 
   void SetPushClipCallback(const std::function<void(const Rect4&)>& callback);
   void SetPopClipCallback(const std::function<void()>& callback);
@@ -170,6 +250,60 @@ public:
   void PushClip(const Rect4& clip);
   void PopClip();
 
+  // Used internally by elements to indicate that an element which clips to its bounds
+  // has moved, been resized, shown, hidden or attached, or that any element has been
+  // translated, so that the clips and translations which elements have cached from
+  // their ancestors must be recomputed
+  void InvalidateClipCache();
+  uint32_t GetClipCacheGeneration() const;
+
+  // -------------------------------------------------------------------------------------
+  // Translation support
+  // -------------------
+  // Elements which have a translation (see Element::SetTranslation) are drawn with
+  // their coordinates offset by it.  Each pushed offset is added to the current one
+  // and applies to everything drawn until it is popped.  Backends which draw through
+  // draw callbacks rather than a DrawingContext need to offset their drawing by it,
+  // for example with glTranslate.  The DrawingContext receives translations as well.
+  // Grid and VirtualList only move their cells by translation if the backend supports
+  // it, through both translation callbacks or a DrawingContext, and otherwise arrange
+  // the cells again.
+
+  void SetPushTranslationCallback(const std::function<void(const Point&)>& callback);
+  void SetPopTranslationCallback(const std::function<void()>& callback);
+
+  bool CanTranslate() const;
+
+  void PushTranslation(const Point& offset);
+  void PopTranslation();
+
+  // -------------------------------------------------------------------------------------
+  // Scrolling by copying
+  // --------------------
+  // When an element scrolls what it draws (see Element::ScrollContent, which Grid uses),
+  // the pixels which are already on screen can be moved instead of being drawn again,
+  // so that only the area which the scroll exposes needs to be drawn.  This is only done
+  // if the backend can copy, either through the copy callback or because the
+  // DrawingContext supports it.  The area and the offset are in window coordinates and
+  // the copy ignores the current clip and translation.
+
+  void SetCopyAreaCallback(const std::function<void(const Rect4& area, const Point& offset)>& callback);
+
+  bool CanCopyArea() const;
+
+  // Used internally by elements to move pixels which have already been drawn
+  void CopyArea(const Rect4& area, const Point& offset);
+
+  // -------------------------------------------------------------------------------------
+  // Drawing context
+  // ---------------
+  // Elements which draw through Element::SetRecordedDrawCallback record their drawing
+  // and replay it into this DrawingContext, which is implemented by the rendering
+  // backend.  Clips are forwarded to it as well as to the clip callbacks above.
+
+  void SetDrawingContext(const std::shared_ptr<DrawingContext>& context);
+  DrawingContext* GetDrawingContext() const;
+
   // -------------------------------------------------------------------------------------
   // Inches to Pixels conversion
   // ---------------------------
@@ -200,8 +334,21 @@ public:
   // Used internally by elements to indicate that a new region has been redrawn
   void AddToRedrawnRegion(const Rect4& region);
 
-  // Returns the total region that has been redrawn since the last call to ClearRedrawnRegion
-  const boost::optional<Rect4>& GetRedrawnRegion();
+  // Returns the total region that has been redrawn since the last call to ClearRedrawnRegion.
+  // The region is made of separate rectangles so that only the parts which actually
+  // changed need to be copied.
+  const Region& GetRedrawnRegion() const;
+
+  // Returns the areas which have been copied (see CopyArea) since the last call to
+  // ClearRedrawnRegion, in order.  To bring another buffer up to date, first make the
+  // same copies in it and then copy the redrawn region, which includes wherever the
+  // copies moved parts of the region that had already been redrawn.
+  struct CopiedArea
+  {
+    Rect4 area;
+    Point offset;
+  };
+  const std::vector<CopiedArea>& GetCopiedAreas() const;
 
   // -------------------------------------------------------------------------------------
   // Debugging visualization
@@ -223,6 +370,11 @@ public:
   // is already processing in the same cycle, it gets added as a pending request
   // and is handled as soon as the current one is complete.
 
+  // Used internally by elements whose arrangement depends on the window size.  Each
+  // element is only kept once, however many times it is added.
+  void AddWindowSizeDependent(Element* element);
+  void RemoveWindowSizeDependent(Element* element);
+
   // Internal use only.  Performs the update cycle appropriately.
   void UpdateOrAddPending(std::shared_ptr<Element> element,
                           Element::UpdateType type);
@@ -248,19 +400,62 @@ private:
   double                            _dpiY = 96.0;
   std::function<void(const Rect4&)> _pushClipCallback;
   std::function<void()>             _popClipCallback;
-  boost::optional<Rect4>            _redrawnRegion;
+  std::function<void(const Point&)> _pushTranslationCallback;
+  std::function<void()>             _popTranslationCallback;
+  std::function<void(const Rect4&, const Point&)>
+                                    _copyAreaCallback;
+  Point                             _translation{0, 0};
+  std::vector<Point>                _translations;
+  std::atomic<uint32_t>             _clipCacheGeneration{1};
+  std::shared_ptr<DrawingContext>   _drawingContext;
+  Region                            _redrawnRegion;
+  std::vector<CopiedArea>           _copiedAreas;
   bool                              _inUpdateCycle;
   std::deque<PendingUpdate>         _pendingUpdates;
   Size                              _size;
   Size                              _fuzzyTouchSize;
+  std::unique_ptr<WorkStealingPool> _arrangePool;
+  int                               _batchDepth = 0;
+  std::vector<PendingUpdate>        _batchedUpdates;
+  std::vector<std::weak_ptr<Element>> _windowSizeDependents;
+  std::mutex                        _postedMutex;
+  std::vector<std::function<void()>> _postedActions;
+  std::function<void()>             _postCallback;
 
 private:
+  // An arenaSize of zero allocates the layer and its elements from the heap
+  template<class LayerType, class... LayerArgs>
+  std::shared_ptr<LayerType> CreateLayer(size_t arenaSize, LayerArgs&& ... args)
+  {
+    std::shared_ptr<LayerType> layer;
+    if (arenaSize > 0)
+    {
+      auto arena = std::make_shared<ElementArena>(arenaSize);
+      layer = std::allocate_shared<LayerType>(ArenaAllocator<LayerType>(arena),
+                                              LayerDependencies{this}, std::forward<LayerArgs>(args)...);
+      layer->_arena = arena;
+    }
+    else
+    {
+      layer = std::make_shared<LayerType>(LayerDependencies{this}, std::forward<LayerArgs>(args)...);
+    }
+    layer->PostConstructInternal();
+    CallPostConstructIfPresent(layer);
+    return layer;
+  }
+
   void AddLayerAbove(std::shared_ptr<Layer> existing,
                            std::shared_ptr<Layer> layerToAdd);
 
   void AddLayerBelow(std::shared_ptr<Layer> existing,
                            std::shared_ptr<Layer> layerToAdd);
 
+  void AddBatchedUpdate(std::shared_ptr<Element> element, Element::UpdateType type);
+  void PerformBatchedUpdates(Region redrawRegion = Region());
+  void PerformPendingUpdates();
+  void RedrawLayers(const Region& region);
+  void RedrawLayers(const Rect4& region);
+
   friend class Control;
   void NotifyControlIsBeingDestroyed(Control* control);
 
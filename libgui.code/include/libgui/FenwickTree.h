@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+namespace libgui
+{
+
+/**
+ * FenwickTree
+ *
+ * A list of values (such as the heights of the rows of a list) which also gives
+ * the sum of any number of leading values, and finds the value which spans any
+ * offset into their total, in O(log n) time.  Setting a value also takes O(log n)
+ * time, so the sums stay up to date as values change one at a time.  Appending
+ * or removing values at the end takes O(log n) time for each value, but otherwise
+ * inserting, removing or moving values rebuilds the tree in O(n) time.
+ */
+class FenwickTree
+{
+public:
+  int GetSize() const;
+
+  // Replaces the contents with count copies of the value
+  void Assign(int count, double value);
+
+  void Insert(int index, int count, double value);
+  void Remove(int index, int count);
+
+  // Moves the count values starting at index so that the first of them is at newIndex
+  void Move(int index, int count, int newIndex);
+
+  double Get(int index) const;
+  void Set(int index, double value);
+
+  // The sum of the first count values
+  double GetPrefixSum(int count) const;
+  double GetTotal() const;
+
+  // The index of the value which spans the specified offset from the start of the
+  // first value, which is the first value if the offset is negative and the last
+  // value if it is beyond the total.  The list must not be empty.
+  int FindIndex(double offset) const;
+
+private:
+  std::vector<double> _values;
+
+  // The tree is 1-based: _tree[i] holds the sum of the values in the range
+  // (i - lowbit(i), i]
+  std::vector<double> _tree;
+  int                 _highestBit = 0;
+
+  void Rebuild();
+  void Append(double value);
+  void UpdateHighestBit();
+};
+
+}
@@ -40,39 +40,151 @@ public:
 
   std::shared_ptr<ItemsProvider> GetItemsProvider() const;
 
+  // The grid follows the provider's change notifications: the scroll position is
+  // adjusted so that the rows in view stay where they are when items are inserted
+  // or removed above them and cells are only rebound where the items they show have
+  // changed.  The grid is marked as needing to be arranged (see InvalidateArrange)
+  // only when the cells in view are affected, so appending items below the view just
+  // notifies the scrollbar.
   void SetItemsProvider(std::shared_ptr<ItemsProvider> itemsProvider);
 
+  // When the grid is scrolled, the cells which still show the same item are moved by
+  // their translation (see Element::SetTranslation) without being arranged again, so
+  // the backend must draw them offset by the translation callbacks or through a
+  // DrawingContext.  If it does neither (see ElementManager::CanTranslate) those cells
+  // are arranged again at their new position instead.
   void SetCellCreateCallback(const std::function<void(std::shared_ptr<Element> cellContainer)>& cellCreateCallback);
 
+  // When enabled, scrolling by a whole number of pixels and then calling
+  // UpdateAfterModify moves the cells which are already on screen by copying their
+  // pixels (see Element::ScrollContent) and only draws the rows which are exposed.
+  // Cells must draw only according to their view model and bounds, so cells whose
+  // items have changed need to be updated separately, and whatever the grid itself
+  // draws must look the same wherever it is scrolled to, like a plain background.
+  void SetScrollByCopy(bool scrollByCopy);
+  bool GetScrollByCopy() const;
+
+  // The number of rows of items beyond those shown by the cells which are passed to
+  // ItemsProvider::Prefetch, on the side the grid is being scrolled towards (or on
+  // both sides when it hasn't just been scrolled).  Zero (the default) prefetches
+  // nothing.  Items which are loaded asynchronously (see ItemsProvider::RequestItems)
+  // are shown by updating just the cell which shows them, from
+  // ElementManager::RunPostedActions.
+  void SetPrefetchRows(int prefetchRows);
+  int GetPrefetchRows() const;
+
+  // Hit testing and region queries are answered arithmetically from the cell
+  // layout rather than by searching every cell
+  Element* FindLastChild(const Point& point) override;
+  void VisitChildren(const Rect4& region, const std::function<bool(Element*)>& action) override;
+  void VisitLastChildren(const Rect4& region, const std::function<bool(Element*)>& action) override;
+
 private:
   class Cell: public Element
   {
   public:
-    Cell(Element::Dependencies elementDependencies, int index);
+    Cell(Element::Dependencies elementDependencies, int itemIndex);
 
     void PrepareViewModel() override;
     void Arrange() override;
 
+    // The index of the item shown by the cell, which may be beyond the last item
+    int GetItemIndex() const;
+    void SetItemIndex(int itemIndex);
+
+    // Shows the item fetched by the grid, rather than fetching it when next arranged
+    void SetItem(std::shared_ptr<ViewModelBase> item);
+
   private:
     std::weak_ptr<Grid> _grid;
-    int                 _index;
+    int                 _itemIndex;
+    bool                _hasItem = false;
   };
 
 private:
   int    _columns                         = 3;
-  double _cellHeight;
-  double _cellWidth;
+  double _cellHeight                      = 0.0;
+  double _cellWidth                       = 0.0;
   double _offsetPercent                   = 0.0;
-  int    _baseItemIndex;
-  double _rowOffset;
+  int    _baseItemIndex                   = 0;
+  double _rowOffset                       = 0.0;
   double _lastHeightUsedForScrollCheck    = 0.0;
   int    _lastItemCountUsedForScrollCheck = 0;
   double _topPadding                      = 0.0;
   double _bottomPadding                   = 0.0;
+  bool   _scrollByCopy                    = false;
+  int    _prefetchRows                    = 0;
+  int    _prefetchedBaseRow               = -1;
+  int    _prefetchedDirection             = 0;
+
+  // The number of items, fetched once at the start of each arrange (or -1 outside one)
+  int    _arrangeTotalItems               = -1;
+
+  int    _itemsChangedHandlerId           = -1;
+
+  // Whether the cells' item indexes have been updated for changes to the items since
+  // the last arrange, so that the cells which still show the right items can be kept
+  bool   _itemsChanged                    = false;
+
+  // Added to each row of items to find the row of cells which shows it, so that rows
+  // of items which are renumbered by changes above them stay in the same cells
+  int    _cellRowShift                    = 0;
+
+  // The layout of the cells as last arranged, to tell whether they have only scrolled
+  bool   _cellsWereArranged               = false;
+  Rect4  _arrangedBounds;
+  int    _arrangedColumns                 = 0;
+  double _arrangedCellHeight              = 0.0;
+  int    _arrangedItemCount               = 0;
+  double _arrangedScrollTop               = 0.0;
 
   std::shared_ptr<ItemsProvider>                _itemsProvider;
   std::function<void()>                         _thumbDataChangeCallback;
   std::function<void(std::shared_ptr<Element>)> _cellCreateCallback;
+  ItemsProvider::ItemReady                      _itemReady;
+
+  // The cells which are to show other items, and the items for them, which are kept
+  // to reuse their storage
+  std::vector<Cell*>                            _reboundCells;
+  std::vector<std::shared_ptr<ViewModelBase>>   _fetchedItems;
+
+  // The cells in the order they were created.  Each row of cells shows the rows of
+  // items which are a whole number of rows of cells apart, so the rows of cells act
+  // as a ring buffer which scrolling rotates (unless the last row of cells isn't
+  // full, in which case they simply show the visible rows in order).
+  std::vector<Cell*> _cells;
+
+  int GetTotalItems();
+
+  // Fetches the items for the cells which are to show other items, with one request
+  void FetchReboundItems(int totalCount);
+
+  // The row of items shown by the specified row of cells
+  int GetItemRowForCellRow(int cellRow);
+
+  // The top of the cells which show the specified row of items, before they are
+  // snapped to pixels
+  double GetCellTop(int itemRow);
+
+  // Prefetches the rows beyond the cells on the side which the grid is being
+  // scrolled towards (below if positive, above if negative or both if zero)
+  void PrefetchRows(int direction);
+  void PrefetchItemRows(int firstRow, int endRow);
+
+  // Updates the cell which shows the item, if any, now that it has been loaded
+  void OnItemReady(int index);
+
+  void OnItemsChanged(const ItemsProvider::ItemsChange& change);
+
+  double GetContentHeight(int itemCount);
+
+  bool CanLookUpCellsDirectly();
+
+  // Calculates the inclusive range of visible rows (counted from the row of the
+  // first visible item) and columns of cells that may intersect the specified
+  // region.  Returns false if no cells can intersect the region.
+  bool GetCellRange(const Rect4& region, int& firstRow, int& lastRow,
+                    int& firstColumn, int& lastColumn);
 
 protected:
   // Cleanup
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ItemsProvider.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace libgui
+{
+
+/**
+ * IndexedItemsProvider
+ *
+ * An ItemsProvider which holds its items in a list, along with a hash index from
+ * each item to its position, so that GetItemIndex (and so Grid::ScrollTo) takes
+ * constant time however many items there are.  Providers can either derive from
+ * it or fill one and hand it to a Grid.
+ *
+ * The index is kept up to date incrementally: removing items only drops their
+ * own entries, and the positions of the items after an insertion or removal are
+ * brought up to date the next time an item is looked up, so a batch of changes
+ * costs a single pass over the items which moved.
+ *
+ * Each change is also passed on through the ItemsProvider change notifications.
+ *
+ * Each item may only appear once in the list.
+ */
+class IndexedItemsProvider: public ItemsProvider
+{
+public:
+  int GetTotalItems() override;
+  std::shared_ptr<ViewModelBase> GetItem(int index) override;
+  void GetItems(int first, int count, std::vector<std::shared_ptr<ViewModelBase>>& items) override;
+
+  // Returns the position of the item, or -1 if it isn't in the list
+  int GetItemIndex(std::shared_ptr<ViewModelBase> item) override;
+
+  // Inserts the items before the specified position (which may be the end)
+  void Insert(int index, const std::vector<std::shared_ptr<ViewModelBase>>& items);
+  void Insert(int index, std::shared_ptr<ViewModelBase> item);
+  void Append(const std::vector<std::shared_ptr<ViewModelBase>>& items);
+
+  // Removes the count items starting at the specified position
+  void Remove(int index, int count);
+  void Clear();
+
+  // Moves the count items starting at index so that the first of them is at newIndex
+  void Move(int index, int count, int newIndex);
+
+  // Replaces the item at the specified position
+  void Replace(int index, std::shared_ptr<ViewModelBase> item);
+
+private:
+  std::vector<std::shared_ptr<ViewModelBase>>         _items;
+  std::unordered_map<const ViewModelBase*, int>       _positions;
+
+  // The number of items at the start of the list whose positions are up to date
+  int                                                 _indexedCount = 0;
+
+  void ThrowIfOutOfRange(int index, int count) const;
+};
+
+}
@@ -1,8 +1,8 @@
 #pragma once
 
 #include "Rect.h"
+#include <boost/container/small_vector.hpp>
 #include <boost/optional.hpp>
-#include <stack>
 #include <functional>
 
 namespace libgui
@@ -25,7 +25,8 @@ public:
   OptRegion GetCurrentRegion();
 
 private:
-  std::stack<Rect4> _stack;
+  // Clips are rarely nested deeply, so the stack normally stays in place
+  boost::container::small_vector<Rect4, 16> _stack;
 
   boost::optional<OptRegion>            _lastNotification;
   std::function<void(const OptRegion&)> _regionChangedCallback;
@@ -1,6 +1,9 @@
 ﻿#pragma once
 
+#include <functional>
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace libgui
 {
@@ -14,6 +17,83 @@ public:
   virtual int GetTotalItems()    = 0;
   virtual std::shared_ptr<ViewModelBase> GetItem(int index) = 0;
   virtual int GetItemIndex(std::shared_ptr<ViewModelBase> item) = 0;
+
+  // Replaces the contents of items with the count items starting at first, which
+  // must all exist.  Grid fetches all the items it needs in an arrange with one call,
+  // so providers backed by paged storage can override this to fetch them together.
+  // By default each item is fetched by GetItem.
+  virtual void GetItems(int first, int count, std::vector<std::shared_ptr<ViewModelBase>>& items);
+
+  // Asynchronous loading
+  // --------------------
+  // Items are requested while arranging, so providers whose items are slow to produce
+  // (from a database or disk, for example) should load them on another thread.  Such
+  // a provider returns placeholders from RequestItems straight away and, once each item
+  // has been loaded, calls the ready function with its index from any thread.  From then
+  // on it returns the item itself from RequestItems.  By default the items are returned
+  // by GetItems and the ready function is never called.
+  using ItemReady = std::function<void(int index)>;
+  virtual void RequestItems(int first, int count, const ItemReady& ready,
+                            std::vector<std::shared_ptr<ViewModelBase>>& items);
+
+  // A hint that the specified items are likely to be requested soon, so that they can
+  // start loading.  Does nothing by default.
+  virtual void Prefetch(int index, int count);
+
+  // Change notifications
+  // --------------------
+  // Providers call the Notify methods just after their items change, on the thread
+  // which uses the ElementManager, so that grids showing the items only update the
+  // cells which are affected instead of rebinding every cell.
+  struct ItemsChange
+  {
+    enum class Type
+    {
+      Inserted,
+      Removed,
+      Moved,
+      Changed
+    };
+
+    Type type;
+    int  index;    // The first item affected, as it was numbered before the change
+    int  count;
+    int  newIndex; // Where the first moved item is now (only used by Moved)
+
+    // Where the item at the specified index is after the change, or -1 if it was removed
+    int MapIndex(int index) const;
+
+    // Where a view which starts at the item at the specified index should start after
+    // the change.  It stays with the item unless the item is removed or moved, in which
+    // case it stays at the same place in the list, and items inserted there come into view.
+    int MapViewIndex(int index) const;
+
+    // Whether the item at the specified index was removed or changed, so that whatever
+    // shows it must be updated
+    bool Invalidates(int index) const;
+  };
+
+  using ItemsChangedHandler = std::function<void(const ItemsChange& change)>;
+
+  // Returns an id to pass to RemoveItemsChangedHandler
+  int AddItemsChangedHandler(const ItemsChangedHandler& handler);
+  void RemoveItemsChangedHandler(int handlerId);
+
+protected:
+  void NotifyItemsInserted(int index, int count);
+  void NotifyItemsRemoved(int index, int count);
+
+  // The items were removed and inserted again so that the first of them is at newIndex
+  void NotifyItemsMoved(int index, int count, int newIndex);
+
+  // The items at these positions have been replaced or their contents have changed
+  void NotifyItemsChanged(int index, int count);
+
+private:
+  std::vector<std::pair<int, ItemsChangedHandler>> _itemsChangedHandlers;
+  int                                              _nextHandlerId = 0;
+
+  void Notify(const ItemsChange& change);
 };
 }
 
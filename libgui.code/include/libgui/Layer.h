@@ -60,10 +60,43 @@ public:
   void VisitLowerLayersIf(const std::function<bool(Layer* currentLayer)>& continueDownPredicate,
                           const std::function<void(Layer* lowerLayer)>& action);
 
+  template<class ContinueDownPredicate, class Action>
+  void VisitLowerLayersIf(ContinueDownPredicate&& continueDownPredicate, Action&& action)
+  {
+    // Find the lowest layer first, then perform the action on the way back up
+    TraversalStack<std::shared_ptr<Layer>> lowerLayers;
+
+    Layer* current = this;
+    while (continueDownPredicate(current))
+    {
+      auto nextLayerBelow = current->GetLayerBelow();
+      if (!nextLayerBelow)
+      {
+        break;
+      }
+      current = nextLayerBelow.get();
+      lowerLayers->push_back(std::move(nextLayerBelow));
+    }
+
+    for (auto i = lowerLayers->rbegin(); i != lowerLayers->rend(); ++i)
+    {
+      action(i->get());
+    }
+  }
+
   // Visit layers above the current one from bottom to top and perform the
   // specified action on each layer
   void VisitHigherLayers(const std::function<void(Layer*)>& action);
 
+  template<class Action>
+  void VisitHigherLayers(Action&& action)
+  {
+    for (auto layer = GetLayerAbove(); layer; layer = layer->GetLayerAbove())
+    {
+      action(layer.get());
+    }
+  }
+
   // The layer above this one, if any
   std::shared_ptr<Layer> GetLayerAbove();
   bool AnyLayersAbove();
@@ -77,6 +110,10 @@ public:
 
   void UpdateAfterAdd() override;
 
+  // The arena from which this layer and its elements are allocated, if any
+  // (see LayerArena)
+  const std::shared_ptr<ElementArena>& GetArena() const;
+
 private:
   boost::optional<Rect4> _opaqueArea;
   bool                   _capturesAllIntersectingTouchInput;
@@ -84,10 +121,7 @@ private:
   std::weak_ptr<Layer> _layerAbove;
   std::weak_ptr<Layer> _layerBelow;
 
-  void VisitLowerLayersIfHelper(const std::function<bool(Layer*)>& continueDownPredicate,
-                                const std::function<void(Layer*)>& action, bool isFirst);
-  void VisitHigherLayersHelper(const std::function<void(Layer*)>& action, bool isFirst);
-
+  std::shared_ptr<ElementArena> _arena;
 };
 
 }
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "DrawingContext.h"
+#include "IntersectionStack.h"
+#include "Region.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace libgui
+{
+
+/**
+ * RasterDrawingContext
+ *
+ * A software renderer which draws into an RGBA framebuffer in memory.  It
+ * needs no GPU or window so it can be used to test and profile the whole
+ * update cycle (arranging, drawing and the resulting pixels) on a headless
+ * machine: set it with ElementManager::SetDrawingContext and elements which
+ * use recorded draw callbacks draw into it.
+ *
+ * Pixels are only written within the current clip, which ElementManager
+ * pushes for each redrawn area, so only the damaged parts of the frame are
+ * rendered.  A pixel is covered by a rectangle when its center is inside it.
+ * Pushed translations move both the drawing and the clips which follow.
+ * Areas are copied by whole pixels, rounding the offset.
+ */
+class RasterDrawingContext: public DrawingContext
+{
+public:
+  RasterDrawingContext(int width, int height);
+
+  // The clip stack refers back to the context so it cannot be copied
+  RasterDrawingContext(const RasterDrawingContext&) = delete;
+  RasterDrawingContext& operator=(const RasterDrawingContext&) = delete;
+
+  // Resizes the framebuffer, which is cleared to transparent black
+  void Resize(int width, int height);
+
+  int GetWidth() const;
+  int GetHeight() const;
+
+  // Sets every pixel, regardless of the current clip
+  void Clear(const Color& color);
+
+  Color GetPixel(int x, int y) const;
+
+  // The pixels as rows of 8-bit RGBA values from top to bottom
+  const uint8_t* GetData() const;
+
+  // Copies the specified region to another framebuffer of the same size, as is
+  // done between the back and front buffers after a partial redraw
+  void CopyTo(RasterDrawingContext& destination, const Region& region) const;
+
+  // Writes the framebuffer as a PAM image (the RGBA member of the netpbm formats)
+  void WritePam(std::ostream& stream) const;
+
+  // The number of pixels written since the last call to ResetPixelsWritten
+  uint64_t GetPixelsWritten() const;
+  void ResetPixelsWritten();
+
+  void FillRectangle(const Rect4& rect, const Color& color) override;
+  void OutlineRectangle(const Rect4& rect, const Color& color, double lineWidth) override;
+  void DrawLine(const Point& from, const Point& to, const Color& color, double lineWidth) override;
+  void Custom(const Rect4& bounds, const CustomDrawing& drawing) override;
+  void PushClip(const Rect4& clip) override;
+  void PopClip() override;
+  void PushTranslation(const Point& offset) override;
+  void PopTranslation() override;
+  bool CanCopyArea() const override;
+  void CopyArea(const Rect4& area, const Point& offset) override;
+
+private:
+  // A range of whole pixels, exclusive of the right and bottom
+  struct PixelRect
+  {
+    int left;
+    int top;
+    int right;
+    int bottom;
+  };
+
+  PixelRect ToPixels(const Rect4& rect) const;
+  PixelRect Clipped(const Rect4& rect) const;
+  void Blend(const PixelRect& pixels, const Color& color);
+
+  int                  _width;
+  int                  _height;
+  std::vector<uint8_t> _pixels;
+  IntersectionStack    _clips;
+  bool                 _isClipped = false;
+  PixelRect            _clipPixels{0, 0, 0, 0};
+  uint64_t             _pixelsWritten = 0;
+  Point                _translation{0, 0};
+  std::vector<Point>   _translations;
+};
+
+}
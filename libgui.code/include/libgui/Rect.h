@@ -53,6 +53,9 @@ struct Rect4
   // side to exclude towards.
   void ExcludeWith(const Rect4& other);
 
+  // Returns a copy of this Rect4 moved by the specified offsets
+  Rect4 Translated(double x, double y) const;
+
   double Area() const;
 };
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Rect.h"
+
+#include <vector>
+
+namespace libgui
+{
+
+/**
+ * Region
+ *
+ * An area made up of any number of rectangles, such as the parts of the window
+ * which have been redrawn.  The rectangles are kept in the usual banded form:
+ * they never overlap, they are sorted from top to bottom and then from left to
+ * right, the rectangles in each horizontal band share the same top and bottom,
+ * and adjacent bands are merged whenever they have the same horizontal extents.
+ * This keeps the number of rectangles small, so iterating them (for example, to
+ * copy only the changed parts between buffers) is cheap.
+ *
+ * Empty or inverted rectangles are ignored.
+ */
+class Region
+{
+public:
+  Region();
+  explicit Region(const Rect4& rect);
+
+  bool IsEmpty() const;
+  void Clear();
+
+  void Union(const Rect4& rect);
+  void Union(const Region& other);
+
+  void Intersect(const Rect4& rect);
+  void Intersect(const Region& other);
+
+  void Subtract(const Rect4& rect);
+  void Subtract(const Region& other);
+
+  // Whether any part of the region overlaps the specified rectangle
+  bool Intersects(const Rect4& rect) const;
+
+  // Whether the region fully covers the specified rectangle
+  bool Contains(const Rect4& rect) const;
+
+  // The smallest rectangle containing the whole region, or an empty Rect4
+  // if the region is empty
+  Rect4 GetBounds() const;
+
+  double Area() const;
+
+  // The non-overlapping rectangles which make up the region, in banded order
+  const std::vector<Rect4>& GetRects() const;
+
+  std::vector<Rect4>::const_iterator begin() const;
+  std::vector<Rect4>::const_iterator end() const;
+
+  bool operator==(const Region& other) const;
+  bool operator!=(const Region& other) const;
+
+private:
+  enum class Operation
+  {
+    Union,
+    Intersect,
+    Subtract
+  };
+
+  void Combine(const std::vector<Rect4>& other, Operation operation);
+
+  std::vector<Rect4> _rects;
+};
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+namespace libgui
+{
+
+/**
+ * TraversalStack
+ *
+ * The explicit stack used by the iterative tree traversals in place of the
+ * call stack.  The storage is borrowed from a per-thread pool for the lifetime
+ * of the TraversalStack and returned (cleared but with its capacity intact)
+ * afterwards, so repeated traversals don't allocate and nested traversals
+ * (for example, an arrange callback that visits another subtree) each get
+ * their own stack.
+ */
+template<class T>
+class TraversalStack
+{
+public:
+  TraversalStack()
+  {
+    auto& pool = Pool();
+    if (!pool.empty())
+    {
+      _items = std::move(pool.back());
+      pool.pop_back();
+    }
+  }
+
+  ~TraversalStack()
+  {
+    _items.clear();
+    Pool().push_back(std::move(_items));
+  }
+
+  TraversalStack(const TraversalStack&) = delete;
+  TraversalStack& operator=(const TraversalStack&) = delete;
+
+  std::vector<T>& operator*()
+  {
+    return _items;
+  }
+
+  std::vector<T>* operator->()
+  {
+    return &_items;
+  }
+
+private:
+  std::vector<T> _items;
+
+  static std::vector<std::vector<T>>& Pool()
+  {
+    static thread_local std::vector<std::vector<T>> pool;
+    return pool;
+  }
+};
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+namespace libgui
+{
+
+/**
+ * TreeLink
+ *
+ * A non-owning, non-atomic handle used for the links between elements in the
+ * element tree (parent, first/last child and previous/next sibling).
+ *
+ * Following a TreeLink costs nothing more than following a raw pointer, which
+ * keeps traversals of large trees free of reference count traffic.  Lifetime is
+ * managed separately: an element keeps itself alive for as long as it is
+ * attached to the tree (see Element::AddChildHelper), and external code keeps
+ * holding elements through std::shared_ptr as before.
+ *
+ * The element tree is only modified from the UI thread so no synchronization
+ * is performed.
+ */
+template<class T>
+class TreeLink
+{
+public:
+  TreeLink() = default;
+
+  TreeLink(std::nullptr_t)
+  {
+  }
+
+  TreeLink(T* pointer)
+    : _pointer(pointer)
+  {
+  }
+
+  template<class U>
+  TreeLink(const std::shared_ptr<U>& pointer)
+    : _pointer(pointer.get())
+  {
+  }
+
+  T* get() const
+  {
+    return _pointer;
+  }
+
+  T* operator->() const
+  {
+    return _pointer;
+  }
+
+  T& operator*() const
+  {
+    return *_pointer;
+  }
+
+  explicit operator bool() const
+  {
+    return _pointer != nullptr;
+  }
+
+  bool operator==(const TreeLink& other) const
+  {
+    return _pointer == other._pointer;
+  }
+
+  bool operator!=(const TreeLink& other) const
+  {
+    return _pointer != other._pointer;
+  }
+
+  bool operator==(std::nullptr_t) const
+  {
+    return _pointer == nullptr;
+  }
+
+  bool operator!=(std::nullptr_t) const
+  {
+    return _pointer != nullptr;
+  }
+
+private:
+  T* _pointer = nullptr;
+};
+
+}
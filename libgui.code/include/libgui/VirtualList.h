@@ -0,0 +1,152 @@
+#pragma once
+#include "Element.h"
+#include "FenwickTree.h"
+#include "ItemsProvider.h"
+#include "ScrollDelegate.h"
+
+namespace libgui
+{
+/**
+ * VirtualList
+ *
+ * A single column of items whose rows can each have a different height, which
+ * only creates cells for the rows in view and reuses them as it is scrolled, in
+ * the same way as Grid.
+ *
+ * Rows start with the estimated item height.  When an item is first shown, the
+ * measure callback (if any) is asked for its height at the current width, and
+ * heights which are only known later can be set with SetItemHeight.  The heights
+ * are kept in a FenwickTree, so finding the row at a scroll position and updating
+ * a height both take O(log n) time, however many items there are.
+ *
+ * The scroll position is kept in pixels, so the rows in view stay where they are
+ * as the heights of other rows become known.  Like Grid, the list is a ScrollDelegate
+ * for a Scrollbar and follows its items provider's change notifications, and it
+ * moves the cells which are kept when scrolling by translation only if the backend
+ * supports it (see ElementManager::CanTranslate).
+ */
+class VirtualList: public Element, public ScrollDelegate
+{
+public:
+  VirtualList(Element::Dependencies elementDependencies);
+
+  void Arrange() override;
+
+  double GetCurrentOffsetPercent() override;
+  double GetThumbSizePercent() override;
+
+  void WhenThumbDataChanges(const std::function<void()>& handler) override;
+
+  void MoveToOffsetPercent(double offsetPercent, bool notify_thumb) override;
+
+  // Scrolls so that the top of the item is at the top of the list, as far as possible
+  void ScrollTo(int index);
+  void ScrollTo(std::shared_ptr<ViewModelBase> item);
+
+  bool CanScroll();
+
+  double GetScrollTop() const;
+
+  // The height of every row whose item hasn't been measured
+  void SetEstimatedItemHeight(double estimatedItemHeight);
+  double GetEstimatedItemHeight() const;
+
+  // Called with each item, and the width of the list, when the item is first shown,
+  // again after it changes and again after the width of the list changes
+  void SetMeasureCallback(const std::function<double(const std::shared_ptr<ViewModelBase>& item, double width)>& measureCallback);
+
+  void SetItemHeight(int index, double height);
+  double GetItemHeight(int index);
+
+  // The distance from the top of the content to the top of the item
+  double GetItemTop(int index);
+  double GetContentHeight();
+
+  std::shared_ptr<ItemsProvider> GetItemsProvider() const;
+  void SetItemsProvider(std::shared_ptr<ItemsProvider> itemsProvider);
+
+  void SetCellCreateCallback(const std::function<void(std::shared_ptr<Element> cellContainer)>& cellCreateCallback);
+
+private:
+  class Cell: public Element
+  {
+  public:
+    Cell(Element::Dependencies elementDependencies);
+
+    void PrepareViewModel() override;
+    void Arrange() override;
+
+    // The index of the item shown by the cell, or -1 if it isn't in use
+    int GetItemIndex() const;
+    void SetItemIndex(int itemIndex);
+
+    // Shows the item fetched by the list, rather than fetching it when next arranged
+    void SetItem(std::shared_ptr<ViewModelBase> item);
+
+  private:
+    std::weak_ptr<VirtualList> _list;
+    int                        _itemIndex = -1;
+    bool                       _hasItem   = false;
+  };
+
+private:
+  double _estimatedItemHeight = 0.0;
+  double _scrollTop           = 0.0;
+  double _measuredWidth       = 0.0;
+  int    _itemsChangedHandlerId = -1;
+
+  // Whether the items or their heights have changed since the last arrange, so that
+  // the cells which still show the right items can be kept
+  bool   _itemsChanged        = false;
+
+  // The layout of the cells as last arranged, to tell whether they can be kept
+  bool   _cellsWereArranged   = false;
+  Rect4  _arrangedBounds;
+  double _arrangedScrollTop   = 0.0;
+
+  // What the thumb was last told about
+  double _notifiedContentHeight = -1.0;
+  double _notifiedHeight        = -1.0;
+
+  FenwickTree       _itemHeights;
+  std::vector<bool> _itemIsMeasured;
+
+  std::shared_ptr<ItemsProvider>                _itemsProvider;
+  std::function<void()>                         _thumbDataChangeCallback;
+  std::function<void(std::shared_ptr<Element>)> _cellCreateCallback;
+  std::function<double(const std::shared_ptr<ViewModelBase>&, double)> _measureCallback;
+  ItemsProvider::ItemReady                      _itemReady;
+
+  // The cells in the order they were created, which show the rows in view in any order
+  std::vector<Cell*> _cells;
+
+  // Working storage for each arrange, which is kept to reuse it
+  std::vector<Cell*>                          _visibleCells;
+  std::vector<Cell*>                          _freeCells;
+  std::vector<Cell*>                          _reboundCells;
+  std::vector<std::shared_ptr<ViewModelBase>> _fetchedItems;
+
+  // Makes sure that there is a height for each item, starting again if the number
+  // of items has changed without a notification
+  void SyncItemHeights(int totalCount);
+
+  void LimitScrollTop();
+
+  // Binds a cell to each item in the range, keeping the cells which already show
+  // one of them and hiding the cells which are left over
+  void BindCells(int first, int end);
+
+  // Fetches the items for the cells bound to other items with one request, and
+  // measures those which haven't been measured.  Returns whether any height changed.
+  bool FetchAndMeasureReboundItems(int totalCount);
+
+  void NotifyThumbIfChanged();
+
+  void OnItemReady(int index);
+  void OnItemsChanged(const ItemsProvider::ItemsChange& change);
+
+protected:
+  // Cleanup
+  void OnElementIsBeingRemoved() override;
+};
+}
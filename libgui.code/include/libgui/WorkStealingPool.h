@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libgui
+{
+
+/**
+ * WorkStealingPool
+ *
+ * A fixed set of worker threads which run batches of tasks for the thread
+ * which owns the pool (see ElementManager::SetArrangeThreadCount).  Each thread
+ * has its own queue of tasks: it takes the most recently added task from its
+ * own queue and, when that is empty, steals the oldest task from another queue.
+ * A task may itself run a batch of tasks, which lets uneven trees spread out
+ * across the threads as they are discovered.
+ *
+ * Only the owning thread and the pool's own workers may call Run.
+ */
+class WorkStealingPool
+{
+public:
+  // The owning thread also runs tasks, so a pool with no workers runs every
+  // task on the owning thread
+  explicit WorkStealingPool(size_t workerCount);
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  size_t GetWorkerCount() const;
+
+  // Runs all of the tasks, helping with them and any other queued tasks until
+  // every one of these has finished.  If any task throws, the first exception
+  // is rethrown once they have all finished.
+  void Run(const std::vector<std::function<void()>>& tasks);
+
+private:
+  struct Batch
+  {
+    std::atomic<size_t> remaining;
+    std::exception_ptr  exception;
+    std::mutex          exceptionMutex;
+  };
+
+  struct Task
+  {
+    const std::function<void()>* work;
+    Batch*                       batch;
+  };
+
+  struct Queue
+  {
+    std::mutex       mutex;
+    std::deque<Task> tasks;
+  };
+
+  // Queue 0 belongs to the owning thread and the rest to the workers
+  size_t GetQueueIndex() const;
+  bool TryTakeTask(size_t queueIndex, Task& task);
+  void RunTask(const Task& task);
+  void WorkerLoop(size_t queueIndex);
+
+  std::vector<std::unique_ptr<Queue>> _queues;
+  std::vector<std::thread>            _workers;
+  std::atomic<size_t>                 _queuedTasks{0};
+  std::mutex                          _wakeMutex;
+  std::condition_variable             _wake;
+  bool                                _stopping = false;
+};
+
+}
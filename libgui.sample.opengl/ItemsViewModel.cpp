@@ -4,7 +4,7 @@ using std::make_shared;
 
 ItemsViewModel::ItemsViewModel()
 {
-  _items = {
+  Append({
     make_shared<ItemViewModel>("A-1", "type a", "123"),
     make_shared<ItemViewModel>("B-1", "type a", "456"),
     make_shared<ItemViewModel>("C-1", "type a", "789"),
@@ -14,40 +14,12 @@ ItemsViewModel::ItemsViewModel()
     make_shared<ItemViewModel>("A-3", "type a", "123"),
     make_shared<ItemViewModel>("B-3", "type a", "456"),
     make_shared<ItemViewModel>("C-3", "type a", "789"),
-  };
-}
-
-int ItemsViewModel::GetTotalItems()
-{
-  return _items.size();
-}
-
-std::shared_ptr<libgui::ViewModelBase> ItemsViewModel::GetItem(int index)
-{
-  if (index >= _items.size())
-  {
-    return nullptr;
-  }
-  return _items[index];
-}
-
-int ItemsViewModel::GetItemIndex(std::shared_ptr<libgui::ViewModelBase> item)
-{
-  for (int i = 0; i < _items.size(); ++i)
-  {
-    if (_items[i] == item)
-    {
-      return i;
-    }
-  }
-
-  // Not found
-  return -1;
+  });
 }
 
 void ItemsViewModel::AddOtherItems()
 {
-  std::vector<std::shared_ptr<ItemViewModel>> newItems = {
+  std::vector<std::shared_ptr<libgui::ViewModelBase>> newItems = {
     make_shared<ItemViewModel>("A-4", "b is the type", "123"),
     make_shared<ItemViewModel>("B-4", "b is the type", "456"),
     make_shared<ItemViewModel>("C-4", "b is the type", "789"),
@@ -95,10 +67,13 @@ void ItemsViewModel::AddOtherItems()
     make_shared<ItemViewModel>("C-17", "b is the type", "789"),
   };
 
-  _items.insert(_items.end(), newItems.begin(), newItems.end());
+  Append(newItems);
 }
 
 void ItemsViewModel::RemoveOtherItems()
 {
-  _items.resize(9);
+  if (GetTotalItems() > 9)
+  {
+    Remove(9, GetTotalItems() - 9);
+  }
 }
@@ -46,7 +46,6 @@
 #include "libgui/Slider.h"
 #include "libgui/IntersectionStack.h"
 #include "libgui/Button.h"
-#include "libgui/ScopeExit.h"
 
 #include "freetype-gl.h"
 #include "vertex-buffer.h"
@@ -69,7 +68,6 @@ using libgui::Rect4;
 using libgui::Element;
 using libgui::Grid;
 using libgui::Knob;
-using libgui::ScopeExit;
 using libgui::Scrollbar;
 using libgui::Slider;
 using libgui::Button;
@@ -561,17 +559,17 @@ void InitElements()
     [itemsVm, grid, grid_scroll](std::shared_ptr<Button> b, Button::OutputEvent event) {
       if (Button::OutputEvent::Clicked == event)
       {
+        auto couldScroll = grid->CanScroll();
         itemsVm->AddOtherItems();
 
-        // In the transition between having a scrollbar and not, the grid
-        // and its scrollbar will overlap
-        grid->RegisterOverlappingElement(grid_scroll);
+        // The grid follows the items' change notifications, but its width and
+        // whether the scrollbar is shown also depend on whether it can scroll.
+        // The main loop's Flush arranges them together and redraws both at once,
+        // so the grid and its scrollbar overlapping in the transition is fine.
+        if (grid->CanScroll() != couldScroll)
         {
-          ScopeExit scopeExit([grid, grid_scroll] {
-            grid->UnregisterOverlappingElement(grid_scroll);
-          });
-          grid->UpdateAfterModify();
-          grid_scroll->UpdateAfterModify();
+          grid->InvalidateArrange();
+          grid_scroll->InvalidateArrange();
         }
       }
     });
@@ -580,17 +578,14 @@ void InitElements()
     [itemsVm, grid, grid_scroll](std::shared_ptr<Button> b, Button::OutputEvent event) {
       if (Button::OutputEvent::Clicked == event)
       {
+        auto couldScroll = grid->CanScroll();
         itemsVm->RemoveOtherItems();
 
-        // In the transition between having a scrollbar and not, the grid
-        // and its scrollbar will overlap
-        grid->RegisterOverlappingElement(grid_scroll);
+        // As when adding items, the layout also depends on whether the grid can scroll
+        if (grid->CanScroll() != couldScroll)
         {
-          ScopeExit scopeExit([grid, grid_scroll] {
-            grid->UnregisterOverlappingElement(grid_scroll);
-          });
-          grid->UpdateAfterModify();
-          grid_scroll->UpdateAfterModify();
+          grid->InvalidateArrange();
+          grid_scroll->InvalidateArrange();
         }
       }
     });
@@ -886,25 +881,25 @@ void DrawButton(Element* e)
 
 void display(GLFWwindow* window)
 {
-  auto& redrawnRegionOpt = elementManager->GetRedrawnRegion();
-  if (redrawnRegionOpt)
+  auto& redrawnRegion = elementManager->GetRedrawnRegion();
+  if (!redrawnRegion.IsEmpty())
   {
     // Something has changed since the last time anything was redrawn
     glfwSwapBuffers(window);
 
-    // Copy from back to front buffer just the region that changed
+    // Copy from back to front buffer just the parts that changed
     // so that both buffers are identical
-
-    auto& redrawnRegion = redrawnRegionOpt.get();
-
-    auto left   = int(std::round(redrawnRegion.left));
-    auto top    = int(std::round(redrawnRegion.top));
-    auto right  = int(std::round(redrawnRegion.right));
-    auto bottom = int(std::round(redrawnRegion.bottom));
-
-    GLERR(glBlitFramebuffer(left, bottom, right, top,
-                            left, bottom, right, top,
-                            GL_COLOR_BUFFER_BIT, GL_NEAREST));
+    for (auto& rect : redrawnRegion)
+    {
+      auto left   = int(std::round(rect.left));
+      auto top    = int(std::round(rect.top));
+      auto right  = int(std::round(rect.right));
+      auto bottom = int(std::round(rect.bottom));
+
+      GLERR(glBlitFramebuffer(left, bottom, right, top,
+                              left, bottom, right, top,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST));
+    }
 
     // Clear the redrawn region for next time
     elementManager->ClearRedrawnRegion();
@@ -1048,10 +1043,13 @@ int main(void)
     {
       // 1/2 second timer tick (this is very haphazard: not a steady timer at all)
       ++tickCount;
-      timerText->UpdateAfterModify();
+      timerText->UpdateAfterContentChange();
       lastTickTime = glfwGetTime();
     }
 
+    // Arrange and draw whatever the events invalidated, such as the grid after
+    // its items change
+    elementManager->Flush();
 
     /* Update Display */
     display(window);
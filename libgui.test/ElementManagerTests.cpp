@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <functional>
+#include <thread>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -635,3 +636,471 @@ TEST(ElementManagerTests, WhenIdleTouchMovesOverControl_ControlIsNotSentNotifica
 
 }
 
+
+TEST(ElementManagerTests, WhenLayerArenaIsEnabled_ElementsAreAllocatedFromItUntilTheLayerIsRemoved)
+{
+  auto em = std::make_shared<ElementManager>();
+
+  auto layer = em->CreateLayerAbove(nullptr, LayerArena{4096});
+  std::weak_ptr<ElementArena> arena = layer->GetArena();
+  ASSERT_FALSE(arena.expired());
+
+  auto container = layer->CreateChild<Element>();
+  bool isDestroyed = false;
+  auto sc = container->CreateChild<StubControl>();
+  sc->SetDesctructorCallback([&isDestroyed]() { isDestroyed = true; });
+  sc = nullptr;
+  container = nullptr;
+
+  // The layer, the container and the control
+  ASSERT_EQ(3, arena.lock()->GetLiveAllocations());
+
+  em->RemoveLayer(layer);
+  ASSERT_EQ(true, isDestroyed);
+  ASSERT_FALSE(arena.expired());
+
+  layer = nullptr;
+  ASSERT_TRUE(arena.expired());
+}
+
+TEST(ElementManagerTests, WhenLayerArenaIsNotRequested_LayersHaveNoArena)
+{
+  auto em        = std::make_shared<ElementManager>();
+  auto transient = em->CreateLayerAbove(nullptr, LayerArena{4096});
+  auto above     = em->CreateLayerAbove(nullptr);
+  auto below     = em->CreateLayerBelow(transient);
+
+  // Only the layer which asked for an arena has one
+  ASSERT_NE(nullptr, transient->GetArena());
+  ASSERT_EQ(nullptr, above->GetArena());
+  ASSERT_EQ(nullptr, below->GetArena());
+
+  auto belowInArena = em->CreateLayerBelow(below, LayerArena{4096});
+  ASSERT_NE(nullptr, belowInArena->GetArena());
+  ASSERT_NE(transient->GetArena(), belowInArena->GetArena());
+}
+
+TEST(ElementManagerTests, WhenSiblingsAreModifiedInABatch_AncestorsAreDrawnOnce)
+{
+  auto em    = std::make_shared<ElementManager>();
+  auto layer = em->CreateLayerAbove(nullptr);
+  layer->SetArrangeCallback([](std::shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(300);
+  });
+
+  int layerDraws = 0;
+  layer->SetDrawCallback([&layerDraws](Element*, const boost::optional<Rect4>&) { ++layerDraws; });
+
+  const int cellCount = 300;
+  int cellArranges = 0;
+  std::vector<std::shared_ptr<Element>> cells;
+  for (int i = 0; i < cellCount; ++i)
+  {
+    auto cell = layer->CreateChild<Element>();
+    cell->SetArrangeCallback([i, &cellArranges](std::shared_ptr<Element> e) {
+      ++cellArranges;
+      e->SetLeft(0);
+      e->SetRight(100);
+      e->SetTop(i);
+      e->SetHeight(1);
+    });
+    cells.push_back(cell);
+  }
+  em->UpdateEverything();
+
+  layerDraws   = 0;
+  cellArranges = 0;
+
+  em->BeginBatch();
+  for (auto& cell : cells)
+  {
+    cell->UpdateAfterModify();
+    cell->UpdateAfterModify();
+  }
+  ASSERT_EQ(0, cellArranges);
+  em->Commit();
+
+  ASSERT_EQ(1, layerDraws);
+  ASSERT_EQ(cellCount, cellArranges);
+  ASSERT_FALSE(em->IsBatching());
+}
+
+TEST(ElementManagerTests, WhenAncestorIsModifiedInABatch_DescendantsAreStillArranged)
+{
+  auto em    = std::make_shared<ElementManager>();
+  auto layer = em->CreateLayerAbove(nullptr);
+  layer->SetArrangeCallback([](std::shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(10);
+    e->SetBottom(10);
+  });
+  auto container = layer->CreateChild<Element>();
+
+  int arranges = 0;
+  auto child = container->CreateChild<Element>();
+  child->SetArrangeCallback([&arranges](std::shared_ptr<Element>) { ++arranges; });
+  em->UpdateEverything();
+  arranges = 0;
+
+  em->BeginBatch();
+  child->UpdateAfterModify();
+  container->UpdateAfterModify();
+  em->Commit();
+
+  ASSERT_EQ(1, arranges);
+}
+
+TEST(ElementManagerTests, WhenCommitHasNoMatchingBeginBatch_ExceptionIsThrown)
+{
+  auto em = std::make_shared<ElementManager>();
+  ASSERT_THROW(em->Commit(), std::runtime_error);
+}
+
+TEST(ElementManagerTests, WhenElementMovesAcrossTheWindow_OnlyItsOldAndNewAreasAreRedrawn)
+{
+  auto em    = std::make_shared<ElementManager>();
+  auto layer = em->CreateLayerAbove(nullptr);
+  layer->SetArrangeCallback([](std::shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(1000);
+    e->SetBottom(1000);
+  });
+
+  double position = 0;
+  auto element = layer->CreateChild<Element>();
+  element->SetArrangeCallback([&position](std::shared_ptr<Element> e) {
+    e->SetLeft(position);
+    e->SetTop(position);
+    e->SetWidth(10);
+    e->SetHeight(10);
+  });
+  em->UpdateEverything();
+  em->ClearRedrawnRegion();
+
+  position = 990;
+  element->UpdateAfterModify();
+
+  Region expected;
+  expected.Union(Rect4(0, 0, 10, 10));
+  expected.Union(Rect4(990, 990, 1000, 1000));
+  ASSERT_EQ(expected, em->GetRedrawnRegion());
+}
+
+TEST(ElementManagerTests, WhenArrangingInParallel_ResultAndDrawOrderMatchSerialArrange)
+{
+  // Builds columns of cells below a layer which arranges its children in parallel,
+  // returning the indexes of the cells in the order they were drawn
+  auto arrangeAndDraw = [](size_t threadCount, std::vector<Rect4>& bounds) {
+    auto em = std::make_shared<ElementManager>();
+    em->SetArrangeThreadCount(threadCount);
+
+    std::vector<int> drawOrder;
+    std::vector<std::shared_ptr<Element>> cells;
+
+    auto layer = em->CreateLayerAbove(nullptr);
+    layer->SetArrangeChildrenInParallel(true);
+    layer->SetArrangeCallback([](std::shared_ptr<Element> e) {
+      e->SetLeft(0);
+      e->SetTop(0);
+      e->SetRight(200);
+      e->SetBottom(200);
+    });
+
+    for (int c = 0; c < 8; ++c)
+    {
+      auto column = layer->CreateChild<Element>();
+      column->SetArrangeCallback([c](std::shared_ptr<Element> e) {
+        e->SetLeft(c * 20);
+        e->SetWidth(20);
+        e->SetTop(e->GetParent()->GetTop());
+        e->SetBottom(e->GetParent()->GetBottom());
+      });
+
+      for (int r = 0; r < 10; ++r)
+      {
+        auto cell = column->CreateChild<Element>();
+        cell->SetArrangeCallback([r](std::shared_ptr<Element> e) {
+          auto p = e->GetParent();
+          e->SetLeft(p->GetLeft());
+          e->SetRight(p->GetRight());
+          e->SetTop(p->GetTop() + r * 20);
+          e->SetHeight(20);
+        });
+        auto index = int(cells.size());
+        cell->SetDrawCallback([index, &drawOrder](Element*, const boost::optional<Rect4>&) {
+          drawOrder.push_back(index);
+        });
+        cells.push_back(cell);
+      }
+    }
+
+    em->UpdateEverything();
+
+    bounds.clear();
+    for (auto& cell : cells)
+    {
+      bounds.push_back(cell->GetBounds());
+    }
+    return drawOrder;
+  };
+
+  std::vector<Rect4> serialBounds;
+  std::vector<Rect4> parallelBounds;
+  auto serialOrder   = arrangeAndDraw(0, serialBounds);
+  auto parallelOrder = arrangeAndDraw(3, parallelBounds);
+
+  ASSERT_EQ(80, serialOrder.size());
+  ASSERT_EQ(serialOrder, parallelOrder);
+  ASSERT_EQ(serialBounds, parallelBounds);
+  ASSERT_EQ(Rect4(140, 180, 160, 200), parallelBounds.back());
+}
+
+TEST(ElementManagerTests, WhenArrangingInParallel_ChildrenSeeTheEdgesTheParentLeftUnset)
+{
+  auto em = std::make_shared<ElementManager>();
+  em->SetArrangeThreadCount(4);
+
+  // The container sets only some of its edges, so the others are worked out
+  // when the children first ask for them
+  auto layer = em->CreateLayerAbove(nullptr);
+  layer->SetArrangeChildrenInParallel(true);
+  layer->SetArrangeCallback([](std::shared_ptr<Element> e) {
+    e->SetLeft(10);
+    e->SetWidth(200);
+    e->SetTop(20);
+    e->SetHeight(100);
+  });
+
+  // The children use the default arrangement, which fills the parent
+  std::vector<std::shared_ptr<Element>> children;
+  std::vector<std::shared_ptr<Element>> centered;
+  for (int i = 0; i < 64; ++i)
+  {
+    auto child = layer->CreateChild<Element>();
+    auto dot   = child->CreateChild<Element>();
+    dot->SetArrangeCallback([](std::shared_ptr<Element> e) {
+      auto p = e->GetParent();
+      e->SetCenterX(p->GetCenterX());
+      e->SetCenterY(p->GetCenterY());
+      e->SetWidth(2);
+      e->SetHeight(2);
+    });
+    children.push_back(child);
+    centered.push_back(dot);
+  }
+
+  // Each update arranges the container afresh, so give the children's tasks
+  // several chances to run at the same time
+  for (int pass = 0; pass < 20; ++pass)
+  {
+    em->UpdateEverything();
+  }
+
+  for (auto& child : children)
+  {
+    ASSERT_EQ(Rect4(10, 20, 210, 120), child->GetBounds());
+  }
+  for (auto& dot : centered)
+  {
+    ASSERT_EQ(Rect4(109, 69, 111, 71), dot->GetBounds());
+  }
+  ASSERT_EQ(Rect4(10, 20, 210, 120), layer->GetBounds());
+  ASSERT_FALSE(layer->GetNeedsArrange());
+
+  // Invalidating a child afterwards still reaches it through the container
+  children[5]->InvalidateArrange();
+  em->Flush();
+  ASSERT_FALSE(children[5]->GetNeedsArrange());
+  ASSERT_EQ(Rect4(10, 20, 210, 120), children[5]->GetBounds());
+}
+
+TEST(ElementManagerTests, WhenInvalidatedElementsAreFlushed_OnlyArrangeInvalidationsAreArranged)
+{
+  auto em    = std::make_shared<ElementManager>();
+  auto layer = em->CreateLayerAbove(nullptr);
+  layer->SetArrangeCallback([](std::shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+
+  int arranges = 0;
+  int draws    = 0;
+  auto label = layer->CreateChild<Element>();
+  label->SetArrangeCallback([&arranges](std::shared_ptr<Element> e) {
+    ++arranges;
+    e->SetLeft(10);
+    e->SetTop(10);
+    e->SetRight(50);
+    e->SetBottom(20);
+  });
+  label->SetDrawCallback([&draws](Element*, const boost::optional<Rect4>&) { ++draws; });
+
+  em->UpdateEverything();
+  arranges = 0;
+  draws    = 0;
+  em->ClearRedrawnRegion();
+
+  // Flushing with nothing invalidated does nothing
+  em->Flush();
+  ASSERT_EQ(0, draws);
+
+  label->InvalidateDraw();
+  label->InvalidateDraw();
+  ASSERT_TRUE(label->GetNeedsDraw());
+  em->Flush();
+  ASSERT_FALSE(label->GetNeedsDraw());
+  ASSERT_EQ(0, arranges);
+  ASSERT_EQ(1, draws);
+  ASSERT_EQ(Region(Rect4(10, 10, 50, 20)), em->GetRedrawnRegion());
+
+  label->InvalidateDraw();
+  label->InvalidateArrange();
+  em->Flush();
+  ASSERT_EQ(1, arranges);
+  ASSERT_EQ(2, draws);
+}
+
+TEST(ElementManagerTests, WhenWindowIsResized_OnlySizeDependentElementsAreRearranged)
+{
+  auto em = std::make_shared<ElementManager>();
+  em->SetSize(Size(100, 100));
+
+  auto layer = em->CreateLayerAbove(nullptr);
+  layer->SetArrangeCallback([](std::shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(1000);
+    e->SetBottom(1000);
+  });
+
+  // A panel which fills the window, with a child, beside a panel of a fixed size
+  int fillArranges  = 0;
+  int childArranges = 0;
+  int fixedArranges = 0;
+  auto fill = layer->CreateChild<Element>();
+  fill->SetArrangeDependsOnWindowSize(true);
+  fill->SetArrangeCallback([&fillArranges](std::shared_ptr<Element> e) {
+    ++fillArranges;
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(e->GetElementManager()->GetWidth());
+    e->SetBottom(e->GetElementManager()->GetHeight());
+  });
+  auto child = fill->CreateChild<Element>();
+  child->SetArrangeCallback([&childArranges](std::shared_ptr<Element> e) {
+    ++childArranges;
+    auto p = e->GetParent();
+    e->SetLeft(p->GetLeft());
+    e->SetTop(p->GetTop());
+    e->SetRight(p->GetRight());
+    e->SetBottom(p->GetBottom());
+  });
+  auto fixed = layer->CreateChild<Element>();
+  fixed->SetArrangeCallback([&fixedArranges](std::shared_ptr<Element> e) {
+    ++fixedArranges;
+    e->SetLeft(500);
+    e->SetTop(500);
+    e->SetRight(600);
+    e->SetBottom(600);
+  });
+
+  em->UpdateEverything();
+  fillArranges  = 0;
+  childArranges = 0;
+  fixedArranges = 0;
+
+  em->SetSize(Size(200, 150));
+  ASSERT_TRUE(fill->GetNeedsArrange());
+  em->Flush();
+
+  ASSERT_EQ(1, fillArranges);
+  ASSERT_EQ(1, childArranges);
+  ASSERT_EQ(0, fixedArranges);
+  ASSERT_EQ(Rect4(0, 0, 200, 150), child->GetBounds());
+}
+
+namespace
+{
+// Depends on the window size from the start, before it has been added to its parent
+class WindowSizedElement: public Element
+{
+public:
+  WindowSizedElement(Dependencies elementDependencies)
+    : Element(elementDependencies)
+  {
+    SetArrangeDependsOnWindowSize(true);
+  }
+};
+}
+
+TEST(ElementManagerTests, WhenWindowSizeDependenceIsToggled_OnlyCurrentDependentsAreRearranged)
+{
+  auto em    = std::make_shared<ElementManager>();
+  auto layer = em->CreateLayerAbove(nullptr);
+  layer->SetArrangeCallback([](std::shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+  em->SetSize(Size(100, 100));
+
+  auto toggled = layer->CreateChild<Element>();
+  for (int i = 0; i < 100; ++i)
+  {
+    toggled->SetArrangeDependsOnWindowSize(true);
+    toggled->SetArrangeDependsOnWindowSize(false);
+  }
+  auto constructed = layer->CreateChild<WindowSizedElement>();
+  em->UpdateEverything();
+
+  em->SetSize(Size(200, 100));
+  ASSERT_FALSE(toggled->GetNeedsArrange());
+  ASSERT_TRUE(constructed->GetNeedsArrange());
+  em->Flush();
+
+  toggled->SetArrangeDependsOnWindowSize(true);
+  toggled->SetArrangeDependsOnWindowSize(true);
+  constructed->SetArrangeDependsOnWindowSize(false);
+
+  em->SetSize(Size(300, 100));
+  ASSERT_TRUE(toggled->GetNeedsArrange());
+  ASSERT_FALSE(constructed->GetNeedsArrange());
+}
+
+TEST(ElementManagerTests, WhenActionsArePostedFromAnotherThread_TheyAreRunInOrderByRunPostedActions)
+{
+  auto em = std::make_shared<ElementManager>();
+  int posts = 0;
+  em->SetPostCallback([&posts] { ++posts; });
+
+  std::vector<int> run;
+  std::thread([em, &run] {
+    for (int i = 0; i < 3; ++i)
+    {
+      em->Post([&run, i] { run.push_back(i); });
+    }
+  }).join();
+
+  ASSERT_EQ(3, posts);
+  ASSERT_TRUE(run.empty());
+
+  ASSERT_EQ(3, em->RunPostedActions());
+  std::vector<int> expected = {0, 1, 2};
+  ASSERT_EQ(expected, run);
+
+  // Actions posted by an action are left for the next call
+  em->Post([em, &run] { em->Post([&run] { run.push_back(4); }); run.push_back(3); });
+  ASSERT_EQ(1, em->RunPostedActions());
+  ASSERT_EQ(1, em->RunPostedActions());
+  expected = {0, 1, 2, 3, 4};
+  ASSERT_EQ(expected, run);
+  ASSERT_EQ(0, em->RunPostedActions());
+}
@@ -3,6 +3,7 @@
 #include <libgui/ElementManager.h>
 #include <gtest/gtest.h>
 #include "libgui/Layer.h"
+#include "libgui/RasterDrawingContext.h"
 
 using namespace std;
 using namespace libgui;
@@ -32,6 +33,54 @@ private:
   function<void()> destructor_callback_;
 };
 
+// Counts what is drawn into it
+class CountingDrawingContext: public DrawingContext
+{
+public:
+  void FillRectangle(const Rect4&, const Color&) override
+  {
+    ++fills;
+  }
+
+  void OutlineRectangle(const Rect4&, const Color&, double) override
+  {
+    ++outlines;
+  }
+
+  void DrawLine(const Point&, const Point&, const Color&, double) override
+  {
+  }
+
+  void Custom(const Rect4&, const CustomDrawing&) override
+  {
+  }
+
+  void PushClip(const Rect4&) override
+  {
+    ++clips;
+  }
+
+  void PopClip() override
+  {
+    --clips;
+  }
+
+  void PushTranslation(const Point&) override
+  {
+    ++translations;
+  }
+
+  void PopTranslation() override
+  {
+    --translations;
+  }
+
+  int fills        = 0;
+  int outlines     = 0;
+  int clips        = 0;
+  int translations = 0;
+};
+
 TEST(ElementTests, WhenRemovingChildren_AllReferencesAreCleaned)
 {
   auto em   = make_shared<ElementManager>();
@@ -54,6 +103,498 @@ TEST(ElementTests, WhenRemovingChildren_AllReferencesAreCleaned)
   ASSERT_EQ(true, wasDestructed);
 }
 
+TEST(ElementTests, WhenChildIsAttached_TreeKeepsItAlive)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+
+  bool wasDestructed = false;
+  root->CreateChild<TestElement>()->SetDestructorCallback([&]() { wasDestructed = true; });
+
+  ASSERT_EQ(false, wasDestructed);
+  ASSERT_EQ(root, root->GetFirstChild()->GetParent());
+
+  root->RemoveChild(root->GetFirstChild());
+
+  ASSERT_EQ(true, wasDestructed);
+  ASSERT_EQ(nullptr, root->GetFirstChild());
+}
+
+TEST(ElementTests, WhenRemovedChildIsStillReferenced_ItOutlivesTheTree)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+
+  auto child1 = root->CreateChild<Element>();
+  auto child2 = root->CreateChild<Element>();
+  auto child3 = root->CreateChild<Element>();
+
+  root->RemoveChild(child2);
+
+  ASSERT_EQ(nullptr, child2->GetParent());
+  ASSERT_EQ(nullptr, child2->GetPrevSibling());
+  ASSERT_EQ(nullptr, child2->GetNextSibling());
+  ASSERT_EQ(child3, child1->GetNextSibling());
+  ASSERT_EQ(child1, child3->GetPrevSibling());
+  ASSERT_EQ(2, root->GetChildrenCount());
+}
+
+TEST(ElementTests, WhenVisitingDescendents_TemplateAndFunctionOverloadsAgree)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+
+  for (int i = 0; i < 3; ++i)
+  {
+    auto child = root->CreateChild<Element>();
+    child->CreateChild<Element>();
+    child->CreateChild<Element>()->CreateChild<Element>();
+  }
+
+  vector<Element*> fromTemplate;
+  root->VisitThisAndDescendents(
+    [&fromTemplate](Element* e) { fromTemplate.push_back(e); return true; },
+    [&fromTemplate](Element* e) { fromTemplate.push_back(e); });
+
+  vector<Element*> fromFunction;
+  function<bool(Element*)> pre = [&fromFunction](Element* e) { fromFunction.push_back(e); return true; };
+  function<void(Element*)> post = [&fromFunction](Element* e) { fromFunction.push_back(e); };
+  root->VisitThisAndDescendents(pre, post);
+
+  ASSERT_EQ(26, fromTemplate.size());
+  ASSERT_EQ(fromFunction, fromTemplate);
+
+  vector<Element*> ancestors;
+  auto deepest = root->GetLastChild()->GetLastChild()->GetFirstChild();
+  deepest->VisitAncestors([&ancestors](Element* e) { ancestors.push_back(e); });
+
+  ASSERT_EQ((vector<Element*>{root.get(), root->GetLastChild().get(), deepest->GetParent().get()}),
+            ancestors);
+}
+
+TEST(ElementTests, WhenVisitedChildIsRemovedByTheAction_VisitingCarriesOnWithTheNextChild)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+  root->SetLeft(0);
+  root->SetTop(0);
+  root->SetRight(100);
+  root->SetBottom(100);
+
+  auto addChildren = [&root] {
+    for (int i = 0; i < 4; ++i)
+    {
+      auto child = root->CreateChild<Element>();
+      child->SetLeft(0);
+      child->SetTop(i * 10);
+      child->SetRight(100);
+      child->SetBottom(i * 10 + 10);
+    }
+  };
+
+  // Nothing else refers to the children, so removing each one deletes it
+  int visited = 0;
+  addChildren();
+  root->VisitChildren([&](Element*) {
+    ++visited;
+    root->RemoveChild(root->GetFirstChild());
+  });
+  ASSERT_EQ(4, visited);
+  ASSERT_EQ(0, root->GetChildrenCount());
+
+  visited = 0;
+  addChildren();
+  root->VisitChildren(Rect4(0, 0, 100, 100), [&](Element*) {
+    ++visited;
+    root->RemoveChild(root->GetFirstChild());
+    return true;
+  });
+  ASSERT_EQ(4, visited);
+  ASSERT_EQ(0, root->GetChildrenCount());
+
+  visited = 0;
+  addChildren();
+  root->VisitLastChildren(Rect4(0, 0, 100, 100), [&](Element*) {
+    ++visited;
+    root->RemoveChild(root->GetLastChild());
+    return true;
+  });
+  ASSERT_EQ(4, visited);
+  ASSERT_EQ(0, root->GetChildrenCount());
+
+  visited = 0;
+  addChildren();
+  root->VisitChildrenWithTotalBounds(Rect4(0, 0, 100, 100), [&](Element*) {
+    ++visited;
+    root->RemoveChild(root->GetFirstChild());
+    return true;
+  });
+  ASSERT_EQ(4, visited);
+  ASSERT_EQ(0, root->GetChildrenCount());
+}
+
+TEST(ElementTests, WhenTreeIsVeryDeep_TraversalsDoNotOverflowTheStack)
+{
+  const int depth = 200000;
+
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+  root->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+
+  shared_ptr<Element> deepest = root;
+  for (int i = 0; i < depth; ++i)
+  {
+    deepest = deepest->CreateChild<Element>();
+  }
+  deepest->SetConsumesInput(true);
+
+  em->UpdateEverything();
+
+  int visited = 0;
+  root->VisitThisAndDescendents([&visited](Element*) { ++visited; });
+  ASSERT_EQ(depth + 1, visited);
+
+  auto info = root->GetElementAtPoint(Point{50, 50});
+  ASSERT_EQ(deepest.get(), info.ElementAtPoint);
+
+  FuzzyHitQuery query;
+  root->GetElementInRect(Rect4(40, 40, 60, 60), query);
+  ASSERT_EQ(deepest.get(), query.MaxMatchingElement.ElementAtPoint);
+
+  int ancestors = 0;
+  deepest->VisitAncestors([&ancestors](Element*) { ++ancestors; });
+  ASSERT_EQ(depth, ancestors);
+
+  bool wasDestructed = false;
+  auto deepestTest = deepest->CreateChild<TestElement>();
+  deepestTest->SetDestructorCallback([&]() { wasDestructed = true; });
+  deepestTest = nullptr;
+  deepest     = nullptr;
+
+  root->RemoveChildren(Element::UpdateWhenRemoving::No);
+  ASSERT_EQ(true, wasDestructed);
+}
+
+TEST(ElementTests, WhenContainerHasManySiblings_OverlapRegistrationDoesNotOverflowTheStack)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+
+  auto first = root->CreateChild<Element>();
+  for (int i = 0; i < 200000; ++i)
+  {
+    root->CreateChild<Element>();
+  }
+
+  auto last = root->GetLastChild();
+  ASSERT_TRUE(first->ThisIsEarlierSiblingOf(last.get()));
+  ASSERT_FALSE(last->ThisIsEarlierSiblingOf(first.get()));
+
+  first->RegisterOverlappingElement(last);
+
+  vector<Element*> overlapping;
+  first->VisitOverlappingElements([&overlapping](Element* e) { overlapping.push_back(e); });
+  ASSERT_EQ(vector<Element*>{last.get()}, overlapping);
+
+  root->RemoveChildren(Element::UpdateWhenRemoving::No);
+}
+
+TEST(ElementTests, WhenRarelyUsedDataIsNotSet_DefaultsAreReturned)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+
+  auto child = root->CreateChild<Element>();
+  child->SetLeft(10);
+  child->SetTop(20);
+  child->SetRight(30);
+  child->SetBottom(40);
+
+  ASSERT_FALSE(child->GetVisualBounds());
+  ASSERT_EQ(Rect4(), child->GetTouchMargin());
+  ASSERT_EQ(Rect4(10, 20, 30, 40), child->GetTotalBounds());
+
+  child->SetVisualBounds(Rect4(5, 15, 35, 45));
+  child->SetTouchMargin(Rect4(1, 2, 3, 4));
+
+  ASSERT_EQ(Rect4(5, 15, 35, 45), child->GetTotalBounds());
+  ASSERT_EQ(Rect4(1, 2, 3, 4), child->GetTouchMargin());
+
+  child->SetVisualBounds(boost::none);
+  ASSERT_EQ(Rect4(10, 20, 30, 40), child->GetTotalBounds());
+}
+
+TEST(ElementTests, WhenDescendentDrawsOutsideItsParent_SubtreeBoundsIncludeIt)
+{
+  auto em    = make_shared<ElementManager>();
+  auto layer = em->CreateLayerAbove(nullptr);
+
+  auto container = layer->CreateChild<Element>();
+  container->SetLeft(0);
+  container->SetTop(0);
+  container->SetRight(10);
+  container->SetBottom(10);
+
+  auto child = container->CreateChild<Element>();
+  child->SetLeft(0);
+  child->SetTop(0);
+  child->SetRight(10);
+  child->SetBottom(10);
+  ASSERT_EQ(Rect4(0, 0, 10, 10), container->GetSubtreeBounds());
+
+  child->SetVisualBounds(Rect4(50, 50, 60, 60));
+  ASSERT_EQ(Rect4(0, 0, 60, 60), container->GetSubtreeBounds());
+
+  child->SetIsVisible(false);
+  ASSERT_EQ(Rect4(0, 0, 10, 10), container->GetSubtreeBounds());
+}
+
+TEST(ElementTests, WhenNestedElementIsUpdated_AncestorClipsArePushedOnceAndFollowMoves)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+  root->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+
+  vector<Rect4> pushedClips;
+  em->SetPushClipCallback([&pushedClips](const Rect4& clip) { pushedClips.push_back(clip); });
+
+  double outerLeft = 0;
+  auto outer = root->CreateChild<Element>();
+  outer->SetClipToBounds(true);
+  outer->SetArrangeCallback([&outerLeft](shared_ptr<Element> e) {
+    e->SetLeft(outerLeft);
+    e->SetTop(0);
+    e->SetWidth(50);
+    e->SetHeight(50);
+  });
+
+  auto inner = outer->CreateChild<Element>();
+  inner->SetClipToBounds(true);
+  inner->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(25);
+    e->SetTop(25);
+    e->SetRight(75);
+    e->SetBottom(75);
+  });
+
+  auto leaf = inner->CreateChild<Element>();
+  leaf->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(30);
+    e->SetTop(30);
+    e->SetRight(40);
+    e->SetBottom(40);
+  });
+
+  em->UpdateEverything();
+
+  // The redraw region is followed by the combined clip of both ancestors
+  pushedClips.clear();
+  leaf->UpdateAfterModify();
+  ASSERT_LE(2u, pushedClips.size());
+  ASSERT_EQ(Rect4(30, 30, 40, 40), pushedClips[0]);
+  ASSERT_EQ(Rect4(25, 25, 50, 50), pushedClips[1]);
+
+  outerLeft = 10;
+  outer->UpdateAfterModify();
+
+  pushedClips.clear();
+  leaf->UpdateAfterModify();
+  ASSERT_EQ(Rect4(25, 25, 60, 50), pushedClips[1]);
+
+  // An ancestor which stops clipping no longer contributes
+  outer->SetClipToBounds(false);
+  pushedClips.clear();
+  leaf->UpdateAfterModify();
+  ASSERT_LE(2u, pushedClips.size());
+  ASSERT_EQ(Rect4(25, 25, 75, 75), pushedClips[1]);
+}
+
+TEST(ElementTests, WhenElementsAreOutsideTheClipOrWindow_TheyAreArrangedButNotDrawn)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+  root->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(200);
+    e->SetBottom(300);
+  });
+
+  // A clipping panel with rows which extend well below it
+  auto panel = root->CreateChild<Element>();
+  panel->SetClipToBounds(true);
+  panel->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+
+  int arranged = 0;
+  int drawn    = 0;
+  for (int r = 0; r < 10; ++r)
+  {
+    auto row = panel->CreateChild<Element>();
+    row->SetArrangeCallback([r, &arranged](shared_ptr<Element> e) {
+      ++arranged;
+      e->SetLeft(0);
+      e->SetTop(r * 30);
+      e->SetRight(100);
+      e->SetHeight(20);
+    });
+    row->SetDrawCallback([&drawn](Element*, const boost::optional<Rect4>&) { ++drawn; });
+  }
+
+  // An element beside the panel which is only partly inside the window
+  auto side = root->CreateChild<Element>();
+  side->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(150);
+    e->SetTop(0);
+    e->SetRight(200);
+    e->SetBottom(300);
+  });
+  int sideDrawn = 0;
+  side->SetDrawCallback([&sideDrawn](Element*, const boost::optional<Rect4>&) { ++sideDrawn; });
+
+  em->UpdateEverything();
+  ASSERT_EQ(10, arranged);
+  ASSERT_EQ(4, drawn);
+  ASSERT_EQ(1, sideDrawn);
+
+  em->SetSize(Size(120, 50));
+  arranged = 0;
+  drawn    = 0;
+  em->UpdateEverything();
+  ASSERT_EQ(10, arranged);
+  ASSERT_EQ(2, drawn);
+  ASSERT_EQ(1, sideDrawn);
+}
+
+TEST(ElementTests, WhenRedrawRegionOnlyMeetsADescendentsVisualBounds_TheDescendentIsRedrawn)
+{
+  auto em = make_shared<ElementManager>();
+
+  auto lower = em->CreateLayerAbove(nullptr);
+  lower->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+
+  auto container = lower->CreateChild<Element>();
+  container->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(10);
+    e->SetBottom(10);
+  });
+
+  int childDraws = 0;
+  auto child = container->CreateChild<Element>();
+  child->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(10);
+    e->SetBottom(10);
+    e->SetVisualBounds(Rect4(50, 50, 60, 60));
+  });
+  child->SetDrawCallback([&childDraws](Element*, const boost::optional<Rect4>&) { ++childDraws; });
+
+  auto upper = em->CreateLayerAbove(lower);
+  upper->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+  auto overlay = upper->CreateChild<Element>();
+  overlay->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(52);
+    e->SetTop(52);
+    e->SetRight(58);
+    e->SetBottom(58);
+  });
+
+  em->UpdateEverything();
+  childDraws = 0;
+
+  // Updating the overlay redraws the lower layer within the overlay's bounds
+  overlay->UpdateAfterModify();
+  ASSERT_EQ(1, childDraws);
+}
+
+TEST(ElementTests, WhenRecordedElementIsOnlyRedrawn_ItsDisplayListIsReplayed)
+{
+  auto em      = make_shared<ElementManager>();
+  auto context = make_shared<CountingDrawingContext>();
+  em->SetDrawingContext(context);
+
+  auto lower = em->CreateLayerAbove(nullptr);
+  lower->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+
+  int recordings = 0;
+  auto element = lower->CreateChild<Element>();
+  element->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(50);
+    e->SetBottom(50);
+  });
+  element->SetRecordedDrawCallback([&recordings](Element* e, DrawingContext& dc) {
+    ++recordings;
+    dc.FillRectangle(e->GetBounds(), Color{255, 0, 0, 255});
+    dc.OutlineRectangle(Rect4(40, 40, 50, 50), Color{0, 0, 0, 255}, 1);
+  });
+
+  auto upper = em->CreateLayerAbove(lower);
+  upper->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+  auto overlay = upper->CreateChild<Element>();
+  overlay->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(10);
+    e->SetTop(10);
+    e->SetRight(20);
+    e->SetBottom(20);
+  });
+
+  em->UpdateEverything();
+  ASSERT_EQ(1, recordings);
+  ASSERT_EQ(1, context->fills);
+  ASSERT_EQ(1, context->outlines);
+
+  // Redrawing the lower layer under the overlay replays only what intersects it
+  overlay->UpdateAfterModify();
+  ASSERT_EQ(1, recordings);
+  ASSERT_EQ(2, context->fills);
+  ASSERT_EQ(1, context->outlines);
+  ASSERT_EQ(0, context->clips);
+
+  // Modifying the element itself records it again
+  element->UpdateAfterModify();
+  ASSERT_EQ(2, recordings);
+  ASSERT_EQ(3, context->fills);
+}
+
 TEST(ElementTests, WhenElementDisabled_ChildControlsDisabledAlso)
 {
   auto em   = make_shared<ElementManager>();
@@ -78,4 +619,427 @@ TEST(ElementTests, WhenElementDisabled_ChildControlsDisabledAlso)
   ASSERT_EQ(child.get(), queryInfo.ElementAtPoint);
   ASSERT_EQ(true, queryInfo.HasDisabledAncestor);
 
-}
\ No newline at end of file
+}
+TEST(ElementTests, WhenChildIndexEnabled_LastOverlappingChildIsFound)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+  root->SetUsesChildIndex(true);
+
+  root->SetLeft(0);
+  root->SetTop(0);
+  root->SetRight(1000);
+  root->SetBottom(1000);
+
+  // A 10 x 10 arrangement of children, plus one that covers all of them
+  vector<shared_ptr<Element>> children;
+  for (int i = 0; i < 100; ++i)
+  {
+    auto child = root->CreateChild<Element>();
+    child->SetConsumesInput(true);
+    child->SetLeft((i % 10) * 100);
+    child->SetTop((i / 10) * 100);
+    child->SetWidth(90);
+    child->SetHeight(90);
+    children.push_back(child);
+  }
+
+  ASSERT_EQ(children[0].get(), root->GetElementAtPoint(Point{5, 5}).ElementAtPoint);
+  ASSERT_EQ(children[57].get(), root->GetElementAtPoint(Point{750, 550}).ElementAtPoint);
+
+  // Points in the gaps between children fall through to the root
+  ASSERT_EQ(root.get(), root->GetElementAtPoint(Point{95, 95}).ElementAtPoint);
+
+  auto cover = root->CreateChild<Element>();
+  cover->SetConsumesInput(true);
+  cover->SetLeft(0);
+  cover->SetTop(0);
+  cover->SetRight(1000);
+  cover->SetBottom(1000);
+
+  // The last child wins since it is drawn on top
+  ASSERT_EQ(cover.get(), root->GetElementAtPoint(Point{750, 550}).ElementAtPoint);
+
+  root->RemoveChild(cover);
+
+  ASSERT_EQ(children[57].get(), root->GetElementAtPoint(Point{750, 550}).ElementAtPoint);
+}
+
+TEST(ElementTests, WhenChildIndexEnabled_RegionVisitsMatchBruteForce)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+
+  for (int i = 0; i < 400; ++i)
+  {
+    auto child = root->CreateChild<Element>();
+    child->SetLeft((i * 37) % 500);
+    child->SetTop((i * 53) % 500);
+    child->SetWidth(20 + i % 30);
+    child->SetHeight(20 + i % 17);
+  }
+
+  auto collect = [&root](const Rect4& region) {
+    vector<Element*> first, last;
+    root->VisitChildren(region, [&first](Element* e) { first.push_back(e); return true; });
+    root->VisitLastChildren(region, [&last](Element* e) { last.push_back(e); return true; });
+    return make_pair(first, last);
+  };
+
+  vector<Rect4> regions = {Rect4(0, 0, 10, 10), Rect4(100, 120, 260, 140),
+                           Rect4(-50, -50, 600, 600), Rect4(490, 0, 520, 520)};
+
+  for (auto& region : regions)
+  {
+    root->SetUsesChildIndex(false);
+    auto expected = collect(region);
+
+    root->SetUsesChildIndex(true);
+    auto actual = collect(region);
+
+    ASSERT_EQ(expected.first, actual.first);
+    ASSERT_EQ(expected.second, actual.second);
+  }
+}
+
+TEST(ElementTests, WhenChildIndexEnabledForListOfRows_QueriesMatchBruteForce)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+
+  // Full width rows, as in a list, which span the whole width of the index
+  vector<shared_ptr<Element>> rows;
+  for (int i = 0; i < 5000; ++i)
+  {
+    auto row = root->CreateChild<Element>();
+    row->SetLeft(0);
+    row->SetTop(i * 20);
+    row->SetWidth(800);
+    row->SetHeight(20);
+    rows.push_back(row);
+  }
+
+  auto collect = [&root](const Rect4& region) {
+    vector<Element*> visited;
+    root->VisitChildren(region, [&visited](Element* e) { visited.push_back(e); return true; });
+    return visited;
+  };
+
+  vector<Rect4> regions = {Rect4(0, 0, 10, 10), Rect4(300, 40010, 500, 40100),
+                           Rect4(790, 99990, 900, 100100), Rect4(-10, 50000, 810, 50000)};
+
+  for (auto& region : regions)
+  {
+    root->SetUsesChildIndex(false);
+    auto expected = collect(region);
+
+    root->SetUsesChildIndex(true);
+    auto actual = collect(region);
+
+    ASSERT_EQ(expected, actual);
+  }
+
+  ASSERT_EQ(rows[2500].get(), root->FindLastChild(Point{400, 50010}));
+}
+
+TEST(ElementTests, WhenChildIndexEnabledAndChildrenAreRearranged_QueriesMatchBruteForce)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+  root->SetUsesChildIndex(true);
+  root->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(1000);
+    e->SetBottom(1000);
+  });
+
+  // Each child is arranged at a position which can be changed afterwards
+  vector<Point> positions;
+  vector<shared_ptr<Element>> children;
+  for (int i = 0; i < 400; ++i)
+  {
+    positions.push_back(Point{double((i % 20) * 50), double((i / 20) * 50)});
+    auto child = root->CreateChild<Element>();
+    child->SetArrangeCallback([&positions, i](shared_ptr<Element> e) {
+      e->SetLeft(positions[i].X);
+      e->SetTop(positions[i].Y);
+      e->SetWidth(40);
+      e->SetHeight(40);
+    });
+    children.push_back(child);
+  }
+  em->UpdateEverything();
+
+  // The index is kept between queries, so the expected results are found by
+  // searching the children directly
+  auto expectMatchesBruteForce = [&](const Point& point, const Rect4& region) {
+    Element* expectedAtPoint = nullptr;
+    vector<Element*> expectedInRegion;
+    for (auto e = root->GetLastChild(); e; e = e->GetPrevSibling())
+    {
+      if (!expectedAtPoint && e->Intersects(point))
+      {
+        expectedAtPoint = e.get();
+      }
+      if (e->Intersects(region))
+      {
+        expectedInRegion.push_back(e.get());
+      }
+    }
+
+    vector<Element*> inRegion;
+    root->VisitLastChildren(region, [&inRegion](Element* e) { inRegion.push_back(e); return true; });
+
+    ASSERT_EQ(expectedAtPoint, root->FindLastChild(point));
+    ASSERT_EQ(expectedInRegion, inRegion);
+  };
+
+  expectMatchesBruteForce(Point{5, 5}, Rect4(0, 0, 10, 10));
+
+  // Children are moved one at a time, within the area of the others and then
+  // beyond it, and found in their new places
+  for (int step = 0; step < 30; ++step)
+  {
+    auto i = (step * 37) % 400;
+    positions[i] = step < 20 ? Point{double((step * 53) % 960), double((step * 29) % 960)}
+                             : Point{1100.0 + step, 900.0};
+    children[i]->UpdateAfterModify();
+
+    auto& p = positions[i];
+    expectMatchesBruteForce(Point{p.X + 20, p.Y + 20}, Rect4(p.X - 30, p.Y - 30, p.X + 70, p.Y + 70));
+  }
+
+  // Translating a child moves it in the index as well
+  children[5]->SetTranslation(Point{0, 500});
+  expectMatchesBruteForce(Point{270, 520}, Rect4(200, 450, 400, 600));
+  expectMatchesBruteForce(Point{270, 20}, Rect4(200, 0, 400, 60));
+}
+
+TEST(ElementTests, WhenContentChanges_ElementIsRedrawnWithoutArranging)
+{
+  auto em   = make_shared<ElementManager>();
+  auto root = em->CreateLayerAbove(nullptr);
+  root->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+
+  int arranges = 0;
+  auto label = root->CreateChild<Element>();
+  label->SetArrangeCallback([&arranges](shared_ptr<Element> e) {
+    ++arranges;
+    e->SetLeft(10);
+    e->SetTop(10);
+    e->SetRight(60);
+    e->SetBottom(20);
+  });
+
+  int value = 1;
+  auto context = make_shared<CountingDrawingContext>();
+  em->SetDrawingContext(context);
+  label->SetRecordedDrawCallback([&value](Element* e, DrawingContext& dc) {
+    for (int i = 0; i < value; ++i)
+    {
+      dc.FillRectangle(e->GetBounds(), Color{0, 0, 0, 255});
+    }
+  });
+
+  // An element later in z-order which overlaps the label is drawn on top again
+  int overlayDraws = 0;
+  auto overlay = root->CreateChild<Element>();
+  overlay->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(50);
+    e->SetTop(0);
+    e->SetRight(70);
+    e->SetBottom(30);
+  });
+  overlay->SetDrawCallback([&overlayDraws](Element*, const boost::optional<Rect4>&) { ++overlayDraws; });
+  label->RegisterOverlappingElement(overlay);
+
+  em->UpdateEverything();
+  arranges     = 0;
+  overlayDraws = 0;
+  context->fills = 0;
+  em->ClearRedrawnRegion();
+
+  value = 2;
+  label->UpdateAfterContentChange();
+
+  ASSERT_EQ(0, arranges);
+  ASSERT_EQ(2, context->fills);
+  ASSERT_EQ(1, overlayDraws);
+  ASSERT_EQ(Region(Rect4(10, 10, 60, 20)), em->GetRedrawnRegion());
+}
+
+TEST(ElementTests, WhenSubtreeIsTranslated_DescendentsMoveWithoutBeingRearranged)
+{
+  auto em      = make_shared<ElementManager>();
+  auto context = make_shared<RasterDrawingContext>(100, 100);
+  em->SetDrawingContext(context);
+
+  const Color white{255, 255, 255, 255};
+  const Color blue{0, 0, 255, 255};
+
+  auto root = em->CreateLayerAbove(nullptr);
+  root->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+  root->SetRecordedDrawCallback([white](Element* e, DrawingContext& dc) {
+    dc.FillRectangle(e->GetBounds(), white);
+  });
+
+  int panelArranges = 0;
+  auto panel = root->CreateChild<Element>();
+  panel->SetClipToBounds(true);
+  panel->SetArrangeCallback([&panelArranges](shared_ptr<Element> e) {
+    ++panelArranges;
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(50);
+    e->SetBottom(50);
+  });
+
+  // The item draws beyond the right edge of the panel, which clips it
+  int itemArranges = 0;
+  auto item = panel->CreateChild<Element>();
+  item->SetConsumesInput(true);
+  item->SetArrangeCallback([&itemArranges](shared_ptr<Element> e) {
+    ++itemArranges;
+    e->SetLeft(e->GetParent()->GetLeft() + 10);
+    e->SetTop(e->GetParent()->GetTop() + 10);
+    e->SetWidth(10);
+    e->SetHeight(10);
+  });
+  item->SetRecordedDrawCallback([blue](Element* e, DrawingContext& dc) {
+    dc.FillRectangle(Rect4(e->GetLeft(), e->GetTop(), e->GetLeft() + 70, e->GetBottom()), blue);
+  });
+
+  em->UpdateEverything();
+  ASSERT_EQ(blue, context->GetPixel(15, 15));
+  ASSERT_EQ(blue, context->GetPixel(45, 15));
+  ASSERT_EQ(white, context->GetPixel(55, 15));
+  ASSERT_EQ(item.get(), root->GetElementAtPoint(Point{15, 15}).ElementAtPoint);
+
+  // Moving the panel by its translation only arranges the panel itself, and
+  // redraws the area covering where it was and where it is now
+  panelArranges = 0;
+  itemArranges  = 0;
+  em->ClearRedrawnRegion();
+  panel->SetTranslation(Point{40, 30});
+  panel->UpdateAfterModify();
+
+  ASSERT_EQ(1, panelArranges);
+  ASSERT_EQ(0, itemArranges);
+  ASSERT_EQ(Rect4(10, 10, 20, 20), item->GetBounds());
+
+  ASSERT_EQ(Region(Rect4(0, 0, 90, 80)), em->GetRedrawnRegion());
+
+  ASSERT_EQ(white, context->GetPixel(15, 15));
+  ASSERT_EQ(blue, context->GetPixel(55, 45));
+  ASSERT_EQ(blue, context->GetPixel(85, 45));
+  ASSERT_EQ(white, context->GetPixel(95, 45));
+
+  // Hit testing and the ancestor clips follow the translation
+  ASSERT_NE(item.get(), root->GetElementAtPoint(Point{15, 15}).ElementAtPoint);
+  ASSERT_EQ(item.get(), root->GetElementAtPoint(Point{55, 45}).ElementAtPoint);
+  ASSERT_TRUE(item->Intersects(Point{15, 15}));
+  ASSERT_FALSE(panel->Intersects(Point{15, 15}));
+
+  FuzzyHitQuery query;
+  ASSERT_TRUE(root->GetElementInRect(Rect4(50, 40, 60, 50), query));
+  ASSERT_EQ(item.get(), query.MaxMatchingElement.ElementAtPoint);
+  ASSERT_EQ(1, query.MaxMatchingPercent);
+
+  // Moving it back without arranging at all
+  panelArranges = 0;
+  panel->SetTranslation(Point{0, 0});
+  panel->InvalidateDraw();
+  em->Flush();
+
+  ASSERT_EQ(0, panelArranges);
+  ASSERT_EQ(0, itemArranges);
+  ASSERT_EQ(blue, context->GetPixel(15, 15));
+  ASSERT_EQ(white, context->GetPixel(55, 45));
+
+  // An update of the item alone redraws its bounds within the panel's translation
+  panel->SetTranslation(Point{40, 30});
+  panel->InvalidateDraw();
+  em->Flush();
+  context->Clear(white);
+  em->ClearRedrawnRegion();
+  item->UpdateAfterContentChange();
+
+  ASSERT_EQ(Region(Rect4(50, 40, 60, 50)), em->GetRedrawnRegion());
+  ASSERT_EQ(blue, context->GetPixel(55, 45));
+  ASSERT_EQ(white, context->GetPixel(65, 45));
+  ASSERT_EQ(white, context->GetPixel(15, 15));
+}
+
+TEST(ElementTests, WhenTranslatedElementIsOutsideTheWindow_ItsVisibleChildrenAreStillTranslated)
+{
+  auto em = make_shared<ElementManager>();
+  em->SetSize(Size(100, 100));
+
+  // A backend that only has the translation callbacks
+  Point translation{0, 0};
+  std::vector<Point> pushed;
+  em->SetPushTranslationCallback([&translation, &pushed](const Point& offset) {
+    pushed.push_back(offset);
+    translation.X += offset.X;
+    translation.Y += offset.Y;
+  });
+  em->SetPopTranslationCallback([&translation, &pushed] {
+    translation.X -= pushed.back().X;
+    translation.Y -= pushed.back().Y;
+    pushed.pop_back();
+  });
+
+  auto root = em->CreateLayerAbove(nullptr);
+  root->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+
+  // The panel itself is arranged past the right edge of the window and only its
+  // child is moved back into view by the translation
+  int panelDraws = 0;
+  auto panel = root->CreateChild<Element>();
+  panel->SetTranslation(Point{-150, 0});
+  panel->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(300);
+    e->SetTop(0);
+    e->SetRight(310);
+    e->SetBottom(10);
+  });
+  panel->SetDrawCallback([&panelDraws](Element*, const boost::optional<Rect4>&) { ++panelDraws; });
+
+  int childDraws = 0;
+  Point childTranslation{0, 0};
+  auto child = panel->CreateChild<Element>();
+  child->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(160);
+    e->SetTop(0);
+    e->SetRight(170);
+    e->SetBottom(10);
+  });
+  child->SetDrawCallback([&childDraws, &childTranslation, &translation](Element*, const boost::optional<Rect4>&) {
+    ++childDraws;
+    childTranslation = translation;
+  });
+
+  em->UpdateEverything();
+
+  ASSERT_EQ(0, panelDraws);
+  ASSERT_EQ(1, childDraws);
+  ASSERT_EQ(-150, childTranslation.X);
+  ASSERT_EQ(0, childTranslation.Y);
+  ASSERT_TRUE(pushed.empty());
+}
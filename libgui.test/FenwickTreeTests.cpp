@@ -0,0 +1,141 @@
+#include "libgui/FenwickTree.h"
+
+#include <random>
+#include <gtest/gtest.h>
+
+using namespace libgui;
+using namespace std;
+
+namespace
+{
+void ExpectMatchesValues(const FenwickTree& tree, const vector<double>& values)
+{
+  ASSERT_EQ(int(values.size()), tree.GetSize());
+
+  double sum = 0;
+  for (int i = 0; i < int(values.size()); ++i)
+  {
+    ASSERT_EQ(values[i], tree.Get(i));
+    ASSERT_DOUBLE_EQ(sum, tree.GetPrefixSum(i)) << i;
+    sum += values[i];
+  }
+  ASSERT_DOUBLE_EQ(sum, tree.GetTotal());
+}
+}
+
+TEST(FenwickTreeTests, WhenValuesAreSet_PrefixSumsMatchBruteForce)
+{
+  mt19937 random(7);
+  vector<double> values(1000, 20.0);
+
+  FenwickTree tree;
+  tree.Assign(1000, 20.0);
+  ExpectMatchesValues(tree, values);
+
+  for (int i = 0; i < 2000; ++i)
+  {
+    auto index = int(random() % values.size());
+    values[index] = double(random() % 100);
+    tree.Set(index, values[index]);
+  }
+  ExpectMatchesValues(tree, values);
+}
+
+TEST(FenwickTreeTests, FindIndex_MatchesLinearSearch)
+{
+  // Some values are zero, which are never found since they span no offsets
+  vector<double> values = {10, 0, 25, 5, 0, 0, 40, 15, 30, 0, 20};
+  FenwickTree tree;
+  tree.Assign(int(values.size()), 0.0);
+  for (int i = 0; i < int(values.size()); ++i)
+  {
+    tree.Set(i, values[i]);
+  }
+
+  for (double offset = -10; offset < 220; offset += 2.5)
+  {
+    int    expected = int(values.size()) - 1;
+    double top      = 0;
+    for (int i = 0; i < int(values.size()); ++i)
+    {
+      if (offset < top + values[i])
+      {
+        expected = i;
+        break;
+      }
+      top += values[i];
+    }
+    ASSERT_EQ(expected, tree.FindIndex(offset)) << offset;
+  }
+}
+
+TEST(FenwickTreeTests, WhenValuesAreInsertedRemovedOrMoved_SumsFollow)
+{
+  vector<double> values = {1, 2, 3, 4, 5, 6, 7, 8};
+  FenwickTree tree;
+  tree.Assign(8, 0.0);
+  for (int i = 0; i < 8; ++i)
+  {
+    tree.Set(i, values[i]);
+  }
+
+  tree.Insert(3, 2, 10);
+  values.insert(values.begin() + 3, 2, 10);
+  ExpectMatchesValues(tree, values);
+
+  tree.Remove(0, 4);
+  values.erase(values.begin(), values.begin() + 4);
+  ExpectMatchesValues(tree, values);
+
+  // {10, 4, 5, 6, 7, 8} becomes {5, 6, 10, 4, 7, 8} and back again
+  tree.Move(0, 2, 2);
+  ExpectMatchesValues(tree, {5, 6, 10, 4, 7, 8});
+  tree.Move(2, 2, 0);
+  ExpectMatchesValues(tree, values);
+
+  ASSERT_THROW(tree.Remove(4, 3), runtime_error);
+  ASSERT_THROW(tree.Insert(7, 1, 0), runtime_error);
+}
+
+TEST(FenwickTreeTests, WhenValuesAreAppendedOrRemovedFromTheEnd_SumsFollow)
+{
+  mt19937 random(11);
+  vector<double> values;
+  FenwickTree tree;
+
+  // Appending to an empty tree, in batches of different sizes, with values set between them
+  for (int batch = 0; batch < 50; ++batch)
+  {
+    auto count = int(random() % 40);
+    auto value = double(random() % 100);
+    tree.Insert(tree.GetSize(), count, value);
+    values.insert(values.end(), count, value);
+
+    if (!values.empty())
+    {
+      auto index = int(random() % values.size());
+      values[index] = double(random() % 100);
+      tree.Set(index, values[index]);
+    }
+    ExpectMatchesValues(tree, values);
+  }
+
+  // The offsets are still found across the whole of the appended values
+  double top = 0;
+  for (int i = 0; i < int(values.size()); ++i)
+  {
+    if (values[i] > 0)
+    {
+      ASSERT_EQ(i, tree.FindIndex(top + values[i] / 2)) << i;
+    }
+    top += values[i];
+  }
+
+  tree.Remove(tree.GetSize() - 25, 25);
+  values.resize(values.size() - 25);
+  ExpectMatchesValues(tree, values);
+
+  tree.Insert(tree.GetSize(), 3, 7);
+  values.insert(values.end(), 3, 7);
+  ExpectMatchesValues(tree, values);
+}
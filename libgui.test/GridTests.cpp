@@ -0,0 +1,652 @@
+#include "libgui/ElementManager.h"
+#include "libgui/Grid.h"
+#include "libgui/IndexedItemsProvider.h"
+#include "libgui/Layer.h"
+#include "libgui/RasterDrawingContext.h"
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <set>
+#include <thread>
+#include <gtest/gtest.h>
+
+using namespace libgui;
+using namespace std;
+
+namespace
+{
+class StubItemsProvider: public ItemsProvider
+{
+public:
+  explicit StubItemsProvider(int count)
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      _items.push_back(make_shared<ViewModelBase>());
+    }
+  }
+
+  int GetTotalItems() override
+  {
+    ++getTotalItemsCalls;
+    return int(_items.size());
+  }
+
+  shared_ptr<ViewModelBase> GetItem(int index) override
+  {
+    ++getItemCalls;
+    return index < int(_items.size()) ? _items[index] : nullptr;
+  }
+
+  void GetItems(int first, int count, vector<shared_ptr<ViewModelBase>>& items) override
+  {
+    getItemsRanges.emplace_back(first, count);
+    ItemsProvider::GetItems(first, count, items);
+  }
+
+  int GetItemIndex(shared_ptr<ViewModelBase> item) override
+  {
+    for (int i = 0; i < int(_items.size()); ++i)
+    {
+      if (_items[i] == item)
+      {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  int                    getItemCalls       = 0;
+  int                    getTotalItemsCalls = 0;
+  vector<pair<int, int>> getItemsRanges;
+
+private:
+  vector<shared_ptr<ViewModelBase>> _items;
+};
+
+// Returns a placeholder for each item until the test loads it
+class AsyncItemsProvider: public StubItemsProvider
+{
+public:
+  using StubItemsProvider::StubItemsProvider;
+
+  void RequestItems(int first, int count, const ItemReady& ready,
+                    vector<shared_ptr<ViewModelBase>>& items) override
+  {
+    items.clear();
+    for (int index = first; index < first + count; ++index)
+    {
+      if (loaded.count(index))
+      {
+        items.push_back(GetItem(index));
+      }
+      else
+      {
+        requested[index] = ready;
+        items.push_back(placeholder);
+      }
+    }
+  }
+
+  void Prefetch(int index, int count) override
+  {
+    prefetched.emplace_back(index, count);
+  }
+
+  // Finishes loading the item on another thread, as a real provider would
+  void Load(int index)
+  {
+    loaded.insert(index);
+    auto ready = requested[index];
+    thread([ready, index] { ready(index); }).join();
+  }
+
+  shared_ptr<ViewModelBase>  placeholder = make_shared<ViewModelBase>();
+  set<int>                   loaded;
+  map<int, ItemReady>        requested;
+  vector<pair<int, int>>     prefetched;
+};
+
+shared_ptr<Grid> CreateGrid(shared_ptr<ElementManager> em, int items,
+                            const function<void(shared_ptr<Element>)>& cellCreated = nullptr)
+{
+  auto layer = em->CreateLayerAbove(nullptr);
+  layer->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(300);
+    e->SetBottom(1000);
+  });
+
+  auto grid = layer->CreateChild<Grid>();
+  grid->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(100);
+    e->SetRight(300);
+    e->SetBottom(400);
+  });
+  grid->SetColumns(3);
+  grid->SetCellHeight(50);
+  grid->SetItemsProvider(make_shared<StubItemsProvider>(items));
+  grid->SetCellCreateCallback([cellCreated](shared_ptr<Element> cell) {
+    cell->SetConsumesInput(true);
+    if (cellCreated)
+    {
+      cellCreated(cell);
+    }
+  });
+
+  em->UpdateEverything();
+
+  return grid;
+}
+
+// Makes the backend draw translated elements (as a DrawingContext would), so that the
+// grid moves the cells it keeps by translation
+void SupportTranslation(ElementManager& em)
+{
+  em.SetPushTranslationCallback([](const Point&) {});
+  em.SetPopTranslationCallback([] {});
+}
+
+// The bounds at which each item is shown, including any translation
+map<int, Rect4> GetItemBounds(shared_ptr<Grid> grid)
+{
+  map<int, Rect4> itemBounds;
+  for (auto e = grid->GetFirstChild(); e; e = e->GetNextSibling())
+  {
+    if (e->GetViewModel())
+    {
+      auto& translation = e->GetTranslation();
+      itemBounds[grid->GetItemsProvider()->GetItemIndex(e->GetViewModel())] =
+        e->GetBounds().Translated(translation.X, translation.Y);
+    }
+  }
+  return itemBounds;
+}
+
+Element* BruteForceFindLastChild(Element* parent, const Point& point)
+{
+  Element* result = nullptr;
+  for (auto e = parent->GetFirstChild(); e; e = e->GetNextSibling())
+  {
+    if (e->Intersects(point))
+    {
+      result = e.get();
+    }
+  }
+  return result;
+}
+}
+
+TEST(GridTests, FindLastChild_MatchesBruteForce)
+{
+  auto em   = make_shared<ElementManager>();
+  auto grid = CreateGrid(em, 100);
+
+  grid->MoveToOffsetPercent(0.2, false);
+  grid->UpdateAfterModify();
+
+  ASSERT_EQ(21, grid->GetChildrenCount());
+
+  for (double y = 90; y <= 410; y += 7.5)
+  {
+    for (double x = -5; x <= 305; x += 12.5)
+    {
+      auto expected = BruteForceFindLastChild(grid.get(), Point{x, y});
+      ASSERT_EQ(expected, grid->FindLastChild(Point{x, y})) << x << ", " << y;
+    }
+  }
+}
+
+TEST(GridTests, VisitChildrenInRegion_MatchesBruteForce)
+{
+  auto em   = make_shared<ElementManager>();
+  auto grid = CreateGrid(em, 100);
+
+  grid->MoveToOffsetPercent(0.37, false);
+  grid->UpdateAfterModify();
+
+  vector<Rect4> regions = {Rect4(0, 100, 10, 110), Rect4(120, 180, 230, 260),
+                           Rect4(-20, 0, 400, 600), Rect4(299, 399, 310, 410)};
+
+  for (auto& region : regions)
+  {
+    vector<Element*> expected;
+    for (auto e = grid->GetFirstChild(); e; e = e->GetNextSibling())
+    {
+      if (e->Intersects(region))
+      {
+        expected.push_back(e.get());
+      }
+    }
+
+    vector<Element*> first;
+    grid->VisitChildren(region, [&first](Element* e) { first.push_back(e); return true; });
+    ASSERT_EQ(expected, first);
+
+    vector<Element*> last;
+    grid->VisitLastChildren(region, [&last](Element* e) { last.push_back(e); return true; });
+    reverse(last.begin(), last.end());
+    ASSERT_EQ(expected, last);
+  }
+}
+
+TEST(GridTests, WhenScrolledByRows_OnlyCellsShowingNewItemsAreRebound)
+{
+  int contentArranges = 0;
+  auto addContent = [&contentArranges](shared_ptr<Element> cell) {
+    auto content = cell->CreateChild<Element>();
+    content->SetArrangeCallback([&contentArranges](shared_ptr<Element> e) {
+      ++contentArranges;
+      auto p = e->GetParent();
+      e->SetLeft(p->GetLeft() + 5);
+      e->SetTop(p->GetTop() + 5);
+      e->SetRight(p->GetRight() - 5);
+      e->SetBottom(p->GetBottom() - 5);
+    });
+  };
+
+  auto em       = make_shared<ElementManager>();
+  SupportTranslation(*em);
+  auto grid     = CreateGrid(em, 100, addContent);
+  auto provider = static_pointer_cast<StubItemsProvider>(grid->GetItemsProvider());
+
+  // Where each item should be shown, from a grid which jumps straight there
+  auto referenceEm   = make_shared<ElementManager>();
+  auto referenceGrid = CreateGrid(referenceEm, 100);
+  auto expectSameLayout = [&](double pixels) {
+    referenceGrid->MoveToOffsetPercent(pixels / (34 * 50.0), false);
+    referenceEm->UpdateEverything();
+
+    map<int, Rect4> expected;
+    for (auto e = referenceGrid->GetFirstChild(); e; e = e->GetNextSibling())
+    {
+      auto& translation = e->GetTranslation();
+      expected[referenceGrid->GetItemsProvider()->GetItemIndex(e->GetViewModel())] =
+        e->GetBounds().Translated(translation.X, translation.Y);
+    }
+
+    for (auto e = grid->GetFirstChild(); e; e = e->GetNextSibling())
+    {
+      auto  index       = provider->GetItemIndex(e->GetViewModel());
+      auto& translation = e->GetTranslation();
+      ASSERT_EQ(1, expected.count(index)) << pixels;
+      ASSERT_EQ(expected[index], e->GetBounds().Translated(translation.X, translation.Y)) << pixels;
+      ASSERT_EQ(e->GetBounds().Translated(5, 5).left, e->GetFirstChild()->GetBounds().left);
+    }
+  };
+
+  auto scrollTo = [&](double pixels) {
+    contentArranges        = 0;
+    provider->getItemCalls = 0;
+    grid->MoveToOffsetPercent(pixels / (34 * 50.0), false);
+    grid->UpdateAfterModify();
+    expectSameLayout(pixels);
+  };
+
+  // Within a row, the cells only move
+  scrollTo(30);
+  ASSERT_EQ(0, provider->getItemCalls);
+  ASSERT_EQ(0, contentArranges);
+
+  // Scrolling into the next row or two only rebinds the cells for those rows
+  scrollTo(60);
+  ASSERT_EQ(3, provider->getItemCalls);
+  ASSERT_EQ(3, contentArranges);
+
+  scrollTo(170);
+  ASSERT_EQ(6, provider->getItemCalls);
+  ASSERT_EQ(6, contentArranges);
+
+  scrollTo(20);
+  ASSERT_EQ(9, provider->getItemCalls);
+
+  // The layout can still be hit tested after the cells have been rotated
+  for (double y = 95; y <= 405; y += 10)
+  {
+    auto expected = BruteForceFindLastChild(grid.get(), Point{150, y});
+    ASSERT_EQ(expected, grid->FindLastChild(Point{150, y})) << y;
+  }
+
+  // An update which doesn't scroll rebinds every cell, so that changed items are shown
+  scrollTo(20);
+  ASSERT_EQ(21, provider->getItemCalls);
+  ASSERT_EQ(21, contentArranges);
+}
+
+TEST(GridTests, WhenBackendCannotTranslate_KeptCellsAreArrangedAgainWhereTheyMoved)
+{
+  int contentArranges = 0;
+  auto addContent = [&contentArranges](shared_ptr<Element> cell) {
+    auto content = cell->CreateChild<Element>();
+    content->SetArrangeCallback([&contentArranges](shared_ptr<Element> e) {
+      ++contentArranges;
+      auto p = e->GetParent();
+      e->SetLeft(p->GetLeft());
+      e->SetTop(p->GetTop());
+      e->SetRight(p->GetRight());
+      e->SetBottom(p->GetBottom());
+    });
+  };
+
+  // Only draw callbacks, which would ignore any translation
+  auto em       = make_shared<ElementManager>();
+  auto grid     = CreateGrid(em, 100, addContent);
+  auto provider = static_pointer_cast<StubItemsProvider>(grid->GetItemsProvider());
+  ASSERT_FALSE(em->CanTranslate());
+
+  auto referenceEm   = make_shared<ElementManager>();
+  auto referenceGrid = CreateGrid(referenceEm, 100);
+
+  for (double pixels : {30.0, 60.0})
+  {
+    contentArranges        = 0;
+    provider->getItemCalls = 0;
+    grid->MoveToOffsetPercent(pixels / (34 * 50.0), false);
+    grid->UpdateAfterModify();
+    referenceGrid->MoveToOffsetPercent(pixels / (34 * 50.0), false);
+    referenceEm->UpdateEverything();
+
+    // Every cell is arranged at its new position, but only those showing other items
+    // are rebound
+    ASSERT_EQ(21, contentArranges) << pixels;
+    ASSERT_EQ(pixels == 30.0 ? 0 : 3, provider->getItemCalls) << pixels;
+    for (auto e = grid->GetFirstChild(); e; e = e->GetNextSibling())
+    {
+      ASSERT_EQ(0, e->GetTranslation().Y);
+      ASSERT_EQ(e->GetBounds(), e->GetFirstChild()->GetBounds());
+    }
+    ASSERT_EQ(GetItemBounds(referenceGrid), GetItemBounds(grid)) << pixels;
+  }
+}
+
+TEST(GridTests, WhenScrolledByRows_NewItemsAreFetchedInOneRequest)
+{
+  auto em       = make_shared<ElementManager>();
+  auto grid     = CreateGrid(em, 100);
+  auto provider = static_pointer_cast<StubItemsProvider>(grid->GetItemsProvider());
+
+  auto scrollTo = [&](double pixels) {
+    provider->getItemsRanges.clear();
+    provider->getTotalItemsCalls = 0;
+    grid->MoveToOffsetPercent(pixels / (34 * 50.0), false);
+    grid->UpdateAfterModify();
+  };
+
+  scrollTo(60);
+  vector<pair<int, int>> expected = {{21, 3}};
+  ASSERT_EQ(expected, provider->getItemsRanges);
+  ASSERT_EQ(1, provider->getTotalItemsCalls);
+
+  scrollTo(20);
+  expected = {{0, 3}};
+  ASSERT_EQ(expected, provider->getItemsRanges);
+  ASSERT_EQ(1, provider->getTotalItemsCalls);
+
+  // Jumping further than the cells cover fetches the whole visible range
+  scrollTo(1310);
+  expected = {{78, 21}};
+  ASSERT_EQ(expected, provider->getItemsRanges);
+  ASSERT_EQ(1, provider->getTotalItemsCalls);
+}
+
+TEST(GridTests, WhenScrolledByCopy_OnlyExposedRowsAreDrawn)
+{
+  // Each cell is filled with a color which identifies its item
+  auto drawItemColor = [](shared_ptr<Element> cell) {
+    cell->SetRecordedDrawCallback([](Element* e, DrawingContext& dc) {
+      auto grid  = static_pointer_cast<Grid>(e->GetParent());
+      auto index = grid->GetItemsProvider()->GetItemIndex(e->GetViewModel());
+      dc.FillRectangle(e->GetBounds(), Color{uint8_t(index), uint8_t(index * 7), 128, 255});
+    });
+  };
+
+  auto em     = make_shared<ElementManager>();
+  auto raster = make_shared<RasterDrawingContext>(300, 1000);
+  em->SetSize(Size(300, 1000));
+  em->SetDrawingContext(raster);
+  auto grid = CreateGrid(em, 100, drawItemColor);
+  grid->SetScrollByCopy(true);
+
+  // The same grid drawn from scratch each time shows what should be on screen
+  auto referenceEm     = make_shared<ElementManager>();
+  auto referenceRaster = make_shared<RasterDrawingContext>(300, 1000);
+  referenceEm->SetSize(Size(300, 1000));
+  referenceEm->SetDrawingContext(referenceRaster);
+  auto referenceGrid = CreateGrid(referenceEm, 100, drawItemColor);
+
+  // A front buffer kept up to date from the copied areas and the redrawn region
+  RasterDrawingContext front(300, 1000);
+  raster->CopyTo(front, Region(Rect4(0, 0, 300, 1000)));
+
+  auto totalContentHeight = 34 * 50.0;
+  auto scrollTo = [&](double pixels) {
+    em->ClearRedrawnRegion();
+    raster->ResetPixelsWritten();
+    grid->MoveToOffsetPercent(pixels / totalContentHeight, false);
+    grid->UpdateAfterModify();
+
+    referenceGrid->MoveToOffsetPercent(pixels / totalContentHeight, false);
+    referenceGrid->UpdateAfterModify();
+    ASSERT_EQ(0, memcmp(referenceRaster->GetData(), raster->GetData(), 300 * 1000 * 4)) << pixels;
+
+    for (auto& copied : em->GetCopiedAreas())
+    {
+      front.CopyArea(copied.area, copied.offset);
+    }
+    raster->CopyTo(front, em->GetRedrawnRegion());
+    ASSERT_EQ(0, memcmp(raster->GetData(), front.GetData(), 300 * 1000 * 4)) << pixels;
+  };
+
+  // Only the row scrolled into view at the bottom is drawn
+  scrollTo(10);
+  ASSERT_EQ(1, em->GetCopiedAreas().size());
+  ASSERT_EQ(Rect4(0, 100, 300, 400), em->GetCopiedAreas()[0].area);
+  ASSERT_EQ(-10, em->GetCopiedAreas()[0].offset.Y);
+  ASSERT_EQ(Region(Rect4(0, 390, 300, 400)), em->GetRedrawnRegion());
+  ASSERT_EQ(300 * 10, raster->GetPixelsWritten());
+
+  // Crossing into the next row moves the items to different cells, but the
+  // pixels are still copied
+  scrollTo(65);
+  ASSERT_EQ(1, em->GetCopiedAreas().size());
+  ASSERT_EQ(Region(Rect4(0, 345, 300, 400)), em->GetRedrawnRegion());
+
+  scrollTo(20);
+  ASSERT_EQ(Region(Rect4(0, 100, 300, 145)), em->GetRedrawnRegion());
+
+  // Scrolling by part of a pixel or further than the grid's height redraws it all
+  scrollTo(20.5);
+  ASSERT_TRUE(em->GetCopiedAreas().empty());
+  scrollTo(900);
+  ASSERT_TRUE(em->GetCopiedAreas().empty());
+  ASSERT_EQ(Region(Rect4(0, 100, 300, 400)), em->GetRedrawnRegion());
+}
+
+TEST(GridTests, WhenItemIsLoadedAsynchronously_OnlyItsCellIsUpdated)
+{
+  int contentArranges = 0;
+  auto addContent = [&contentArranges](shared_ptr<Element> cell) {
+    auto content = cell->CreateChild<Element>();
+    content->SetArrangeCallback([&contentArranges](shared_ptr<Element> e) {
+      ++contentArranges;
+      auto p = e->GetParent();
+      e->SetLeft(p->GetLeft());
+      e->SetTop(p->GetTop());
+      e->SetRight(p->GetRight());
+      e->SetBottom(p->GetBottom());
+    });
+  };
+
+  auto em    = make_shared<ElementManager>();
+  int  posts = 0;
+  em->SetPostCallback([&posts] { ++posts; });
+
+  auto grid     = CreateGrid(em, 100, addContent);
+  auto provider = make_shared<AsyncItemsProvider>(100);
+  grid->SetItemsProvider(provider);
+  em->UpdateEverything();
+
+  ASSERT_EQ(21, provider->requested.size());
+  for (auto e = grid->GetFirstChild(); e; e = e->GetNextSibling())
+  {
+    ASSERT_EQ(provider->placeholder, e->GetViewModel());
+  }
+
+  // Nothing is shown until the posted action runs on this thread
+  contentArranges = 0;
+  provider->Load(4);
+  ASSERT_EQ(1, posts);
+  ASSERT_EQ(0, contentArranges);
+
+  ASSERT_EQ(1, em->RunPostedActions());
+  ASSERT_EQ(1, contentArranges);
+  int loadedCells = 0;
+  for (auto e = grid->GetFirstChild(); e; e = e->GetNextSibling())
+  {
+    if (e->GetViewModel() != provider->placeholder)
+    {
+      ASSERT_EQ(provider->GetItem(4), e->GetViewModel());
+      ++loadedCells;
+    }
+  }
+  ASSERT_EQ(1, loadedCells);
+  ASSERT_EQ(0, em->RunPostedActions());
+}
+
+TEST(GridTests, WhenScrolled_RowsAheadArePrefetched)
+{
+  auto em       = make_shared<ElementManager>();
+  auto grid     = CreateGrid(em, 100);
+  auto provider = make_shared<AsyncItemsProvider>(100);
+  grid->SetItemsProvider(provider);
+  grid->SetPrefetchRows(2);
+  em->UpdateEverything();
+
+  // Rows 0 to 6 are shown, and there is nothing above them
+  vector<pair<int, int>> expected = {{21, 6}};
+  ASSERT_EQ(expected, provider->prefetched);
+
+  auto scrollTo = [&](double pixels) {
+    provider->prefetched.clear();
+    grid->MoveToOffsetPercent(pixels / (34 * 50.0), false);
+    grid->UpdateAfterModify();
+  };
+
+  scrollTo(60);
+  expected = {{24, 6}};
+  ASSERT_EQ(expected, provider->prefetched);
+
+  scrollTo(170);
+  expected = {{30, 6}};
+  ASSERT_EQ(expected, provider->prefetched);
+
+  // Scrolling back up prefetches the rows above instead, but only once per row
+  scrollTo(120);
+  expected = {{0, 6}};
+  ASSERT_EQ(expected, provider->prefetched);
+  scrollTo(110);
+  ASSERT_TRUE(provider->prefetched.empty());
+
+  // Only the items which exist are prefetched
+  scrollTo(1310);
+  expected = {{99, 1}};
+  ASSERT_EQ(expected, provider->prefetched);
+}
+
+TEST(GridTests, WhenItemsChangeAboveOrBelowTheView_VisibleCellsStayBound)
+{
+  int contentArranges = 0;
+  auto addContent = [&contentArranges](shared_ptr<Element> cell) {
+    auto content = cell->CreateChild<Element>();
+    content->SetArrangeCallback([&contentArranges](shared_ptr<Element> e) {
+      ++contentArranges;
+      auto p = e->GetParent();
+      e->SetLeft(p->GetLeft());
+      e->SetTop(p->GetTop());
+      e->SetRight(p->GetRight());
+      e->SetBottom(p->GetBottom());
+    });
+  };
+
+  auto em       = make_shared<ElementManager>();
+  SupportTranslation(*em);
+  auto grid     = CreateGrid(em, 0, addContent);
+  auto provider = make_shared<IndexedItemsProvider>();
+  for (int i = 0; i < 102; ++i)
+  {
+    provider->Insert(i, make_shared<ViewModelBase>());
+  }
+  grid->SetItemsProvider(provider);
+  grid->MoveToOffsetPercent(300 / (34 * 50.0), false);
+  em->UpdateEverything();
+
+  auto original = GetItemBounds(grid);
+  ASSERT_EQ(18, original.begin()->first);
+
+  // Shows the items at the scroll position, as if the grid had been arranged afresh
+  auto referenceEm   = make_shared<ElementManager>();
+  auto referenceGrid = CreateGrid(referenceEm, 0);
+  referenceGrid->SetItemsProvider(provider);
+  auto expectSameLayout = [&](double pixels) {
+    referenceGrid->MoveToOffsetPercent(grid->GetCurrentOffsetPercent(), false);
+    referenceEm->UpdateEverything();
+    ASSERT_EQ(GetItemBounds(referenceGrid), GetItemBounds(grid));
+    auto totalContentHeight = ceil(provider->GetTotalItems() / 3.0) * 50;
+    ASSERT_NEAR(pixels, grid->GetCurrentOffsetPercent() * totalContentHeight, 1e-6);
+  };
+
+  auto flush = [&](bool needsArrange) {
+    contentArranges = 0;
+    ASSERT_EQ(needsArrange, grid->GetNeedsArrange());
+    em->Flush();
+  };
+
+  // Appending items below the view changes nothing which is shown, so the grid
+  // isn't even arranged
+  provider->Append({make_shared<ViewModelBase>(), make_shared<ViewModelBase>()});
+  flush(false);
+  ASSERT_EQ(0, contentArranges);
+  ASSERT_EQ(original, GetItemBounds(grid));
+  expectSameLayout(300);
+
+  // Inserting whole rows above the view keeps the same items on screen in the same cells
+  auto shown = grid->GetFirstChild()->GetViewModel();
+  vector<shared_ptr<ViewModelBase>> rows;
+  for (int i = 0; i < 6; ++i)
+  {
+    rows.push_back(make_shared<ViewModelBase>());
+  }
+  provider->Insert(0, rows);
+  flush(false);
+  ASSERT_EQ(0, contentArranges);
+  ASSERT_EQ(shown, grid->GetFirstChild()->GetViewModel());
+  expectSameLayout(400);
+
+  // And so does removing them again
+  provider->Remove(0, 6);
+  flush(false);
+  ASSERT_EQ(0, contentArranges);
+  ASSERT_EQ(original, GetItemBounds(grid));
+  expectSameLayout(300);
+
+  // Replacing a visible item only rebinds the cell which shows it
+  provider->Replace(20, make_shared<ViewModelBase>());
+  flush(true);
+  ASSERT_EQ(1, contentArranges);
+  expectSameLayout(300);
+
+  // Inserting within the view only rebinds the cells from that point on
+  provider->Insert(30, make_shared<ViewModelBase>());
+  flush(true);
+  ASSERT_EQ(9, contentArranges);
+  expectSameLayout(300);
+
+  // Moving items within the view only rebinds the cells whose items moved
+  provider->Move(21, 3, 24);
+  flush(true);
+  ASSERT_EQ(6, contentArranges);
+  expectSameLayout(300);
+}
@@ -0,0 +1,128 @@
+#include "libgui/IndexedItemsProvider.h"
+#include "libgui/ViewModelBase.h"
+
+#include <gtest/gtest.h>
+
+using namespace libgui;
+using namespace std;
+
+namespace
+{
+vector<shared_ptr<ViewModelBase>> CreateItems(int count)
+{
+  vector<shared_ptr<ViewModelBase>> items;
+  for (int i = 0; i < count; ++i)
+  {
+    items.push_back(make_shared<ViewModelBase>());
+  }
+  return items;
+}
+
+void ExpectIndexMatchesPositions(IndexedItemsProvider& provider)
+{
+  for (int i = 0; i < provider.GetTotalItems(); ++i)
+  {
+    ASSERT_EQ(i, provider.GetItemIndex(provider.GetItem(i)));
+  }
+}
+}
+
+TEST(IndexedItemsProviderTests, WhenItemsAreAppended_EachIsFoundAtItsPosition)
+{
+  IndexedItemsProvider provider;
+  provider.Append(CreateItems(100));
+  provider.Append(CreateItems(50));
+
+  ASSERT_EQ(150, provider.GetTotalItems());
+  ExpectIndexMatchesPositions(provider);
+  ASSERT_EQ(-1, provider.GetItemIndex(make_shared<ViewModelBase>()));
+  ASSERT_EQ(-1, provider.GetItemIndex(nullptr));
+}
+
+TEST(IndexedItemsProviderTests, WhenItemsAreInsertedOrRemoved_LaterItemsAreFoundAtTheirNewPositions)
+{
+  IndexedItemsProvider provider;
+  auto items = CreateItems(10);
+  provider.Append(items);
+  ExpectIndexMatchesPositions(provider);
+
+  auto inserted = CreateItems(3);
+  provider.Insert(4, inserted);
+  ASSERT_EQ(4, provider.GetItemIndex(inserted[0]));
+  ASSERT_EQ(7, provider.GetItemIndex(items[4]));
+  ExpectIndexMatchesPositions(provider);
+
+  provider.Remove(1, 5);
+  ASSERT_EQ(-1, provider.GetItemIndex(items[1]));
+  ASSERT_EQ(-1, provider.GetItemIndex(inserted[1]));
+  ASSERT_EQ(1, provider.GetItemIndex(inserted[2]));
+  ExpectIndexMatchesPositions(provider);
+
+  // A removed item can be inserted again elsewhere
+  provider.Insert(0, items[1]);
+  ASSERT_EQ(0, provider.GetItemIndex(items[1]));
+  ExpectIndexMatchesPositions(provider);
+
+  provider.Clear();
+  ASSERT_EQ(0, provider.GetTotalItems());
+  ASSERT_EQ(-1, provider.GetItemIndex(items[0]));
+}
+
+TEST(IndexedItemsProviderTests, WhenRangeIsOutsideTheList_ExceptionIsThrown)
+{
+  IndexedItemsProvider provider;
+  provider.Append(CreateItems(5));
+
+  vector<shared_ptr<ViewModelBase>> items;
+  ASSERT_THROW(provider.GetItems(3, 3, items), runtime_error);
+  ASSERT_THROW(provider.Insert(6, make_shared<ViewModelBase>()), runtime_error);
+  ASSERT_THROW(provider.Remove(-1, 2), runtime_error);
+
+  provider.GetItems(3, 2, items);
+  ASSERT_EQ(2, items.size());
+  ASSERT_EQ(provider.GetItem(4), items[1]);
+}
+
+TEST(IndexedItemsProviderTests, WhenItemsAreMovedOrReplaced_ChangesAreNotified)
+{
+  IndexedItemsProvider provider;
+  auto items = CreateItems(10);
+  provider.Append(items);
+
+  vector<ItemsProvider::ItemsChange> changes;
+  auto handlerId = provider.AddItemsChangedHandler([&changes](const ItemsProvider::ItemsChange& change) {
+    changes.push_back(change);
+  });
+
+  provider.Move(2, 3, 6);
+  ASSERT_EQ(6, provider.GetItemIndex(items[2]));
+  ASSERT_EQ(2, provider.GetItemIndex(items[5]));
+  ExpectIndexMatchesPositions(provider);
+
+  provider.Move(6, 3, 2);
+  ASSERT_EQ(2, provider.GetItemIndex(items[2]));
+  ExpectIndexMatchesPositions(provider);
+
+  auto replacement = make_shared<ViewModelBase>();
+  provider.Replace(4, replacement);
+  ASSERT_EQ(4, provider.GetItemIndex(replacement));
+  ASSERT_EQ(-1, provider.GetItemIndex(items[4]));
+
+  provider.Insert(0, make_shared<ViewModelBase>());
+  provider.Remove(1, 2);
+
+  ASSERT_EQ(5, changes.size());
+  ASSERT_EQ(ItemsProvider::ItemsChange::Type::Moved, changes[0].type);
+  ASSERT_EQ(2, changes[0].index);
+  ASSERT_EQ(3, changes[0].count);
+  ASSERT_EQ(6, changes[0].newIndex);
+  ASSERT_EQ(ItemsProvider::ItemsChange::Type::Changed, changes[2].type);
+  ASSERT_EQ(ItemsProvider::ItemsChange::Type::Inserted, changes[3].type);
+  ASSERT_EQ(ItemsProvider::ItemsChange::Type::Removed, changes[4].type);
+  ASSERT_EQ(2, changes[4].count);
+
+  // Once removed, the handler is no longer called
+  provider.RemoveItemsChangedHandler(handlerId);
+  provider.Clear();
+  ASSERT_EQ(5, changes.size());
+}
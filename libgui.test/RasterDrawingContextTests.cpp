@@ -0,0 +1,165 @@
+#include "libgui/ElementManager.h"
+#include "libgui/Layer.h"
+#include "libgui/RasterDrawingContext.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace libgui;
+using namespace std;
+
+static const Color Red{255, 0, 0, 255};
+static const Color Blue{0, 0, 255, 255};
+static const Color White{255, 255, 255, 255};
+
+TEST(RasterDrawingContextTests, WhenFilling_OnlyPixelsWithCentersInsideAreSet)
+{
+  RasterDrawingContext context(10, 10);
+  context.FillRectangle(Rect4(2, 2, 5.4, 5.6), Red);
+
+  ASSERT_EQ(Red, context.GetPixel(2, 2));
+  ASSERT_EQ(Red, context.GetPixel(4, 5));
+  ASSERT_NE(Red, context.GetPixel(5, 5));
+  ASSERT_NE(Red, context.GetPixel(1, 2));
+  ASSERT_EQ(12, context.GetPixelsWritten());
+}
+
+TEST(RasterDrawingContextTests, WhenClipsArePushed_DrawingIsLimitedToTheirIntersection)
+{
+  RasterDrawingContext context(10, 10);
+  context.PushClip(Rect4(0, 0, 6, 6));
+  context.PushClip(Rect4(4, 4, 10, 10));
+  context.FillRectangle(Rect4(0, 0, 10, 10), Red);
+
+  ASSERT_EQ(4, context.GetPixelsWritten());
+  ASSERT_EQ(Red, context.GetPixel(5, 5));
+  ASSERT_NE(Red, context.GetPixel(6, 6));
+
+  context.PopClip();
+  context.PopClip();
+  context.FillRectangle(Rect4(-5, -5, 20, 20), Blue);
+  ASSERT_EQ(104, context.GetPixelsWritten());
+}
+
+TEST(RasterDrawingContextTests, WhenTranslationsArePushed_DrawingAndClipsAreMovedByTheirSum)
+{
+  RasterDrawingContext context(10, 10);
+  context.PushTranslation(Point{2, 1});
+  context.PushTranslation(Point{1, 1});
+  context.PushClip(Rect4(0, 0, 4, 4));
+  context.FillRectangle(Rect4(2, 2, 10, 10), Red);
+
+  ASSERT_EQ(4, context.GetPixelsWritten());
+  ASSERT_EQ(Red, context.GetPixel(5, 4));
+  ASSERT_EQ(Red, context.GetPixel(6, 5));
+  ASSERT_NE(Red, context.GetPixel(7, 6));
+
+  context.PopClip();
+  context.PopTranslation();
+  context.FillRectangle(Rect4(0, 0, 1, 1), Blue);
+  ASSERT_EQ(Blue, context.GetPixel(2, 1));
+
+  context.PopTranslation();
+  context.FillRectangle(Rect4(0, 0, 1, 1), Blue);
+  ASSERT_EQ(Blue, context.GetPixel(0, 0));
+}
+
+TEST(RasterDrawingContextTests, WhenAreaIsCopied_PixelsMoveWithinItAndTheRestAreKept)
+{
+  RasterDrawingContext context(10, 10);
+  context.FillRectangle(Rect4(2, 2, 4, 4), Red);
+  context.FillRectangle(Rect4(2, 8, 4, 10), Blue);
+
+  // The clip and translation don't apply to copies
+  context.PushClip(Rect4(0, 0, 1, 1));
+  context.PushTranslation(Point{5, 5});
+  context.CopyArea(Rect4(0, 0, 10, 9), Point{1, 5});
+  context.PopTranslation();
+  context.PopClip();
+
+  ASSERT_EQ(Red, context.GetPixel(3, 7));
+  ASSERT_EQ(Red, context.GetPixel(4, 8));
+  ASSERT_NE(Red, context.GetPixel(4, 9));
+
+  // The exposed pixels and those outside the area are left alone
+  ASSERT_EQ(Red, context.GetPixel(2, 2));
+  ASSERT_EQ(Blue, context.GetPixel(2, 9));
+  ASSERT_EQ(Blue, context.GetPixel(3, 9));
+}
+
+TEST(RasterDrawingContextTests, WhenTranslucentColorIsFilled_ItIsBlendedOverExistingPixels)
+{
+  RasterDrawingContext context(1, 1);
+  context.Clear(White);
+  context.FillRectangle(Rect4(0, 0, 1, 1), Color{0, 0, 0, 128});
+
+  ASSERT_EQ((Color{127, 127, 127, 255}), context.GetPixel(0, 0));
+}
+
+TEST(RasterDrawingContextTests, WhenElementIsModified_OnlyItsAreaIsRedrawnAndCopied)
+{
+  auto em      = make_shared<ElementManager>();
+  auto context = make_shared<RasterDrawingContext>(100, 100);
+  em->SetDrawingContext(context);
+
+  auto layer = em->CreateLayerAbove(nullptr);
+  layer->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(100);
+    e->SetBottom(100);
+  });
+  layer->SetRecordedDrawCallback([](Element* e, DrawingContext& dc) {
+    dc.FillRectangle(e->GetBounds(), White);
+  });
+
+  Color color = Red;
+  auto element = layer->CreateChild<Element>();
+  element->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(10);
+    e->SetTop(10);
+    e->SetRight(30);
+    e->SetBottom(20);
+  });
+  element->SetRecordedDrawCallback([&color](Element* e, DrawingContext& dc) {
+    dc.FillRectangle(e->GetBounds(), color);
+    dc.OutlineRectangle(e->GetBounds(), Blue, 1);
+  });
+
+  em->UpdateEverything();
+  ASSERT_EQ(White, context->GetPixel(5, 5));
+  ASSERT_EQ(Blue, context->GetPixel(10, 10));
+  ASSERT_EQ(Red, context->GetPixel(15, 15));
+
+  RasterDrawingContext front(100, 100);
+  context->CopyTo(front, em->GetRedrawnRegion());
+  em->ClearRedrawnRegion();
+  ASSERT_EQ(Red, front.GetPixel(15, 15));
+
+  context->ResetPixelsWritten();
+  color = Blue;
+  element->UpdateAfterModify();
+
+  // The layer background, the fill and the outline are drawn only within its bounds
+  ASSERT_EQ(200 + 200 + 56, context->GetPixelsWritten());
+  ASSERT_EQ(Blue, context->GetPixel(15, 15));
+
+  front.Clear(White);
+  context->CopyTo(front, em->GetRedrawnRegion());
+  ASSERT_EQ(Blue, front.GetPixel(15, 15));
+  ASSERT_EQ(White, front.GetPixel(35, 15));
+}
+
+TEST(RasterDrawingContextTests, WhenWrittenAsPam_HeaderIsFollowedByPixels)
+{
+  RasterDrawingContext context(2, 1);
+  context.Clear(Red);
+
+  ostringstream stream;
+  context.WritePam(stream);
+
+  auto header = string("P7\nWIDTH 2\nHEIGHT 1\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n");
+  ASSERT_EQ(header.size() + 8, stream.str().size());
+  ASSERT_EQ(header, stream.str().substr(0, header.size()));
+  ASSERT_EQ('\xff', stream.str()[header.size()]);
+}
@@ -0,0 +1,86 @@
+#include "libgui/Region.h"
+
+#include <gtest/gtest.h>
+
+using namespace libgui;
+using namespace std;
+
+TEST(RegionTests, WhenDisjointRectsAreUnioned_BothAreKeptSeparately)
+{
+  Region region;
+  region.Union(Rect4(0, 0, 10, 10));
+  region.Union(Rect4(90, 90, 100, 100));
+
+  ASSERT_EQ(2, region.GetRects().size());
+  ASSERT_EQ(200, region.Area());
+  ASSERT_EQ(Rect4(0, 0, 100, 100), region.GetBounds());
+}
+
+TEST(RegionTests, WhenOverlappingRectsAreUnioned_ResultIsBandedWithoutOverlap)
+{
+  Region region;
+  region.Union(Rect4(0, 0, 10, 10));
+  region.Union(Rect4(5, 5, 15, 15));
+
+  vector<Rect4> expected = {
+    Rect4(0, 0, 10, 5),
+    Rect4(0, 5, 15, 10),
+    Rect4(5, 10, 15, 15)
+  };
+  ASSERT_EQ(expected, region.GetRects());
+  ASSERT_EQ(175, region.Area());
+}
+
+TEST(RegionTests, WhenAdjacentRectsAreUnioned_TheyAreMerged)
+{
+  Region region;
+  for (int i = 0; i < 100; ++i)
+  {
+    region.Union(Rect4(0, i * 20, 20, (i + 1) * 20));
+  }
+
+  ASSERT_EQ(1, region.GetRects().size());
+  ASSERT_EQ(Rect4(0, 0, 20, 2000), region.GetRects().front());
+}
+
+TEST(RegionTests, WhenHoleIsSubtracted_SurroundingAreaRemains)
+{
+  Region region(Rect4(0, 0, 30, 30));
+  region.Subtract(Rect4(10, 10, 20, 20));
+
+  ASSERT_EQ(4, region.GetRects().size());
+  ASSERT_EQ(800, region.Area());
+  ASSERT_FALSE(region.Intersects(Rect4(11, 11, 19, 19)));
+  ASSERT_TRUE(region.Intersects(Rect4(5, 5, 15, 15)));
+
+  // Filling the hole again gives back the original rectangle
+  region.Union(Rect4(10, 10, 20, 20));
+  ASSERT_EQ(Region(Rect4(0, 0, 30, 30)), region);
+}
+
+TEST(RegionTests, WhenRegionsAreIntersected_OnlyTheCommonAreaRemains)
+{
+  Region region;
+  region.Union(Rect4(0, 0, 10, 10));
+  region.Union(Rect4(20, 0, 30, 10));
+
+  region.Intersect(Rect4(5, 5, 25, 25));
+
+  vector<Rect4> expected = {
+    Rect4(5, 5, 10, 10),
+    Rect4(20, 5, 25, 10)
+  };
+  ASSERT_EQ(expected, region.GetRects());
+  ASSERT_TRUE(region.Contains(Rect4(6, 6, 9, 9)));
+  ASSERT_FALSE(region.Contains(Rect4(6, 6, 21, 9)));
+}
+
+TEST(RegionTests, WhenRectIsEmptyOrInverted_ItIsIgnored)
+{
+  Region region;
+  region.Union(Rect4(10, 10, 10, 20));
+  region.Union(Rect4(10, 10, 0, 0));
+
+  ASSERT_TRUE(region.IsEmpty());
+  ASSERT_EQ(Rect4(), region.GetBounds());
+}
@@ -0,0 +1,319 @@
+#include "libgui/ElementManager.h"
+#include "libgui/IndexedItemsProvider.h"
+#include "libgui/Layer.h"
+#include "libgui/VirtualList.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <gtest/gtest.h>
+
+using namespace libgui;
+using namespace std;
+
+namespace
+{
+shared_ptr<IndexedItemsProvider> CreateItems(int count)
+{
+  vector<shared_ptr<ViewModelBase>> items;
+  for (int i = 0; i < count; ++i)
+  {
+    items.push_back(make_shared<ViewModelBase>());
+  }
+  auto provider = make_shared<IndexedItemsProvider>();
+  provider->Append(items);
+  return provider;
+}
+
+// Creates each item when it is first asked for, so that it can have millions of them
+class LazyItemsProvider: public ItemsProvider
+{
+public:
+  explicit LazyItemsProvider(int count)
+    : _count(count)
+  {
+  }
+
+  int GetTotalItems() override
+  {
+    return _count;
+  }
+
+  shared_ptr<ViewModelBase> GetItem(int index) override
+  {
+    auto& item = _items[index];
+    if (!item)
+    {
+      item = make_shared<ViewModelBase>();
+      _indexes[item.get()] = index;
+    }
+    return item;
+  }
+
+  int GetItemIndex(shared_ptr<ViewModelBase> item) override
+  {
+    auto it = _indexes.find(item.get());
+    return it == _indexes.end() ? -1 : it->second;
+  }
+
+private:
+  int                                 _count;
+  map<int, shared_ptr<ViewModelBase>> _items;
+  map<ViewModelBase*, int>            _indexes;
+};
+
+// Items are between 20 and 60 pixels high, depending on their position
+double MeasureByIndex(ItemsProvider& provider, const shared_ptr<ViewModelBase>& item)
+{
+  return 20 + (provider.GetItemIndex(item) % 5) * 10;
+}
+
+shared_ptr<VirtualList> CreateList(shared_ptr<ElementManager> em, shared_ptr<ItemsProvider> provider,
+                                   const function<void(shared_ptr<Element>)>& cellCreated = nullptr)
+{
+  auto layer = em->CreateLayerAbove(nullptr);
+  layer->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(0);
+    e->SetRight(300);
+    e->SetBottom(1000);
+  });
+
+  auto list = layer->CreateChild<VirtualList>();
+  list->SetArrangeCallback([](shared_ptr<Element> e) {
+    e->SetLeft(0);
+    e->SetTop(100);
+    e->SetRight(300);
+    e->SetBottom(400);
+  });
+  list->SetEstimatedItemHeight(50);
+  list->SetItemsProvider(provider);
+  list->SetCellCreateCallback([cellCreated](shared_ptr<Element> cell) {
+    if (cellCreated)
+    {
+      cellCreated(cell);
+    }
+  });
+
+  return list;
+}
+
+// Checks that the items shown run on from one another, by their heights, and fill the list
+void ExpectItemsFillTheList(shared_ptr<VirtualList> list)
+{
+  vector<pair<int, Rect4>> shown;
+  for (auto e = list->GetFirstChild(); e; e = e->GetNextSibling())
+  {
+    if (e->GetViewModel())
+    {
+      auto& translation = e->GetTranslation();
+      shown.emplace_back(list->GetItemsProvider()->GetItemIndex(e->GetViewModel()),
+                         e->GetBounds().Translated(translation.X, translation.Y));
+    }
+  }
+  sort(shown.begin(), shown.end(), [](const pair<int, Rect4>& a, const pair<int, Rect4>& b) {
+    return a.first < b.first;
+  });
+
+  ASSERT_FALSE(shown.empty());
+  for (int i = 0; i < int(shown.size()); ++i)
+  {
+    auto index = shown[i].first;
+    auto top   = list->GetTop() + list->GetItemTop(index) - list->GetScrollTop();
+    ASSERT_EQ(shown[0].first + i, index);
+    ASSERT_EQ(Rect4(0, round(top), 300, round(top + list->GetItemHeight(index))), shown[i].second) << index;
+  }
+  ASSERT_LE(shown.front().second.top, list->GetTop());
+  ASSERT_GT(shown.front().second.bottom, list->GetTop());
+  ASSERT_GE(shown.back().second.bottom, list->GetBottom());
+  ASSERT_LT(shown.back().second.top, list->GetBottom());
+}
+}
+
+TEST(VirtualListTests, WhenItemsAreMeasured_TheyAreLaidOutByTheirHeights)
+{
+  auto em       = make_shared<ElementManager>();
+  auto provider = CreateItems(1000);
+  auto list     = CreateList(em, provider);
+  list->SetMeasureCallback([provider](const shared_ptr<ViewModelBase>& item, double) {
+    return MeasureByIndex(*provider, item);
+  });
+  em->UpdateEverything();
+
+  // The items in view have been measured, and the rest are still estimated
+  ExpectItemsFillTheList(list);
+  ASSERT_EQ(20, list->GetItemHeight(0));
+  ASSERT_EQ(60, list->GetItemHeight(4));
+  ASSERT_EQ(50, list->GetItemHeight(999));
+
+  for (auto index : {17, 500, 998})
+  {
+    list->ScrollTo(index);
+    list->UpdateAfterModify();
+    ExpectItemsFillTheList(list);
+  }
+
+  // The last item is at the bottom, as the list can't scroll any further
+  ASSERT_EQ(list->GetContentHeight() - 300, list->GetScrollTop());
+}
+
+TEST(VirtualListTests, WhenScrolled_OnlyCellsShowingNewItemsAreRebound)
+{
+  int contentArranges = 0;
+  auto addContent = [&contentArranges](shared_ptr<Element> cell) {
+    auto content = cell->CreateChild<Element>();
+    content->SetArrangeCallback([&contentArranges](shared_ptr<Element> e) {
+      ++contentArranges;
+      auto p = e->GetParent();
+      e->SetLeft(p->GetLeft());
+      e->SetTop(p->GetTop());
+      e->SetRight(p->GetRight());
+      e->SetBottom(p->GetBottom());
+    });
+  };
+
+  auto em       = make_shared<ElementManager>();
+  em->SetPushTranslationCallback([](const Point&) {});
+  em->SetPopTranslationCallback([] {});
+  auto provider = CreateItems(1000);
+  auto list     = CreateList(em, provider, addContent);
+  list->SetMeasureCallback([provider](const shared_ptr<ViewModelBase>& item, double) {
+    return MeasureByIndex(*provider, item);
+  });
+  em->UpdateEverything();
+
+  // Items 0 to 8 are in view, and item 9 starts 40 pixels below the bottom
+  auto cells = list->GetChildrenCount();
+  auto scrollBy = [&](double pixels) {
+    contentArranges = 0;
+    list->MoveToOffsetPercent((list->GetScrollTop() + pixels) / list->GetContentHeight(), false);
+    list->UpdateAfterModify();
+    ExpectItemsFillTheList(list);
+  };
+
+  scrollBy(5);
+  ASSERT_EQ(0, contentArranges);
+
+  scrollBy(35);
+  ASSERT_EQ(0, contentArranges);
+
+  scrollBy(10);
+  ASSERT_EQ(1, contentArranges);
+
+  // Items 10 to 12 come into view
+  scrollBy(125);
+  ASSERT_EQ(3, contentArranges);
+
+  // The cells which scroll out of view are reused
+  for (int i = 0; i < 20; ++i)
+  {
+    scrollBy(35);
+  }
+  ASSERT_GE(cells + 2, list->GetChildrenCount());
+}
+
+TEST(VirtualListTests, WhenItemsAboveTheViewChange_TheItemsInViewStayWhereTheyAre)
+{
+  auto em       = make_shared<ElementManager>();
+  auto provider = CreateItems(1000);
+  auto list     = CreateList(em, provider);
+  int  thumbChanges = 0;
+  list->WhenThumbDataChanges([&thumbChanges] { ++thumbChanges; });
+  em->UpdateEverything();
+
+  list->ScrollTo(100);
+  list->UpdateAfterModify();
+  auto shown  = list->GetFirstChild()->GetViewModel();
+  auto bounds = list->GetFirstChild()->GetBounds();
+
+  auto expectUnmoved = [&] {
+    for (auto e = list->GetFirstChild(); e; e = e->GetNextSibling())
+    {
+      if (e->GetViewModel() == shown)
+      {
+        auto& translation = e->GetTranslation();
+        ASSERT_EQ(bounds, e->GetBounds().Translated(translation.X, translation.Y));
+        return;
+      }
+    }
+    FAIL() << "The item is no longer shown";
+  };
+
+  // A row above the view turns out to be taller than estimated
+  thumbChanges = 0;
+  list->SetItemHeight(10, 150);
+  em->Flush();
+  ASSERT_EQ(5100, list->GetScrollTop());
+  ASSERT_EQ(1, thumbChanges);
+  expectUnmoved();
+
+  // Items are inserted and removed above the view
+  provider->Insert(0, {make_shared<ViewModelBase>(), make_shared<ViewModelBase>()});
+  em->Flush();
+  ASSERT_EQ(5200, list->GetScrollTop());
+  expectUnmoved();
+
+  provider->Remove(5, 3);
+  em->Flush();
+  ASSERT_EQ(5050, list->GetScrollTop());
+  expectUnmoved();
+  ExpectItemsFillTheList(list);
+}
+
+TEST(VirtualListTests, WhenScrollingUpIntoUnmeasuredItems_TheItemsInViewMoveByTheScroll)
+{
+  auto em       = make_shared<ElementManager>();
+  auto provider = CreateItems(1000);
+  auto list     = CreateList(em, provider);
+
+  // Every item is twice as high as estimated
+  list->SetMeasureCallback([](const shared_ptr<ViewModelBase>&, double) { return 100.0; });
+  em->UpdateEverything();
+
+  list->ScrollTo(500);
+  list->UpdateAfterModify();
+
+  auto shown = provider->GetItem(500);
+  auto shownTop = [&] {
+    for (auto e = list->GetFirstChild(); e; e = e->GetNextSibling())
+    {
+      if (e->GetViewModel() == shown)
+      {
+        return e->GetBounds().top + e->GetTranslation().Y;
+      }
+    }
+    return -1.0;
+  };
+  ASSERT_EQ(list->GetTop(), shownTop());
+
+  // Each item which comes into view at the top is measured without moving the
+  // items below it
+  double expectedTop = list->GetTop();
+  for (auto pixels : {10, 60, 40, 35, 90})
+  {
+    list->MoveToOffsetPercent((list->GetScrollTop() - pixels) / list->GetContentHeight(), false);
+    list->UpdateAfterModify();
+
+    expectedTop += pixels;
+    ASSERT_EQ(expectedTop, shownTop()) << pixels;
+    ExpectItemsFillTheList(list);
+  }
+}
+
+TEST(VirtualListTests, WithMillionsOfItems_ScrollingFindsTheRowsInView)
+{
+  auto em       = make_shared<ElementManager>();
+  auto provider = make_shared<LazyItemsProvider>(2000000);
+  auto list     = CreateList(em, provider);
+  em->UpdateEverything();
+
+  ASSERT_EQ(2000000 * 50.0, list->GetContentHeight());
+
+  list->SetItemHeight(1500000, 10);
+  list->ScrollTo(1500000);
+  list->UpdateAfterModify();
+  ExpectItemsFillTheList(list);
+  ASSERT_EQ(1500000 * 50.0, list->GetScrollTop());
+  ASSERT_EQ(list->GetTop(), list->GetFirstChild()->GetBounds().top +
+                            list->GetFirstChild()->GetTranslation().Y);
+}
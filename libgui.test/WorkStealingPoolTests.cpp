@@ -0,0 +1,52 @@
+#include "libgui/WorkStealingPool.h"
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+using namespace libgui;
+using namespace std;
+
+TEST(WorkStealingPoolTests, WhenTasksRunNestedTasks_AllOfThemFinishBeforeRunReturns)
+{
+  WorkStealingPool pool(3);
+
+  atomic<int> finished{0};
+  vector<function<void()>> tasks;
+  for (int i = 0; i < 10; ++i)
+  {
+    tasks.emplace_back([&pool, &finished] {
+      vector<function<void()>> nested(10, [&finished] { ++finished; });
+      pool.Run(nested);
+    });
+  }
+  pool.Run(tasks);
+
+  ASSERT_EQ(100, finished);
+}
+
+TEST(WorkStealingPoolTests, WhenThereAreNoWorkers_TasksRunInOrderOnTheCallingThread)
+{
+  WorkStealingPool pool(0);
+
+  vector<int> order;
+  vector<function<void()>> tasks;
+  for (int i = 0; i < 5; ++i)
+  {
+    tasks.emplace_back([i, &order] { order.push_back(i); });
+  }
+  pool.Run(tasks);
+
+  ASSERT_EQ((vector<int>{0, 1, 2, 3, 4}), order);
+}
+
+TEST(WorkStealingPoolTests, WhenATaskThrows_TheOthersFinishAndTheExceptionIsRethrown)
+{
+  WorkStealingPool pool(2);
+
+  atomic<int> finished{0};
+  vector<function<void()>> tasks(20, [&finished] { ++finished; });
+  tasks[7] = [] { throw runtime_error("arrange failed"); };
+
+  ASSERT_THROW(pool.Run(tasks), runtime_error);
+  ASSERT_EQ(19, finished);
+}